@@ -1,52 +1,131 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "Players_data.h"
 
 #define MAX_TEAMS_LOCAL 10
 #define MAX_NAME_LENGTH 51
 #define MAX_PLAYERS_PER_TEAM 50
+#define MAX_MENU_PLAYER_ID 1500
+#define PLAYER_ID_SUGGESTION_COUNT 5
+#define PLAYER_CSV_FIELD_COUNT 9
+#define PLAYER_CSV_MAX_THREADS 16
+#define PLAYER_CSV_MIN_CHUNK_BYTES (1 << 20)
+#define PLAYER_SNAPSHOT_MAGIC "ICCODIS1"
+#define PLAYER_SNAPSHOT_VERSION 1
+#define PLAYER_SNAPSHOT_COLUMN_COUNT 11
 
 typedef enum { RoleUnknown = 0, RoleBatsman = 1, RoleBowler = 2, RoleAllRounder = 3 } RoleType;
 
-typedef struct PlayerNode {
+typedef struct PlayerIndexList {
+    int *playerIndexes;
+    int count;
+    int capacity;
+} PlayerIndexList;
+
+typedef struct PlayerColumnStore {
+    int *playerIds;
+    int *teamIndexes;
+    unsigned char *roles;
+    long *totalRuns;
+    double *battingAverages;
+    double *strikeRates;
+    int *wickets;
+    double *economyRates;
+    double *performanceIndexes;
+    size_t *nameOffsets;
+    char *nameArena;
+    size_t nameArenaLength;
+    size_t nameArenaCapacity;
+    int count;
+    int capacity;
+    void *mappedSnapshot;
+    size_t mappedSnapshotLength;
+} PlayerColumnStore;
+
+typedef struct PlayerIdIndexSlot {
     int playerId;
-    char playerName[MAX_NAME_LENGTH];
-    char teamName[MAX_NAME_LENGTH];
-    RoleType role;
+    int playerIndex;
+} PlayerIdIndexSlot;
+
+typedef struct PlayerIdIndex {
+    PlayerIdIndexSlot *slots;
+    int slotCount;
+    int slotShift;
+    int usedCount;
+} PlayerIdIndex;
+
+typedef struct PlayerCsvChunk {
+    const char *begin;
+    const char *end;
+    PlayerColumnStore rows;
+    long rejectedRowCount;
+    pthread_t thread;
+    int hasThread;
+} PlayerCsvChunk;
+
+typedef struct PlayerSnapshotHeader {
+    char magic[8];
+    unsigned int version;
+    int playerCount;
+    unsigned long long nameArenaLength;
+} PlayerSnapshotHeader;
+
+typedef struct PlayerAggregate {
+    int playerCount;
     long totalRuns;
-    double battingAverage;
-    double strikeRate;
-    int wickets;
-    double economyRate;
-    double performanceIndex;
-    struct PlayerNode *teamNext;
-    struct PlayerNode *roleNext;
-} PlayerNode;
+    long totalWickets;
+    double strikeRateSum;
+    int strikeRateCount;
+    double economyRateSum;
+    int economyRateCount;
+    double performanceIndexSum;
+} PlayerAggregate;
+
+typedef struct PlayerRankKey {
+    unsigned long long sortKey;
+    int playerIndex;
+} PlayerRankKey;
 
 typedef struct TeamInformationStructure {
     int teamId;
     char teamName[MAX_NAME_LENGTH];
-    int totalPlayers;
-    double averageBattingStrikeRate;
-    PlayerNode *playerListHead;
+    PlayerAggregate aggregate;
+    PlayerIndexList players;
 } TeamInformationStructure;
 
 static TeamInformationStructure teamInformationArray[MAX_TEAMS_LOCAL];
 static int totalNumberOfTeamsLocal = MAX_TEAMS_LOCAL;
-static PlayerNode *roleListHeads[4] = { NULL, NULL, NULL, NULL };
-static PlayerNode **allocatedPlayerPointers = NULL;
-static size_t allocatedPlayerPointerCount = 0;
-static size_t allocatedPlayerPointerCapacity = 0;
+static PlayerColumnStore playerStore;
+static PlayerIndexList rolePerformanceRankings[4];
+static PlayerIndexList teamRolePerformanceRankings[MAX_TEAMS_LOCAL][4];
+static PlayerAggregate roleAggregates[4];
+static PlayerIdIndex playerIdIndex;
+static unsigned long long usedMenuPlayerIdBits[MAX_MENU_PLAYER_ID / 64 + 1];
+static const size_t playerSnapshotElementSizes[PLAYER_SNAPSHOT_COLUMN_COUNT] = { sizeof(int), sizeof(int), sizeof(unsigned char), sizeof(long), sizeof(double), sizeof(double), sizeof(int), sizeof(double), sizeof(double), sizeof(size_t), sizeof(char) };
+
+void exitOnEndOfInput(void) {
+    if (!feof(stdin)) return;
+    printf("\nEnd of input. Exiting.\n");
+    exit(0);
+}
 
 int readIntegerInRange(const char *prompt, int minValue, int maxValue) {
     char buffer[128];
     long val;
     while (1) {
         printf("%s", prompt);
-        if (!fgets(buffer, sizeof(buffer), stdin)) { printf("Input error, try again.\n"); continue; }
+        if (!fgets(buffer, sizeof(buffer), stdin)) { exitOnEndOfInput(); printf("Input error, try again.\n"); continue; }
         if (sscanf(buffer, "%ld", &val) == 1) {
             if (val < minValue || val > maxValue) {
                 printf("Wrong input: value must be between %d and %d. Try again.\n", minValue, maxValue);
@@ -63,7 +142,7 @@ long readLongInRange(const char *prompt, long minValue, long maxValue) {
     long val;
     while (1) {
         printf("%s", prompt);
-        if (!fgets(buffer, sizeof(buffer), stdin)) { printf("Input error, try again.\n"); continue; }
+        if (!fgets(buffer, sizeof(buffer), stdin)) { exitOnEndOfInput(); printf("Input error, try again.\n"); continue; }
         if (sscanf(buffer, "%ld", &val) == 1) {
             if (val < minValue || val > maxValue) {
                 printf("Wrong input: value must be between %ld and %ld. Try again.\n", minValue, maxValue);
@@ -80,7 +159,7 @@ double readDoubleInRange(const char *prompt, double minValue, double maxValue) {
     double val;
     while (1) {
         printf("%s", prompt);
-        if (!fgets(buffer, sizeof(buffer), stdin)) { printf("Input error, try again.\n"); continue; }
+        if (!fgets(buffer, sizeof(buffer), stdin)) { exitOnEndOfInput(); printf("Input error, try again.\n"); continue; }
         if (sscanf(buffer, "%lf", &val) == 1) {
             if (!(val >= minValue && val <= maxValue)) {
                 printf("Wrong input: value must be between %.2f and %.2f. Try again.\n", minValue, maxValue);
@@ -96,7 +175,7 @@ void readStringLineStrict(const char *prompt, char *outputBuffer, int maxLength)
     char buffer[512];
     while (1) {
         printf("%s", prompt);
-        if (!fgets(buffer, sizeof(buffer), stdin)) { printf("Input error, try again.\n"); continue; }
+        if (!fgets(buffer, sizeof(buffer), stdin)) { exitOnEndOfInput(); printf("Input error, try again.\n"); continue; }
         size_t n = strlen(buffer);
         if (n > 0 && buffer[n-1] == '\n') buffer[n-1] = '\0';
         if (strlen(buffer) < 1 || strlen(buffer) >= (size_t)maxLength) {
@@ -132,43 +211,237 @@ double computePerformanceIndexForPlayer(RoleType role, double battingAverage, do
     return 0.0;
 }
 
-void storeAllocatedPlayerPointer(PlayerNode *nodePointer) {
-    if (allocatedPlayerPointerCount + 1 > allocatedPlayerPointerCapacity) {
-        allocatedPlayerPointerCapacity = (allocatedPlayerPointerCapacity == 0) ? 128 : allocatedPlayerPointerCapacity * 2;
-        allocatedPlayerPointers = realloc(allocatedPlayerPointers, allocatedPlayerPointerCapacity * sizeof(PlayerNode *));
-        if (!allocatedPlayerPointers) { perror("realloc"); exit(1); }
+void *resizeArrayOrExit(void *array, size_t elementCount, size_t elementSize) {
+    void *resized = realloc(array, elementCount * elementSize);
+    if (!resized) { perror("realloc"); exit(1); }
+    return resized;
+}
+
+void *duplicateArrayOrExit(const void *array, size_t elementCount, size_t elementSize) {
+    void *copy = malloc((elementCount + 1) * elementSize);
+    if (!copy) { perror("malloc"); exit(1); }
+    memcpy(copy, array, elementCount * elementSize);
+    return copy;
+}
+
+void detachPlayerStoreFromSnapshot(PlayerColumnStore *store) {
+    store->playerIds = duplicateArrayOrExit(store->playerIds, store->count, sizeof(int));
+    store->teamIndexes = duplicateArrayOrExit(store->teamIndexes, store->count, sizeof(int));
+    store->roles = duplicateArrayOrExit(store->roles, store->count, sizeof(unsigned char));
+    store->totalRuns = duplicateArrayOrExit(store->totalRuns, store->count, sizeof(long));
+    store->battingAverages = duplicateArrayOrExit(store->battingAverages, store->count, sizeof(double));
+    store->strikeRates = duplicateArrayOrExit(store->strikeRates, store->count, sizeof(double));
+    store->wickets = duplicateArrayOrExit(store->wickets, store->count, sizeof(int));
+    store->economyRates = duplicateArrayOrExit(store->economyRates, store->count, sizeof(double));
+    store->performanceIndexes = duplicateArrayOrExit(store->performanceIndexes, store->count, sizeof(double));
+    store->nameOffsets = duplicateArrayOrExit(store->nameOffsets, store->count, sizeof(size_t));
+    store->nameArena = duplicateArrayOrExit(store->nameArena, store->nameArenaLength, sizeof(char));
+    store->nameArenaCapacity = store->nameArenaLength + 1;
+    store->capacity = store->count;
+    munmap(store->mappedSnapshot, store->mappedSnapshotLength);
+    store->mappedSnapshot = NULL;
+    store->mappedSnapshotLength = 0;
+}
+
+void ensurePlayerStoreCapacity(PlayerColumnStore *store, int requiredCount) {
+    if (store->mappedSnapshot) detachPlayerStoreFromSnapshot(store);
+    if (requiredCount <= store->capacity) return;
+    int newCapacity = (store->capacity == 0) ? 128 : store->capacity;
+    while (newCapacity < requiredCount) newCapacity *= 2;
+    store->playerIds = resizeArrayOrExit(store->playerIds, newCapacity, sizeof(int));
+    store->teamIndexes = resizeArrayOrExit(store->teamIndexes, newCapacity, sizeof(int));
+    store->roles = resizeArrayOrExit(store->roles, newCapacity, sizeof(unsigned char));
+    store->totalRuns = resizeArrayOrExit(store->totalRuns, newCapacity, sizeof(long));
+    store->battingAverages = resizeArrayOrExit(store->battingAverages, newCapacity, sizeof(double));
+    store->strikeRates = resizeArrayOrExit(store->strikeRates, newCapacity, sizeof(double));
+    store->wickets = resizeArrayOrExit(store->wickets, newCapacity, sizeof(int));
+    store->economyRates = resizeArrayOrExit(store->economyRates, newCapacity, sizeof(double));
+    store->performanceIndexes = resizeArrayOrExit(store->performanceIndexes, newCapacity, sizeof(double));
+    store->nameOffsets = resizeArrayOrExit(store->nameOffsets, newCapacity, sizeof(size_t));
+    store->capacity = newCapacity;
+}
+
+void ensureNameArenaCapacity(PlayerColumnStore *store, size_t requiredLength) {
+    if (requiredLength <= store->nameArenaCapacity) return;
+    size_t newCapacity = (store->nameArenaCapacity == 0) ? 4096 : store->nameArenaCapacity;
+    while (newCapacity < requiredLength) newCapacity *= 2;
+    store->nameArena = resizeArrayOrExit(store->nameArena, newCapacity, sizeof(char));
+    store->nameArenaCapacity = newCapacity;
+}
+
+size_t appendPlayerNameToArena(PlayerColumnStore *store, const char *name, size_t length) {
+    ensureNameArenaCapacity(store, store->nameArenaLength + length + 1);
+    size_t offset = store->nameArenaLength;
+    memcpy(store->nameArena + offset, name, length);
+    store->nameArena[offset + length] = '\0';
+    store->nameArenaLength += length + 1;
+    return offset;
+}
+
+const char *getPlayerName(int playerIndex) {
+    return playerStore.nameArena + playerStore.nameOffsets[playerIndex];
+}
+
+void appendPlayerIndex(PlayerIndexList *list, int playerIndex) {
+    if (list->count + 1 > list->capacity) {
+        list->capacity = (list->capacity == 0) ? 16 : list->capacity * 2;
+        list->playerIndexes = resizeArrayOrExit(list->playerIndexes, list->capacity, sizeof(int));
+    }
+    list->playerIndexes[list->count++] = playerIndex;
+}
+
+void freePlayerIndexList(PlayerIndexList *list) {
+    free(list->playerIndexes);
+    list->playerIndexes = NULL;
+    list->count = list->capacity = 0;
+}
+
+int appendPlayerRow(PlayerColumnStore *store, int id, const char *name, size_t nameLength, int teamIndex, RoleType role, long runs, double avg, double sr, int wkts, double er) {
+    ensurePlayerStoreCapacity(store, store->count + 1);
+    int playerIndex = store->count;
+    store->playerIds[playerIndex] = id;
+    store->teamIndexes[playerIndex] = teamIndex;
+    store->roles[playerIndex] = (unsigned char)role;
+    store->totalRuns[playerIndex] = runs;
+    store->battingAverages[playerIndex] = avg;
+    store->strikeRates[playerIndex] = sr;
+    store->wickets[playerIndex] = wkts;
+    store->economyRates[playerIndex] = er;
+    store->performanceIndexes[playerIndex] = computePerformanceIndexForPlayer(role, avg, sr, wkts, er);
+    store->nameOffsets[playerIndex] = appendPlayerNameToArena(store, name, nameLength);
+    store->count++;
+    return playerIndex;
+}
+
+int createPlayerRecord(int id, const char *name, int teamIndex, RoleType role, long runs, double avg, double sr, int wkts, double er) {
+    return appendPlayerRow(&playerStore, id, name, strnlen(name, MAX_NAME_LENGTH - 1), teamIndex, role, runs, avg, sr, wkts, er);
+}
+
+void appendPlayerColumns(PlayerColumnStore *destination, const PlayerColumnStore *source) {
+    if (source->count == 0) return;
+    ensurePlayerStoreCapacity(destination, destination->count + source->count);
+    ensureNameArenaCapacity(destination, destination->nameArenaLength + source->nameArenaLength);
+    int first = destination->count;
+    memcpy(destination->playerIds + first, source->playerIds, source->count * sizeof(int));
+    memcpy(destination->teamIndexes + first, source->teamIndexes, source->count * sizeof(int));
+    memcpy(destination->roles + first, source->roles, source->count * sizeof(unsigned char));
+    memcpy(destination->totalRuns + first, source->totalRuns, source->count * sizeof(long));
+    memcpy(destination->battingAverages + first, source->battingAverages, source->count * sizeof(double));
+    memcpy(destination->strikeRates + first, source->strikeRates, source->count * sizeof(double));
+    memcpy(destination->wickets + first, source->wickets, source->count * sizeof(int));
+    memcpy(destination->economyRates + first, source->economyRates, source->count * sizeof(double));
+    memcpy(destination->performanceIndexes + first, source->performanceIndexes, source->count * sizeof(double));
+    for (int i = 0; i < source->count; ++i) destination->nameOffsets[first + i] = source->nameOffsets[i] + destination->nameArenaLength;
+    memcpy(destination->nameArena + destination->nameArenaLength, source->nameArena, source->nameArenaLength);
+    destination->nameArenaLength += source->nameArenaLength;
+    destination->count += source->count;
+}
+
+void releasePlayerColumns(PlayerColumnStore *store) {
+    if (store->mappedSnapshot) {
+        munmap(store->mappedSnapshot, store->mappedSnapshotLength);
+    } else {
+        free(store->playerIds);
+        free(store->teamIndexes);
+        free(store->roles);
+        free(store->totalRuns);
+        free(store->battingAverages);
+        free(store->strikeRates);
+        free(store->wickets);
+        free(store->economyRates);
+        free(store->performanceIndexes);
+        free(store->nameOffsets);
+        free(store->nameArena);
+    }
+    memset(store, 0, sizeof(*store));
+}
+
+unsigned int hashPlayerId(int playerId) {
+    return ((unsigned int)playerId * 2654435761u) >> playerIdIndex.slotShift;
+}
+
+int findPlayerIndexById(int playerId) {
+    if (playerIdIndex.slotCount == 0) return -1;
+    unsigned int mask = (unsigned int)playerIdIndex.slotCount - 1;
+    for (unsigned int slot = hashPlayerId(playerId);; slot = (slot + 1) & mask) {
+        const PlayerIdIndexSlot *entry = &playerIdIndex.slots[slot];
+        if (entry->playerIndex == -1) return -1;
+        if (entry->playerId == playerId) return entry->playerIndex;
     }
-    allocatedPlayerPointers[allocatedPlayerPointerCount++] = nodePointer;
 }
 
-PlayerNode *createPlayerNode(int id, const char *name, const char *teamName, RoleType role, long runs, double avg, double sr, int wkts, double er) {
-    PlayerNode *p = malloc(sizeof(PlayerNode));
-    if (!p) { perror("malloc"); exit(1); }
-    p->playerId = id;
-    strncpy(p->playerName, name, MAX_NAME_LENGTH - 1); p->playerName[MAX_NAME_LENGTH - 1] = '\0';
-    strncpy(p->teamName, teamName, MAX_NAME_LENGTH - 1); p->teamName[MAX_NAME_LENGTH - 1] = '\0';
-    p->role = role;
-    p->totalRuns = runs;
-    p->battingAverage = avg;
-    p->strikeRate = sr;
-    p->wickets = wkts;
-    p->economyRate = er;
-    p->performanceIndex = computePerformanceIndexForPlayer(role, avg, sr, wkts, er);
-    p->teamNext = NULL;
-    p->roleNext = NULL;
-    storeAllocatedPlayerPointer(p);
-    return p;
+void placePlayerIdInIndex(int playerId, int playerIndex) {
+    unsigned int mask = (unsigned int)playerIdIndex.slotCount - 1;
+    unsigned int slot = hashPlayerId(playerId);
+    while (playerIdIndex.slots[slot].playerIndex != -1 && playerIdIndex.slots[slot].playerId != playerId) slot = (slot + 1) & mask;
+    if (playerIdIndex.slots[slot].playerIndex == -1) playerIdIndex.usedCount++;
+    playerIdIndex.slots[slot].playerId = playerId;
+    playerIdIndex.slots[slot].playerIndex = playerIndex;
+}
+
+void ensurePlayerIdIndexCapacity(int requiredCount) {
+    if ((size_t)requiredCount * 2 <= (size_t)playerIdIndex.slotCount) return;
+    PlayerIdIndexSlot *oldSlots = playerIdIndex.slots;
+    int oldSlotCount = playerIdIndex.slotCount;
+    int newSlotCount = (oldSlotCount == 0) ? 256 : oldSlotCount;
+    while ((size_t)requiredCount * 2 > (size_t)newSlotCount) newSlotCount *= 2;
+    playerIdIndex.slots = malloc(newSlotCount * sizeof(PlayerIdIndexSlot));
+    if (!playerIdIndex.slots) { perror("malloc"); exit(1); }
+    for (int i = 0; i < newSlotCount; ++i) playerIdIndex.slots[i].playerIndex = -1;
+    playerIdIndex.slotCount = newSlotCount;
+    playerIdIndex.slotShift = 32 - __builtin_ctz((unsigned int)newSlotCount);
+    playerIdIndex.usedCount = 0;
+    for (int i = 0; i < oldSlotCount; ++i) {
+        if (oldSlots[i].playerIndex != -1) placePlayerIdInIndex(oldSlots[i].playerId, oldSlots[i].playerIndex);
+    }
+    free(oldSlots);
+}
+
+void registerPlayerId(int playerId, int playerIndex) {
+    ensurePlayerIdIndexCapacity(playerIdIndex.usedCount + 1);
+    placePlayerIdInIndex(playerId, playerIndex);
+    if (playerId >= 1 && playerId <= MAX_MENU_PLAYER_ID) usedMenuPlayerIdBits[playerId / 64] |= 1ULL << (playerId % 64);
 }
 
 int isPlayerIdAlreadyPresent(int idToCheck) {
-    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) {
-        PlayerNode *cur = teamInformationArray[i].playerListHead;
-        while (cur) {
-            if (cur->playerId == idToCheck) return 1;
-            cur = cur->teamNext;
-        }
+    return findPlayerIndexById(idToCheck) != -1;
+}
+
+int findNextFreeMenuPlayerId(int startId) {
+    for (int wordsScanned = 0; wordsScanned <= MAX_MENU_PLAYER_ID / 64 + 1; ++wordsScanned) {
+        int wordIndex = startId / 64;
+        unsigned long long freeBits = ~usedMenuPlayerIdBits[wordIndex] & (~0ULL << (startId % 64));
+        if (wordIndex == 0) freeBits &= ~1ULL;
+        if (wordIndex == MAX_MENU_PLAYER_ID / 64) freeBits &= (MAX_MENU_PLAYER_ID % 64 == 63) ? ~0ULL : ((1ULL << (MAX_MENU_PLAYER_ID % 64 + 1)) - 1);
+        if (freeBits) return wordIndex * 64 + __builtin_ctzll(freeBits);
+        startId = (wordIndex + 1) * 64;
+        if (startId > MAX_MENU_PLAYER_ID) startId = 1;
     }
-    return 0;
+    return -1;
+}
+
+void releasePlayerIdIndex(void) {
+    free(playerIdIndex.slots);
+    memset(&playerIdIndex, 0, sizeof(playerIdIndex));
+    memset(usedMenuPlayerIdBits, 0, sizeof(usedMenuPlayerIdBits));
+}
+
+int findTeamIndexByNameLength(const char *teamName, size_t length) {
+    if (length == 0 || length >= MAX_NAME_LENGTH) return -1;
+    int left = 0, right = totalNumberOfTeamsLocal - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        int order = strncasecmp(teamInformationArray[mid].teamName, teamName, length);
+        if (order == 0 && teamInformationArray[mid].teamName[length] != '\0') order = 1;
+        if (order == 0) return mid;
+        if (order < 0) left = mid + 1;
+        else right = mid - 1;
+    }
+    return -1;
+}
+
+int findTeamIndexByName(const char *teamName) {
+    return findTeamIndexByNameLength(teamName, strlen(teamName));
 }
 
 int findTeamIndexById(int teamId) {
@@ -182,29 +455,107 @@ int findTeamIndexById(int teamId) {
     return -1;
 }
 
-void insertPlayerIntoTeamAndRoleLists(PlayerNode *playerNode) {
-    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) {
-        if (strcasecmp(teamInformationArray[i].teamName, playerNode->teamName) == 0) {
-            playerNode->teamNext = teamInformationArray[i].playerListHead;
-            teamInformationArray[i].playerListHead = playerNode;
-            teamInformationArray[i].totalPlayers += 1;
-            playerNode->roleNext = roleListHeads[playerNode->role];
-            roleListHeads[playerNode->role] = playerNode;
-            return;
+int comparePlayerRanks(int leftIndex, int rightIndex) {
+    double left = playerStore.performanceIndexes[leftIndex];
+    double right = playerStore.performanceIndexes[rightIndex];
+    if (left < right) return 1;
+    if (left > right) return -1;
+    return (leftIndex > rightIndex) - (leftIndex < rightIndex);
+}
+
+unsigned long long encodeDescendingRankKey(double performanceIndex) {
+    unsigned long long bits;
+    memcpy(&bits, &performanceIndex, sizeof(bits));
+    bits = (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+    return ~bits;
+}
+
+void sortPlayerIndexesByPerformance(int *playerIndexes, int count) {
+    if (count < 2) return;
+    PlayerRankKey *keys = malloc(count * sizeof(PlayerRankKey));
+    PlayerRankKey *scratch = malloc(count * sizeof(PlayerRankKey));
+    if (!keys || !scratch) { perror("malloc"); exit(1); }
+    for (int i = 0; i < count; ++i) {
+        keys[i].sortKey = encodeDescendingRankKey(playerStore.performanceIndexes[playerIndexes[i]]);
+        keys[i].playerIndex = playerIndexes[i];
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        int bucketStarts[256] = { 0 };
+        for (int i = 0; i < count; ++i) bucketStarts[(keys[i].sortKey >> shift) & 0xFF]++;
+        if (bucketStarts[(keys[0].sortKey >> shift) & 0xFF] == count) continue;
+        for (int bucket = 0, position = 0; bucket < 256; ++bucket) {
+            int bucketSize = bucketStarts[bucket];
+            bucketStarts[bucket] = position;
+            position += bucketSize;
         }
+        for (int i = 0; i < count; ++i) scratch[bucketStarts[(keys[i].sortKey >> shift) & 0xFF]++] = keys[i];
+        PlayerRankKey *sorted = scratch;
+        scratch = keys;
+        keys = sorted;
     }
+    for (int i = 0; i < count; ++i) playerIndexes[i] = keys[i].playerIndex;
+    free(keys);
+    free(scratch);
 }
 
-void recomputeAverageStrikeRateForTeam(TeamInformationStructure *team) {
-    if (!team) return;
-    PlayerNode *cur = team->playerListHead;
-    double sum = 0.0;
-    int count = 0;
-    while (cur) {
-        if (cur->role == RoleBatsman || cur->role == RoleAllRounder) { sum += cur->strikeRate; count++; }
-        cur = cur->teamNext;
+void insertRankedPlayerIndex(PlayerIndexList *ranking, int playerIndex) {
+    int left = 0, right = ranking->count;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (comparePlayerRanks(ranking->playerIndexes[mid], playerIndex) < 0) left = mid + 1;
+        else right = mid;
     }
-    team->averageBattingStrikeRate = (count == 0) ? 0.0 : (sum / count);
+    appendPlayerIndex(ranking, playerIndex);
+    memmove(ranking->playerIndexes + left + 1, ranking->playerIndexes + left, (ranking->count - 1 - left) * sizeof(int));
+    ranking->playerIndexes[left] = playerIndex;
+}
+
+void mergeRankedTail(PlayerIndexList *ranking, int rankedCount) {
+    if (rankedCount == 0 || rankedCount == ranking->count) return;
+    int *merged = malloc(ranking->count * sizeof(int));
+    if (!merged) { perror("malloc"); exit(1); }
+    int left = 0, right = rankedCount, out = 0;
+    while (left < rankedCount && right < ranking->count) {
+        if (comparePlayerRanks(ranking->playerIndexes[left], ranking->playerIndexes[right]) <= 0) merged[out++] = ranking->playerIndexes[left++];
+        else merged[out++] = ranking->playerIndexes[right++];
+    }
+    while (left < rankedCount) merged[out++] = ranking->playerIndexes[left++];
+    while (right < ranking->count) merged[out++] = ranking->playerIndexes[right++];
+    free(ranking->playerIndexes);
+    ranking->playerIndexes = merged;
+    ranking->capacity = ranking->count;
+}
+
+void accumulatePlayerIntoAggregate(PlayerAggregate *aggregate, int playerIndex) {
+    RoleType role = (RoleType)playerStore.roles[playerIndex];
+    aggregate->playerCount++;
+    aggregate->totalRuns += playerStore.totalRuns[playerIndex];
+    aggregate->totalWickets += playerStore.wickets[playerIndex];
+    aggregate->performanceIndexSum += playerStore.performanceIndexes[playerIndex];
+    if (role == RoleBatsman || role == RoleAllRounder) { aggregate->strikeRateSum += playerStore.strikeRates[playerIndex]; aggregate->strikeRateCount++; }
+    if (role == RoleBowler || role == RoleAllRounder) { aggregate->economyRateSum += playerStore.economyRates[playerIndex]; aggregate->economyRateCount++; }
+}
+
+double computeAggregateMean(double sum, int count) {
+    return (count == 0) ? 0.0 : (sum / count);
+}
+
+double getAverageBattingStrikeRate(const PlayerAggregate *aggregate) {
+    return computeAggregateMean(aggregate->strikeRateSum, aggregate->strikeRateCount);
+}
+
+void linkPlayerIntoTeam(int playerIndex) {
+    registerPlayerId(playerStore.playerIds[playerIndex], playerIndex);
+    TeamInformationStructure *team = &teamInformationArray[playerStore.teamIndexes[playerIndex]];
+    appendPlayerIndex(&team->players, playerIndex);
+    accumulatePlayerIntoAggregate(&team->aggregate, playerIndex);
+    accumulatePlayerIntoAggregate(&roleAggregates[playerStore.roles[playerIndex]], playerIndex);
+}
+
+void insertPlayerIntoTeamAndRoleLists(int playerIndex) {
+    linkPlayerIntoTeam(playerIndex);
+    insertRankedPlayerIndex(&teamRolePerformanceRankings[playerStore.teamIndexes[playerIndex]][playerStore.roles[playerIndex]], playerIndex);
+    insertRankedPlayerIndex(&rolePerformanceRankings[playerStore.roles[playerIndex]], playerIndex);
 }
 
 void initializeTeamInformationArrayAlphabetical(void) {
@@ -212,59 +563,350 @@ void initializeTeamInformationArrayAlphabetical(void) {
         teamInformationArray[i].teamId = i + 1;
         strncpy(teamInformationArray[i].teamName, teams[i], MAX_NAME_LENGTH - 1);
         teamInformationArray[i].teamName[MAX_NAME_LENGTH - 1] = '\0';
-        teamInformationArray[i].totalPlayers = 0;
-        teamInformationArray[i].averageBattingStrikeRate = 0.0;
-        teamInformationArray[i].playerListHead = NULL;
+        memset(&teamInformationArray[i].aggregate, 0, sizeof(PlayerAggregate));
+        memset(&teamInformationArray[i].players, 0, sizeof(PlayerIndexList));
     }
 }
 
 void loadPlayersFromHeaderIntoStructures(void) {
+    ensurePlayerStoreCapacity(&playerStore, playerCount);
     for (int i = 0; i < playerCount; ++i) {
         const Player *src = &players[i];
+        int teamIndex = findTeamIndexByName(src->team);
+        if (teamIndex == -1) continue;
         RoleType r = convertRoleStringToEnum(src->role);
-        PlayerNode *pn = createPlayerNode(src->id, src->name, src->team, r, src->totalRuns, src->battingAverage, src->strikeRate, src->wickets, src->economyRate);
-        insertPlayerIntoTeamAndRoleLists(pn);
+        int playerIndex = createPlayerRecord(src->id, src->name, teamIndex, r, src->totalRuns, src->battingAverage, src->strikeRate, src->wickets, src->economyRate);
+        insertPlayerIntoTeamAndRoleLists(playerIndex);
+    }
+}
+
+void movePlayerRow(int fromIndex, int toIndex) {
+    playerStore.playerIds[toIndex] = playerStore.playerIds[fromIndex];
+    playerStore.teamIndexes[toIndex] = playerStore.teamIndexes[fromIndex];
+    playerStore.roles[toIndex] = playerStore.roles[fromIndex];
+    playerStore.totalRuns[toIndex] = playerStore.totalRuns[fromIndex];
+    playerStore.battingAverages[toIndex] = playerStore.battingAverages[fromIndex];
+    playerStore.strikeRates[toIndex] = playerStore.strikeRates[fromIndex];
+    playerStore.wickets[toIndex] = playerStore.wickets[fromIndex];
+    playerStore.economyRates[toIndex] = playerStore.economyRates[fromIndex];
+    playerStore.performanceIndexes[toIndex] = playerStore.performanceIndexes[fromIndex];
+    playerStore.nameOffsets[toIndex] = playerStore.nameOffsets[fromIndex];
+}
+
+int indexPlayersFromRow(int firstPlayerIndex) {
+    ensurePlayerIdIndexCapacity(playerStore.count);
+    int rankedCounts[MAX_TEAMS_LOCAL][4];
+    int roleRankedCounts[4];
+    for (int r = 1; r <= 3; ++r) {
+        roleRankedCounts[r] = rolePerformanceRankings[r].count;
+        for (int i = 0; i < totalNumberOfTeamsLocal; ++i) rankedCounts[i][r] = teamRolePerformanceRankings[i][r].count;
+    }
+    int keptCount = firstPlayerIndex;
+    for (int i = firstPlayerIndex; i < playerStore.count; ++i) {
+        if (isPlayerIdAlreadyPresent(playerStore.playerIds[i])) continue;
+        if (keptCount != i) movePlayerRow(i, keptCount);
+        linkPlayerIntoTeam(keptCount);
+        appendPlayerIndex(&rolePerformanceRankings[playerStore.roles[keptCount]], keptCount);
+        keptCount++;
+    }
+    int duplicateCount = playerStore.count - keptCount;
+    playerStore.count = keptCount;
+    for (int r = 1; r <= 3; ++r) {
+        PlayerIndexList *roleRanking = &rolePerformanceRankings[r];
+        sortPlayerIndexesByPerformance(roleRanking->playerIndexes + roleRankedCounts[r], roleRanking->count - roleRankedCounts[r]);
+        for (int i = roleRankedCounts[r]; i < roleRanking->count; ++i) {
+            int playerIndex = roleRanking->playerIndexes[i];
+            appendPlayerIndex(&teamRolePerformanceRankings[playerStore.teamIndexes[playerIndex]][r], playerIndex);
+        }
+        mergeRankedTail(roleRanking, roleRankedCounts[r]);
+        for (int i = 0; i < totalNumberOfTeamsLocal; ++i) mergeRankedTail(&teamRolePerformanceRankings[i][r], rankedCounts[i][r]);
+    }
+    return duplicateCount;
+}
+
+double getMonotonicSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void trimCsvField(const char **begin, const char **end) {
+    while (*begin < *end && (**begin == ' ' || **begin == '\t')) (*begin)++;
+    while (*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t')) (*end)--;
+}
+
+int parseCsvLongField(const char *begin, const char *end, long maxValue, long *value) {
+    if (begin == end) return 0;
+    long result = 0;
+    for (; begin < end; ++begin) {
+        if (!isdigit((unsigned char)*begin)) return 0;
+        result = result * 10 + (*begin - '0');
+        if (result > maxValue) return 0;
+    }
+    *value = result;
+    return 1;
+}
+
+int parseCsvDoubleField(const char *begin, const char *end, double maxValue, double *value) {
+    static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    unsigned long long mantissa = 0;
+    int digitCount = 0;
+    int fractionDigits = 0;
+    int seenPoint = 0;
+    for (const char *cursor = begin; cursor < end; ++cursor) {
+        if (*cursor == '.' && !seenPoint) { seenPoint = 1; continue; }
+        if (!isdigit((unsigned char)*cursor)) return 0;
+        if (digitCount < 16) mantissa = mantissa * 10 + (*cursor - '0');
+        fractionDigits += seenPoint;
+        digitCount++;
+    }
+    if (digitCount == 0) return 0;
+    double result;
+    if (digitCount <= 15) {
+        result = (double)mantissa / powersOfTen[fractionDigits];
+    } else {
+        char buffer[64];
+        if (end - begin >= (long)sizeof(buffer)) return 0;
+        memcpy(buffer, begin, end - begin);
+        buffer[end - begin] = '\0';
+        result = strtod(buffer, NULL);
+    }
+    if (result > maxValue) return 0;
+    *value = result;
+    return 1;
+}
+
+int parsePlayerCsvLine(PlayerColumnStore *rows, const char *lineBegin, const char *lineEnd) {
+    const char *fieldBegins[PLAYER_CSV_FIELD_COUNT];
+    const char *fieldEnds[PLAYER_CSV_FIELD_COUNT];
+    const char *cursor = lineBegin;
+    for (int field = 0; field < PLAYER_CSV_FIELD_COUNT; ++field) {
+        const char *comma = memchr(cursor, ',', lineEnd - cursor);
+        if ((comma == NULL) != (field == PLAYER_CSV_FIELD_COUNT - 1)) return 0;
+        fieldBegins[field] = cursor;
+        fieldEnds[field] = comma ? comma : lineEnd;
+        trimCsvField(&fieldBegins[field], &fieldEnds[field]);
+        if (comma) cursor = comma + 1;
+    }
+    long id, runs, wkts;
+    double avg, sr, er;
+    size_t nameLength = fieldEnds[1] - fieldBegins[1];
+    size_t roleLength = fieldEnds[3] - fieldBegins[3];
+    char roleBuffer[16];
+    if (!parseCsvLongField(fieldBegins[0], fieldEnds[0], INT_MAX, &id) || id < 1) return 0;
+    if (nameLength < 1 || nameLength >= MAX_NAME_LENGTH || roleLength >= sizeof(roleBuffer)) return 0;
+    int teamIndex = findTeamIndexByNameLength(fieldBegins[2], fieldEnds[2] - fieldBegins[2]);
+    if (teamIndex == -1) return 0;
+    memcpy(roleBuffer, fieldBegins[3], roleLength);
+    roleBuffer[roleLength] = '\0';
+    RoleType role = convertRoleStringToEnum(roleBuffer);
+    if (role == RoleUnknown) return 0;
+    if (!parseCsvLongField(fieldBegins[4], fieldEnds[4], 1000000000L, &runs)) return 0;
+    if (!parseCsvDoubleField(fieldBegins[5], fieldEnds[5], 10000.0, &avg)) return 0;
+    if (!parseCsvDoubleField(fieldBegins[6], fieldEnds[6], 10000.0, &sr)) return 0;
+    if (!parseCsvLongField(fieldBegins[7], fieldEnds[7], 1000000L, &wkts)) return 0;
+    if (!parseCsvDoubleField(fieldBegins[8], fieldEnds[8], 1000.0, &er)) return 0;
+    appendPlayerRow(rows, (int)id, fieldBegins[1], nameLength, teamIndex, role, runs, avg, sr, (int)wkts, er);
+    return 1;
+}
+
+void *parsePlayerCsvChunk(void *argument) {
+    PlayerCsvChunk *chunk = argument;
+    const char *cursor = chunk->begin;
+    while (cursor < chunk->end) {
+        const char *lineEnd = memchr(cursor, '\n', chunk->end - cursor);
+        if (!lineEnd) lineEnd = chunk->end;
+        const char *contentEnd = lineEnd;
+        if (contentEnd > cursor && contentEnd[-1] == '\r') contentEnd--;
+        if (contentEnd > cursor && !parsePlayerCsvLine(&chunk->rows, cursor, contentEnd)) chunk->rejectedRowCount++;
+        cursor = lineEnd + 1;
+    }
+    return NULL;
+}
+
+int loadPlayersFromCsvFile(const char *path, long *rejectedRowCount) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) { perror(path); close(fd); return -1; }
+    *rejectedRowCount = 0;
+    if (fileStat.st_size == 0) { close(fd); return 0; }
+    size_t fileLength = (size_t)fileStat.st_size;
+    const char *data = mmap(NULL, fileLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) { perror(path); return -1; }
+    madvise((void *)data, fileLength, MADV_SEQUENTIAL);
+    const char *dataBegin = data;
+    const char *dataEnd = data + fileLength;
+    const char *firstField = dataBegin;
+    while (firstField < dataEnd && (*firstField == ' ' || *firstField == '\t')) firstField++;
+    if (firstField < dataEnd && !isdigit((unsigned char)*firstField)) {
+        const char *headerEnd = memchr(dataBegin, '\n', fileLength);
+        dataBegin = headerEnd ? headerEnd + 1 : dataEnd;
+    }
+    long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+    int chunkCount = (processorCount > 0) ? (int)processorCount : 1;
+    if (chunkCount > PLAYER_CSV_MAX_THREADS) chunkCount = PLAYER_CSV_MAX_THREADS;
+    size_t sizeLimitedChunkCount = (size_t)(dataEnd - dataBegin) / PLAYER_CSV_MIN_CHUNK_BYTES + 1;
+    if (sizeLimitedChunkCount < (size_t)chunkCount) chunkCount = (int)sizeLimitedChunkCount;
+    PlayerCsvChunk chunks[PLAYER_CSV_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    const char *chunkBegin = dataBegin;
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = dataEnd;
+        if (i < chunkCount - 1) {
+            const char *split = dataBegin + (size_t)(dataEnd - dataBegin) * (i + 1) / chunkCount;
+            if (split < chunkBegin) split = chunkBegin;
+            const char *newline = memchr(split, '\n', dataEnd - split);
+            chunks[i].end = newline ? newline + 1 : dataEnd;
+        }
+        chunkBegin = chunks[i].end;
+    }
+    for (int i = 1; i < chunkCount; ++i) {
+        chunks[i].hasThread = pthread_create(&chunks[i].thread, NULL, parsePlayerCsvChunk, &chunks[i]) == 0;
+        if (!chunks[i].hasThread) parsePlayerCsvChunk(&chunks[i]);
+    }
+    parsePlayerCsvChunk(&chunks[0]);
+    int firstPlayerIndex = playerStore.count;
+    for (int i = 0; i < chunkCount; ++i) {
+        if (chunks[i].hasThread) pthread_join(chunks[i].thread, NULL);
+        appendPlayerColumns(&playerStore, &chunks[i].rows);
+        *rejectedRowCount += chunks[i].rejectedRowCount;
+        releasePlayerColumns(&chunks[i].rows);
+    }
+    munmap((void *)data, fileLength);
+    *rejectedRowCount += indexPlayersFromRow(firstPlayerIndex);
+    return playerStore.count - firstPlayerIndex;
+}
+
+size_t computePlayerSnapshotLayout(int count, size_t nameArenaLength, size_t *columnOffsets) {
+    size_t offset = sizeof(PlayerSnapshotHeader);
+    for (int i = 0; i < PLAYER_SNAPSHOT_COLUMN_COUNT; ++i) {
+        offset = (offset + 7) & ~(size_t)7;
+        columnOffsets[i] = offset;
+        offset += playerSnapshotElementSizes[i] * ((i == PLAYER_SNAPSHOT_COLUMN_COUNT - 1) ? nameArenaLength : (size_t)count);
+    }
+    return offset;
+}
+
+int savePlayerSnapshot(const char *path) {
+    const void *columns[PLAYER_SNAPSHOT_COLUMN_COUNT] = { playerStore.playerIds, playerStore.teamIndexes, playerStore.roles, playerStore.totalRuns, playerStore.battingAverages, playerStore.strikeRates, playerStore.wickets, playerStore.economyRates, playerStore.performanceIndexes, playerStore.nameOffsets, playerStore.nameArena };
+    size_t columnOffsets[PLAYER_SNAPSHOT_COLUMN_COUNT];
+    computePlayerSnapshotLayout(playerStore.count, playerStore.nameArenaLength, columnOffsets);
+    FILE *snapshotFile = fopen(path, "wb");
+    if (!snapshotFile) { perror(path); return -1; }
+    PlayerSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PLAYER_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = PLAYER_SNAPSHOT_VERSION;
+    header.playerCount = playerStore.count;
+    header.nameArenaLength = playerStore.nameArenaLength;
+    fwrite(&header, sizeof(header), 1, snapshotFile);
+    static const char padding[8] = { 0 };
+    size_t written = sizeof(header);
+    for (int i = 0; i < PLAYER_SNAPSHOT_COLUMN_COUNT; ++i) {
+        fwrite(padding, 1, columnOffsets[i] - written, snapshotFile);
+        size_t length = playerSnapshotElementSizes[i] * ((i == PLAYER_SNAPSHOT_COLUMN_COUNT - 1) ? playerStore.nameArenaLength : (size_t)playerStore.count);
+        if (length > 0) fwrite(columns[i], 1, length, snapshotFile);
+        written = columnOffsets[i] + length;
+    }
+    int failed = ferror(snapshotFile);
+    if (fclose(snapshotFile) != 0 || failed) { perror(path); return -1; }
+    return 0;
+}
+
+int validatePlayerSnapshotColumns(const PlayerColumnStore *view) {
+    if (view->nameArenaLength > 0 && view->nameArena[view->nameArenaLength - 1] != '\0') return 0;
+    for (int i = 0; i < view->count; ++i) {
+        if (view->teamIndexes[i] < 0 || view->teamIndexes[i] >= totalNumberOfTeamsLocal) return 0;
+        if (view->roles[i] < RoleBatsman || view->roles[i] > RoleAllRounder) return 0;
+        if (view->nameOffsets[i] >= view->nameArenaLength) return 0;
+    }
+    return 1;
+}
+
+int loadPlayerSnapshot(const char *path, long *rejectedRowCount) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) { perror(path); close(fd); return -1; }
+    size_t fileLength = (size_t)fileStat.st_size;
+    if (fileLength < sizeof(PlayerSnapshotHeader)) { fprintf(stderr, "%s: not a player snapshot\n", path); close(fd); return -1; }
+    unsigned char *mapping = mmap(NULL, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) { perror(path); return -1; }
+    const PlayerSnapshotHeader *header = (const PlayerSnapshotHeader *)mapping;
+    size_t columnOffsets[PLAYER_SNAPSHOT_COLUMN_COUNT];
+    int headerValid = memcmp(header->magic, PLAYER_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 && header->version == PLAYER_SNAPSHOT_VERSION && header->playerCount >= 0 && header->nameArenaLength <= fileLength;
+    if (!headerValid || computePlayerSnapshotLayout(header->playerCount, header->nameArenaLength, columnOffsets) > fileLength) {
+        fprintf(stderr, "%s: not a player snapshot\n", path);
+        munmap(mapping, fileLength);
+        return -1;
+    }
+    PlayerColumnStore view;
+    memset(&view, 0, sizeof(view));
+    view.playerIds = (int *)(mapping + columnOffsets[0]);
+    view.teamIndexes = (int *)(mapping + columnOffsets[1]);
+    view.roles = mapping + columnOffsets[2];
+    view.totalRuns = (long *)(mapping + columnOffsets[3]);
+    view.battingAverages = (double *)(mapping + columnOffsets[4]);
+    view.strikeRates = (double *)(mapping + columnOffsets[5]);
+    view.wickets = (int *)(mapping + columnOffsets[6]);
+    view.economyRates = (double *)(mapping + columnOffsets[7]);
+    view.performanceIndexes = (double *)(mapping + columnOffsets[8]);
+    view.nameOffsets = (size_t *)(mapping + columnOffsets[9]);
+    view.nameArena = (char *)(mapping + columnOffsets[10]);
+    view.nameArenaLength = view.nameArenaCapacity = header->nameArenaLength;
+    view.count = view.capacity = header->playerCount;
+    view.mappedSnapshot = mapping;
+    view.mappedSnapshotLength = fileLength;
+    if (!validatePlayerSnapshotColumns(&view)) {
+        fprintf(stderr, "%s: corrupt player snapshot\n", path);
+        munmap(mapping, fileLength);
+        return -1;
+    }
+    int firstPlayerIndex = playerStore.count;
+    if (playerStore.count == 0) {
+        releasePlayerColumns(&playerStore);
+        playerStore = view;
+    } else {
+        appendPlayerColumns(&playerStore, &view);
+        munmap(mapping, fileLength);
     }
-    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) recomputeAverageStrikeRateForTeam(&teamInformationArray[i]);
+    *rejectedRowCount = indexPlayersFromRow(firstPlayerIndex);
+    return playerStore.count - firstPlayerIndex;
 }
 
-void displayPlayerFullLine(const PlayerNode *p) {
-    const char *roleString = (p->role == RoleBatsman) ? "Batsman" : (p->role == RoleBowler) ? "Bowler" : "All-rounder";
-    printf("%-6d %-20s %-12s %8ld %7.2f %6.1f %6d %6.1f %11.2f\n", p->playerId, p->playerName, roleString, p->totalRuns, p->battingAverage, p->strikeRate, p->wickets, p->economyRate, p->performanceIndex);
+const char *convertRoleEnumToString(RoleType role) {
+    return (role == RoleBatsman) ? "Batsman" : (role == RoleBowler) ? "Bowler" : "All-rounder";
 }
 
-int suggestAvailablePlayerIds(void) {
+void displayPlayerFullLine(int playerIndex) {
+    printf("%-6d %-20s %-12s %8ld %7.2f %6.1f %6d %6.1f %11.2f\n", playerStore.playerIds[playerIndex], getPlayerName(playerIndex), convertRoleEnumToString((RoleType)playerStore.roles[playerIndex]), playerStore.totalRuns[playerIndex], playerStore.battingAverages[playerIndex], playerStore.strikeRates[playerIndex], playerStore.wickets[playerIndex], playerStore.economyRates[playerIndex], playerStore.performanceIndexes[playerIndex]);
+}
+
+int suggestAvailablePlayerIds(int requestedId) {
     printf("Player ID already exists. Do you want suggestions for available IDs?\n");
-    printf("1. Yes, suggest 5 available IDs\n");
+    printf("1. Yes, suggest %d available IDs\n", PLAYER_ID_SUGGESTION_COUNT);
     printf("2. No, I will enter manually\n");
 
     int choice = readIntegerInRange("Enter your choice: ", 1, 2);
     if (choice == 2) return 0;
 
-    int suggestedIds[5];
+    int suggestedIds[PLAYER_ID_SUGGESTION_COUNT];
     int count = 0;
-
-    while (count < 5) {
-        int randomId = (rand() % 1500) + 1;
-        if (!isPlayerIdAlreadyPresent(randomId)) {
-            int duplicate = 0;
-            for (int i = 0; i < count; i++) {
-                if (suggestedIds[i] == randomId) {
-                    duplicate = 1;
-                    break;
-                }
-            }
-            if (!duplicate) {
-                suggestedIds[count] = randomId;
-                count++;
-            }
-        }
+    int nextId = findNextFreeMenuPlayerId(requestedId);
+    while (nextId != -1 && count < PLAYER_ID_SUGGESTION_COUNT) {
+        if (count > 0 && nextId == suggestedIds[0]) break;
+        suggestedIds[count++] = nextId;
+        nextId = findNextFreeMenuPlayerId(nextId == MAX_MENU_PLAYER_ID ? 1 : nextId + 1);
     }
 
     printf("Available Player ID suggestions: ");
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; i < count; i++) {
         printf("%d", suggestedIds[i]);
-        if (i != 4) printf(", ");
+        if (i != count - 1) printf(", ");
     }
     printf("\n");
 
@@ -277,13 +919,14 @@ void menuAddNewPlayerToTeam(void) {
     int teamIndex = findTeamIndexById(teamId);
     if (teamIndex == -1) { printf("Team ID %d not found.\n", teamId); return; }
     TeamInformationStructure *team = &teamInformationArray[teamIndex];
-    if (team->totalPlayers >= MAX_PLAYERS_PER_TEAM) { printf("Team %s already has maximum allowed players (%d).\n", team->teamName, MAX_PLAYERS_PER_TEAM); return; }
+    if (team->aggregate.playerCount >= MAX_PLAYERS_PER_TEAM) { printf("Team %s already has maximum allowed players (%d).\n", team->teamName, MAX_PLAYERS_PER_TEAM); return; }
+    if (findNextFreeMenuPlayerId(1) == -1) { printf("All player IDs 1..%d are already in use.\n", MAX_MENU_PLAYER_ID); return; }
     int playerId;
     while (1) {
-        playerId = readIntegerInRange("Player ID (1..1500): ", 1, 1500);
+        playerId = readIntegerInRange("Player ID (1..1500): ", 1, MAX_MENU_PLAYER_ID);
         if (isPlayerIdAlreadyPresent(playerId)) {
             printf("\nERROR: A player with ID %d already exists.\n", playerId);
-            suggestAvailablePlayerIds();
+            suggestAvailablePlayerIds(playerId);
         }
         else break;
     }
@@ -296,9 +939,8 @@ void menuAddNewPlayerToTeam(void) {
     double sr = readDoubleInRange("Strike Rate (>=0): ", 0.0, 10000.0);
     int wkts = readIntegerInRange("Wickets (>=0): ", 0, 1000000);
     double er = readDoubleInRange("Economy Rate (>=0): ", 0.0, 1000.0);
-    PlayerNode *pn = createPlayerNode(playerId, name, team->teamName, role, runs, avg, sr, wkts, er);
-    insertPlayerIntoTeamAndRoleLists(pn);
-    recomputeAverageStrikeRateForTeam(team);
+    int playerIndex = createPlayerRecord(playerId, name, teamIndex, role, runs, avg, sr, wkts, er);
+    insertPlayerIntoTeamAndRoleLists(playerIndex);
     printf("Player added successfully to Team %s!\n", team->teamName);
 }
 
@@ -312,60 +954,34 @@ void menuDisplayPlayersOfSpecificTeam(void) {
     printf("=============================================================================================\n");
     printf("%-6s %-20s %-12s %8s %7s %6s %6s %6s %11s\n", "ID", "Name", "Role", "Runs", "Avg", "SR", "Wkts", "ER", "Perf.Index");
     printf("=============================================================================================\n");
-    PlayerNode *cur = team->playerListHead;
-    if (!cur) printf("(No players found)\n");
-    while (cur) {
-        displayPlayerFullLine(cur);
-        cur = cur->teamNext;
-    }
+    if (team->players.count == 0) printf("(No players found)\n");
+    for (int i = 0; i < team->players.count; ++i) displayPlayerFullLine(team->players.playerIndexes[i]);
     printf("---------------------------------------------------------------------------------------------\n");
-    printf("Total Players: %d\n", team->totalPlayers);
-    printf("Average Batting Strike Rate: %.2f\n", team->averageBattingStrikeRate);
+    printf("Total Players: %d\n", team->aggregate.playerCount);
+    printf("Average Batting Strike Rate: %.2f\n", getAverageBattingStrikeRate(&team->aggregate));
 }
 
 int compareTeamsByAverageDesc(const void *a, const void *b) {
-    const TeamInformationStructure *ta = a;
-    const TeamInformationStructure *tb = b;
-    if (ta->averageBattingStrikeRate < tb->averageBattingStrikeRate) return 1;
-    if (ta->averageBattingStrikeRate > tb->averageBattingStrikeRate) return -1;
+    double sa = getAverageBattingStrikeRate(&teamInformationArray[*(const int *)a].aggregate);
+    double sb = getAverageBattingStrikeRate(&teamInformationArray[*(const int *)b].aggregate);
+    if (sa < sb) return 1;
+    if (sa > sb) return -1;
     return 0;
 }
 
 void menuDisplayTeamsByAverageStrikeRate(void) {
     printf("\n-- Teams by Average Batting Strike Rate (desc) --\n");
-    TeamInformationStructure copyArray[MAX_TEAMS_LOCAL];
-    memcpy(copyArray, teamInformationArray, sizeof(teamInformationArray));
-    qsort(copyArray, totalNumberOfTeamsLocal, sizeof(TeamInformationStructure), compareTeamsByAverageDesc);
-    printf("=============================================================\n");
-    printf("%-4s %-15s %-18s %-12s\n", "ID", "Team Name", "Avg Bat SR", "Total Players");
-    printf("=============================================================\n");
+    int teamOrder[MAX_TEAMS_LOCAL];
+    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) teamOrder[i] = i;
+    qsort(teamOrder, totalNumberOfTeamsLocal, sizeof(int), compareTeamsByAverageDesc);
+    printf("==============================================================================================================\n");
+    printf("%-4s %-15s %-18s %-14s %-12s %-10s %-10s %-10s\n", "ID", "Team Name", "Avg Bat SR", "Total Players", "Total Runs", "Wickets", "Mean ER", "Mean PI");
+    printf("==============================================================================================================\n");
     for (int i = 0; i < totalNumberOfTeamsLocal; ++i) {
-        printf("%-4d %-15s %-18.2f %-12d\n", copyArray[i].teamId, copyArray[i].teamName, copyArray[i].averageBattingStrikeRate, copyArray[i].totalPlayers);
-    }
-}
-
-PlayerNode **gatherPlayersOfTeamByRole(TeamInformationStructure *team, RoleType role, int *outCount) {
-    int cap = 16;
-    PlayerNode **arr = malloc(cap * sizeof(PlayerNode *));
-    int cnt = 0;
-    PlayerNode *cur = team->playerListHead;
-    while (cur) {
-        if (cur->role == role) {
-            if (cnt >= cap) { cap *= 2; arr = realloc(arr, cap * sizeof(PlayerNode *)); }
-            arr[cnt++] = cur;
-        }
-        cur = cur->teamNext;
+        const TeamInformationStructure *team = &teamInformationArray[teamOrder[i]];
+        const PlayerAggregate *aggregate = &team->aggregate;
+        printf("%-4d %-15s %-18.2f %-14d %-12ld %-10ld %-10.2f %-10.2f\n", team->teamId, team->teamName, getAverageBattingStrikeRate(aggregate), aggregate->playerCount, aggregate->totalRuns, aggregate->totalWickets, computeAggregateMean(aggregate->economyRateSum, aggregate->economyRateCount), computeAggregateMean(aggregate->performanceIndexSum, aggregate->playerCount));
     }
-    *outCount = cnt;
-    return arr;
-}
-
-int comparePlayersByPerformanceDesc(const void *a, const void *b) {
-    const PlayerNode *pa = *(const PlayerNode **)a;
-    const PlayerNode *pb = *(const PlayerNode **)b;
-    if (pa->performanceIndex < pb->performanceIndex) return 1;
-    if (pa->performanceIndex > pb->performanceIndex) return -1;
-    return 0;
 }
 
 void menuDisplayTopKPlayersOfSpecificTeamByRole(void) {
@@ -377,69 +993,75 @@ void menuDisplayTopKPlayersOfSpecificTeamByRole(void) {
     int roleChoice = readIntegerInRange("Enter Role (1-Batsman, 2-Bowler, 3-All-rounder): ", 1, 3);
     RoleType role = (RoleType)roleChoice;
     int k = readIntegerInRange("Enter number of players (K): ", 1, 1000);
-    int count = 0;
-    PlayerNode **arr = gatherPlayersOfTeamByRole(team, role, &count);
-    if (count == 0) {
+    const PlayerIndexList *ranking = &teamRolePerformanceRankings[idx][role];
+    if (ranking->count == 0) {
         printf("No players of that role in team %s.\n", team->teamName);
-        free(arr);
         return;
     }
-    qsort(arr, count, sizeof(PlayerNode *), comparePlayersByPerformanceDesc);
-    if (k > count) k = count;
+    if (k > ranking->count) k = ranking->count;
     printf("\nTop %d players of role %d in Team %s:\n", k, role, team->teamName);
     printf("=============================================================================================\n");
     printf("%-6s %-20s %-12s %8s %7s %6s %6s %6s %11s\n", "ID", "Name", "Role", "Runs", "Avg", "SR", "Wkts", "ER", "Perf.Index");
     printf("=============================================================================================\n");
-    for (int i = 0; i < k; ++i) displayPlayerFullLine(arr[i]);
-    free(arr);
-}
-
-PlayerNode **gatherPlayersByRoleGlobal(RoleType role, int *outCount) {
-    int cap = 64;
-    PlayerNode **arr = malloc(cap * sizeof(PlayerNode *));
-    int cnt = 0;
-    PlayerNode *cur = roleListHeads[role];
-    while (cur) {
-        if (cnt >= cap) { cap *= 2; arr = realloc(arr, cap * sizeof(PlayerNode *)); }
-        arr[cnt++] = cur;
-        cur = cur->roleNext;
-    }
-    *outCount = cnt;
-    return arr;
+    for (int i = 0; i < k; ++i) displayPlayerFullLine(ranking->playerIndexes[i]);
 }
 
 void menuDisplayAllPlayersOfSpecificRoleAcrossTeams(void) {
     printf("\n-- Display All Players of Specific Role Across All Teams --\n");
     int roleChoice = readIntegerInRange("Enter Role (1-Batsman, 2-Bowler, 3-All-rounder): ", 1, 3);
     RoleType role = (RoleType)roleChoice;
-    int count = 0;
-    PlayerNode **arr = gatherPlayersByRoleGlobal(role, &count);
-    if (count == 0) { printf("No players of that role found across teams.\n"); free(arr); return; }
-    qsort(arr, count, sizeof(PlayerNode *), comparePlayersByPerformanceDesc);
+    const PlayerIndexList *ranking = &rolePerformanceRankings[role];
+    if (ranking->count == 0) { printf("No players of that role found across teams.\n"); return; }
     printf("\nPlayers (Role %d) across all teams sorted by Performance Index (desc):\n", role);
     printf("=============================================================================================\n");
     printf("%-6s %-20s %-15s %-12s %8s %7s %6s %6s %11s\n", "ID", "Name", "Team", "Role", "Runs", "Avg", "SR", "Wkts", "Perf.Index");
     printf("=============================================================================================\n");
-    for (int i = 0; i < count; ++i) {
-        PlayerNode *p = arr[i];
-        const char *roleString = (p->role == RoleBatsman) ? "Batsman" : (p->role == RoleBowler) ? "Bowler" : "All-rounder";
-        printf("%-6d %-20s %-15s %-12s %8ld %7.2f %6.1f %6d %11.2f\n", p->playerId, p->playerName, p->teamName, roleString, p->totalRuns, p->battingAverage, p->strikeRate, p->wickets, p->performanceIndex);
+    for (int i = 0; i < ranking->count; ++i) {
+        int p = ranking->playerIndexes[i];
+        printf("%-6d %-20s %-15s %-12s %8ld %7.2f %6.1f %6d %11.2f\n", playerStore.playerIds[p], getPlayerName(p), teamInformationArray[playerStore.teamIndexes[p]].teamName, convertRoleEnumToString((RoleType)playerStore.roles[p]), playerStore.totalRuns[p], playerStore.battingAverages[p], playerStore.strikeRates[p], playerStore.wickets[p], playerStore.performanceIndexes[p]);
     }
-    free(arr);
+    const PlayerAggregate *aggregate = &roleAggregates[role];
+    printf("---------------------------------------------------------------------------------------------\n");
+    printf("Total Players: %d, Total Runs: %ld, Wickets: %ld\n", aggregate->playerCount, aggregate->totalRuns, aggregate->totalWickets);
+    printf("Average Batting Strike Rate: %.2f, Mean Economy Rate: %.2f, Mean Performance Index: %.2f\n", getAverageBattingStrikeRate(aggregate), computeAggregateMean(aggregate->economyRateSum, aggregate->economyRateCount), computeAggregateMean(aggregate->performanceIndexSum, aggregate->playerCount));
 }
 
 void freeAllAllocatedMemoryAndExit(void) {
-    for (size_t i = 0; i < allocatedPlayerPointerCount; ++i) free(allocatedPlayerPointers[i]);
-    free(allocatedPlayerPointers);
-    allocatedPlayerPointers = NULL;
-    allocatedPlayerPointerCount = allocatedPlayerPointerCapacity = 0;
-    for (int r = 1; r <= 3; ++r) roleListHeads[r] = NULL;
-    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) teamInformationArray[i].playerListHead = NULL;
+    releasePlayerColumns(&playerStore);
+    releasePlayerIdIndex();
+    for (int r = 1; r <= 3; ++r) {
+        freePlayerIndexList(&rolePerformanceRankings[r]);
+        for (int i = 0; i < totalNumberOfTeamsLocal; ++i) freePlayerIndexList(&teamRolePerformanceRankings[i][r]);
+    }
+    for (int i = 0; i < totalNumberOfTeamsLocal; ++i) freePlayerIndexList(&teamInformationArray[i].players);
 }
 
-int main(void) {
+int main(int argc, char *argv[]) {
     initializeTeamInformationArrayAlphabetical();
-    loadPlayersFromHeaderIntoStructures();
+    const char *saveSnapshotPath = NULL;
+    int loadedExternalData = 0;
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--csv") == 0 || strcmp(argv[i], "--snapshot") == 0) && i + 1 < argc) {
+            int isCsv = strcmp(argv[i], "--csv") == 0;
+            const char *path = argv[++i];
+            long rejectedRowCount = 0;
+            double startSeconds = getMonotonicSeconds();
+            int loadedCount = isCsv ? loadPlayersFromCsvFile(path, &rejectedRowCount) : loadPlayerSnapshot(path, &rejectedRowCount);
+            if (loadedCount < 0) { freeAllAllocatedMemoryAndExit(); return 1; }
+            printf("Loaded %d players from %s in %.3f s (%ld rows rejected)\n", loadedCount, path, getMonotonicSeconds() - startSeconds, rejectedRowCount);
+            loadedExternalData = 1;
+        } else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            saveSnapshotPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--csv <file>]... [--snapshot <file>]... [--save-snapshot <file>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!loadedExternalData) loadPlayersFromHeaderIntoStructures();
+    if (saveSnapshotPath) {
+        if (savePlayerSnapshot(saveSnapshotPath) != 0) { freeAllAllocatedMemoryAndExit(); return 1; }
+        printf("Saved %d players to %s\n", playerStore.count, saveSnapshotPath);
+    }
     while (1) {
         printf("\n=============================================================================\n");
         printf("ICC ODI Player Performance Analyzer\n");
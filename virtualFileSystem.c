@@ -1,12 +1,116 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sched.h>
 
-#define BLOCK_SIZE 512
+#define VFS_BLOCK_SIZE 512
 #define TOTAL_BLOCKS 1024
 #define MAX_NAME_LEN 50
 #define MAX_CMD_LEN 2048
+#define DEDUP_BUCKET_COUNT 1024
+#define COMPRESSION_EXTENT_BLOCKS 8
+#define COMPRESSION_EXTENT_SIZE (COMPRESSION_EXTENT_BLOCKS * VFS_BLOCK_SIZE)
+#define MAX_FILE_SIZE (INT_MAX - (VFS_BLOCK_SIZE - 1))
+#define COMPRESSION_HASH_BITS 12
+#define MAX_PATH_LEN 1024
+#define PATH_CACHE_INITIAL_BUCKETS 256
+#define SHELL_STATS_MAX_TYPES 64
+#define HOST_IO_CHUNK_SIZE (64 * 1024)
+#define HOST_IO_VECTOR_COUNT 64
+#define BLOCK_CACHE_FRAME_COUNT 256
+#define BLOCK_CACHE_IO_VECTOR_COUNT 64
+#define BLOCK_CACHE_READAHEAD_MIN_BLOCKS 4
+#define BLOCK_CACHE_READAHEAD_MAX_BLOCKS 64
+#define DECOMPRESSED_EXTENT_CACHE_SLOTS 16
+#define BLOCK_IO_QUEUE_DEPTH 64
+#define BLOCK_IO_WORKER_COUNT 4
+#define BLOCK_IO_BACKEND_SYNC 0
+#define BLOCK_IO_BACKEND_URING 1
+#define BLOCK_IO_BACKEND_THREADS 2
+#define BLOCK_ALLOCATOR_SHARD_COUNT 4
+#define MAX_SHELL_SESSIONS 64
+#define NAME_INDEX_MAX_HEIGHT 64
+#define LISTING_BUFFER_SIZE (64 * 1024)
+#define DEFRAG_STEP_BLOCK_BUDGET 256
+#define OBJECT_SLAB_OBJECT_COUNT 1024
+#define OBJECT_SLAB_ALIGNMENT 16
+#define NAME_ARENA_CHUNK_SIZE (64 * 1024)
+#define NAME_ARENA_SIZE_CLASS_BYTES 8
+#define NAME_INTERN_INITIAL_BUCKETS 1024
+#define DEFRAG_BACKGROUND_INTERVAL_MS 500
+#define INLINE_ATTRIBUTE_BYTES 40
+#define ATTRIBUTE_NAME_MAX_LEN 64
+#define ATTRIBUTE_VALUE_MAX_LEN 255
+#define DEFAULT_FILE_MODE 0644
+#define DEFAULT_DIRECTORY_MODE 0755
+#define ACCESS_TIME_REFRESH_NANOS (24L * 3600L * 1000000000L)
+#define SUBTREE_TIME_GRANULARITY_NANOS 1000000L
+#define SHELL_BATCH_OUTPUT_BUFFER (1 << 20)
+#define BENCHMARK_WIDE_FILE_COUNT 100000
+#define BENCHMARK_DEEP_LEVEL_COUNT 48
+#define BENCHMARK_DEEP_FILES_PER_LEVEL 1000
+#define BENCHMARK_SEQUENTIAL_FILE_BLOCKS (TOTAL_BLOCKS / 2)
+#define BENCHMARK_SEQUENTIAL_PASS_COUNT 64
+#define BENCHMARK_RANDOM_FILE_BLOCKS (TOTAL_BLOCKS / 4)
+#define BENCHMARK_RANDOM_OPERATION_COUNT 100000
+#define BENCHMARK_APPEND_STREAM_COUNT 16
+#define BENCHMARK_APPEND_STREAM_BLOCKS 32
+#define BENCHMARK_APPEND_RECORD_SIZE 200
+#define BENCHMARK_APPEND_ROUND_COUNT 16
+#define BENCHMARK_CHUNK_SIZE 4096
+#define VFS_SERVER_MAX_CONNECTIONS 32
+#define VFS_SERVER_BUFFER_SIZE (256 * 1024)
+#define VFS_FRAME_HEADER_SIZE 9
+#define VFS_FRAME_MAX_PAYLOAD (VFS_SERVER_BUFFER_SIZE - VFS_FRAME_HEADER_SIZE)
+#define VFS_READDIR_MAX_ENTRIES 256
+#define VFS_CLIENT_PIPELINE_DEPTH 32
+#define VFS_OP_LOOKUP 1
+#define VFS_OP_READDIR 2
+#define VFS_OP_READ 3
+#define VFS_OP_WRITE 4
+#define VFS_OP_CREATE 5
+#define VFS_OP_UNLINK 6
+#define VFS_OP_TRUNCATE 7
+#define VFS_STATUS_OK 0
+#define VFS_STATUS_NOT_FOUND 1
+#define VFS_STATUS_EXISTS 2
+#define VFS_STATUS_INVALID 3
+#define VFS_STATUS_NO_SPACE 4
+#define VFS_STATUS_NOT_EMPTY 5
+#define VFS_STATUS_IS_DIRECTORY 6
+#define VFS_STATUS_NOT_DIRECTORY 7
+#define VFS_STATUS_BUSY 8
+#define JOURNAL_RECORD_CREATE 1
+#define JOURNAL_RECORD_REMOVE 2
+#define JOURNAL_RECORD_FILE_MAP 3
+#define JOURNAL_RECORD_CLONE 4
+#define JOURNAL_RECORD_COMMIT 5
+#define JOURNAL_RECORD_LINK 6
+#define JOURNAL_RECORD_MOVE 7
+#define JOURNAL_RECORD_ATTRIBUTES 8
+#define JOURNAL_HEADER_SIZE 9
+#define JOURNAL_GROUP_COMMIT_RECORDS 512
+#define JOURNAL_GROUP_COMMIT_BYTES (256 * 1024)
+#define JOURNAL_COMMIT_INTERVAL_MS 50
+#define JOURNAL_CHECKPOINT_BYTES (8 * 1024 * 1024)
 
 typedef struct FreeBlockNode {
     int blockIndex;
@@ -14,25 +118,333 @@ typedef struct FreeBlockNode {
     struct FreeBlockNode *next;
 } FreeBlockNode;
 
+typedef struct BlockAllocatorShard {
+    pthread_mutex_t lock;
+    FreeBlockNode *freeHead;
+    FreeBlockNode *freeTail;
+    int freeCount;
+} BlockAllocatorShard;
+
+typedef struct VfsBlockMap {
+    int *blocks;
+    int *extentCompressedLengths;
+    int blockCount;
+    int blockCapacity;
+    int referenceCount;
+} VfsBlockMap;
+
+typedef struct VfsInode {
+    VfsBlockMap *blockMap;
+    int fileSize;
+    int linkCount;
+    long modifyTime;
+    long changeTime;
+    long accessTime;
+    int attributeBlock;
+    unsigned short attributeLength;
+    unsigned short mode;
+    unsigned char inlineAttributes[INLINE_ATTRIBUTE_BYTES];
+    pthread_rwlock_t inodeLock;
+} VfsInode;
+
 typedef struct VfsNode {
-    char name[MAX_NAME_LEN + 1];
+    const char *name;
+    int nodeId;
     int isDirectory;
     struct VfsNode *parent;
     struct VfsNode *firstChild;
     struct VfsNode *nextSibling;
     struct VfsNode *prevSibling;
-    int *allocatedBlocks;
-    int allocatedBlockCount;
-    int fileSize;
+    struct VfsNode *nameIndexRoot;
+    struct VfsNode *nameIndexLeft;
+    struct VfsNode *nameIndexRight;
+    int nameIndexHeight;
+    int childCount;
+    struct VfsInode *inode;
+    struct VfsNode *nextLink;
+    long subtreeSize;
+    long subtreeModifyTime;
+    char *cachedPath;
+    int cachedPathGeneration;
+    struct PathCacheEntry *pathCacheEntry;
 } VfsNode;
 
+typedef struct PathCacheEntry {
+    char *path;
+    int pathLength;
+    unsigned int pathHash;
+    int generation;
+    VfsNode *node;
+    struct PathCacheEntry *next;
+} PathCacheEntry;
+
+typedef struct VfsFileHandle {
+    VfsNode *fileNode;
+    int position;
+    int openFlags;
+    int sequentialEnd;
+    int readaheadWindow;
+    int readaheadEndSlot;
+} VfsFileHandle;
+
+typedef struct DecompressedExtentEntry {
+    const VfsBlockMap *blockMap;
+    int extent;
+    int rawLength;
+    unsigned char data[COMPRESSION_EXTENT_SIZE];
+} DecompressedExtentEntry;
+
+typedef struct BlockCacheFrame {
+    int blockIndex;
+    int pinCount;
+    unsigned char isDirty;
+    unsigned char isReferenced;
+    unsigned char *data;
+} BlockCacheFrame;
+
+typedef struct BlockIoRequest {
+    struct iovec *vectors;
+    int vectorCount;
+    int isWrite;
+    off_t offset;
+    ssize_t result;
+} BlockIoRequest;
+
+typedef struct BlockIoRing {
+    int ringDescriptor;
+    void *submissionRing;
+    void *completionRing;
+    size_t submissionRingSize;
+    size_t completionRingSize;
+    struct io_uring_sqe *submissionEntries;
+    size_t submissionEntriesSize;
+    unsigned *submissionTail;
+    unsigned *submissionMask;
+    unsigned *submissionArray;
+    unsigned *completionHead;
+    unsigned *completionTail;
+    unsigned *completionMask;
+    struct io_uring_cqe *completionEntries;
+    unsigned entryCount;
+} BlockIoRing;
+
+typedef struct BlockIoWorkerPool {
+    pthread_t threads[BLOCK_IO_WORKER_COUNT];
+    int threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t workAvailable;
+    pthread_cond_t workFinished;
+    BlockIoRequest *requests;
+    int requestCount;
+    int nextRequest;
+    int finishedCount;
+    int stopRequested;
+} BlockIoWorkerPool;
+
+typedef struct VfsTraversalFrame {
+    VfsNode *node;
+    VfsNode *context;
+} VfsTraversalFrame;
+
+typedef struct VfsTraversalStack {
+    VfsTraversalFrame *frames;
+    int count;
+    int capacity;
+} VfsTraversalStack;
+
+typedef struct ListingBuffer {
+    char data[LISTING_BUFFER_SIZE];
+    int length;
+} ListingBuffer;
+
+typedef struct ListingEntry {
+    VfsNode *node;
+    long size;
+} ListingEntry;
+
+typedef struct ObjectSlab {
+    struct ObjectSlab *next;
+} ObjectSlab;
+
+typedef struct ObjectPool {
+    size_t objectSize;
+    ObjectSlab *slabs;
+    void *freeList;
+    int slabCount;
+    int liveCount;
+    pthread_mutex_t lock;
+} ObjectPool;
+
+typedef struct InternedName {
+    struct InternedName *next;
+    unsigned int hash;
+    int referenceCount;
+    int length;
+    char text[];
+} InternedName;
+
+typedef struct NameArenaChunk {
+    struct NameArenaChunk *next;
+    size_t used;
+    char data[NAME_ARENA_CHUNK_SIZE];
+} NameArenaChunk;
+
+typedef struct ShellSession {
+    const char *scriptPath;
+    int sessionId;
+    int exitStatus;
+} ShellSession;
+
+typedef struct VfsFrameBuffer {
+    unsigned char *data;
+    int length;
+    int capacity;
+    int frameStart;
+} VfsFrameBuffer;
+
+typedef struct VfsBenchmarkPhase {
+    const char *label;
+    long operationCount;
+    long byteCount;
+    double startSeconds;
+} VfsBenchmarkPhase;
+
+typedef struct VfsServerConnection {
+    pthread_t thread;
+    int socketDescriptor;
+    int isActive;
+    int hasThread;
+} VfsServerConnection;
+
+typedef struct ShellCommandStats {
+    char name[16];
+    long commandCount;
+    long errorCount;
+} ShellCommandStats;
+
+#define VFS_OPEN_READ 1
+#define VFS_OPEN_WRITE 2
+#define VFS_OPEN_APPEND 4
+#define VFS_OPEN_TRUNCATE 8
+
+#define NAME_ARENA_SIZE_CLASS_COUNT ((sizeof(InternedName) + MAX_NAME_LEN + NAME_ARENA_SIZE_CLASS_BYTES) / NAME_ARENA_SIZE_CLASS_BYTES + 1)
+
+ObjectPool vfsNodePool = {sizeof(VfsNode), NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+ObjectPool vfsInodePool = {sizeof(VfsInode), NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+NameArenaChunk *nameArenaChunks = NULL;
+InternedName *nameArenaFreeLists[NAME_ARENA_SIZE_CLASS_COUNT];
+InternedName **nameInternBuckets = NULL;
+int nameInternBucketCount = 0;
+int nameInternCount = 0;
+long nameArenaBytesUsed = 0;
+pthread_mutex_t nameArenaLock = PTHREAD_MUTEX_INITIALIZER;
 unsigned char *virtualDisk = NULL;
-FreeBlockNode *freeBlockHead = NULL;
-FreeBlockNode *freeBlockTail = NULL;
+const unsigned char zeroDiskBlock[VFS_BLOCK_SIZE] = {0};
+BlockAllocatorShard blockAllocatorShards[BLOCK_ALLOCATOR_SHARD_COUNT];
 int usedBlockCount = 0;
+int blockReservationTotal = 0;
+__thread int threadReservedBlockCount = 0;
+int *blockReferenceCounts = NULL;
+long blockReferenceTotal = 0;
+
+int dedupEnabled = 0;
+int dedupMergedBlockCount = 0;
+int *dedupBucketHeads = NULL;
+int *dedupNextInBucket = NULL;
+unsigned long long *blockFingerprints = NULL;
+unsigned char *blockIsIndexed = NULL;
+
+int compressionEnabled = 0;
+int compressionBypassCount = 0;
+long compressedLogicalBlockTotal = 0;
+long compressedPhysicalBlockTotal = 0;
 
 VfsNode *rootDirectory = NULL;
-VfsNode *currentDirectory = NULL;
+__thread VfsNode *currentDirectory = NULL;
+int nextNodeId = 0;
+
+PathCacheEntry **pathCacheBuckets = NULL;
+int pathCacheBucketCount = 0;
+int pathCacheEntryCount = 0;
+int pathCacheGeneration = 0;
+long pathCacheHitCount = 0;
+long pathCacheMissCount = 0;
+
+int batchModeEnabled = 0;
+int stopOnFirstError = 0;
+__thread ShellCommandStats shellCommandStats[SHELL_STATS_MAX_TYPES];
+__thread int shellCommandStatsCount = 0;
+__thread int shellSessionId = 0;
+__thread int shellExitRequested = 0;
+VfsNode **sessionDirectorySlots[MAX_SHELL_SESSIONS];
+pthread_mutex_t sessionRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_rwlock_t vfsTreeLock;
+pthread_mutex_t pathCacheLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t dedupLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t blockCacheLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t decompressedExtentCacheLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t pendingFreeLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t journalLock;
+
+int imageFileDescriptor = -1;
+int journalFileDescriptor = -1;
+char journalPath[MAX_PATH_LEN];
+int journalReplayInProgress = 0;
+long journalReplayTimestamp = 0;
+long lastVfsTimestamp = 0;
+unsigned char *journalBuffer = NULL;
+size_t journalBufferLength = 0;
+size_t journalBufferCapacity = 0;
+size_t journalRecordStart = 0;
+int journalPendingRecordCount = 0;
+long journalFirstPendingMillis = 0;
+long journalCommitCount = 0;
+long journalRecordTotal = 0;
+long journalFileSize = 0;
+int *pendingFreeBlocks = NULL;
+int pendingFreeBlockCount = 0;
+__thread int *threadPendingFreeBlocks = NULL;
+__thread int threadPendingFreeCount = 0;
+__thread int threadPendingFreeCapacity = 0;
+int journalCheckpointRequested = 0;
+VfsServerConnection serverConnections[VFS_SERVER_MAX_CONNECTIONS];
+volatile sig_atomic_t serverStopRequested = 0;
+long serverRequestTotal = 0;
+pthread_mutex_t defragBackgroundLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t defragBackgroundCondition = PTHREAD_COND_INITIALIZER;
+int defragBackgroundRunning = 0;
+int defragBackgroundStopRequested = 0;
+long defragBackgroundRelocatedBlockTotal = 0;
+pthread_mutex_t journalCommitTimerLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t journalCommitTimerCondition = PTHREAD_COND_INITIALIZER;
+int journalCommitTimerRunning = 0;
+int journalCommitTimerArmed = 0;
+long journalCommitTimerDueMillis = 0;
+int journalCommitTimerStopRequested = 0;
+BlockCacheFrame *blockCacheFrames = NULL;
+unsigned char *blockCacheData = NULL;
+int *blockCacheFrameOfBlock = NULL;
+int blockCacheClockHand = 0;
+int blockCacheDirtyFrameCount = 0;
+int imageNeedsSync = 0;
+long blockCacheHitCount = 0;
+long blockCacheMissCount = 0;
+long blockCacheReadaheadCount = 0;
+long blockCacheWritebackBlockCount = 0;
+long blockCacheWritebackBatchCount = 0;
+DecompressedExtentEntry decompressedExtentCache[DECOMPRESSED_EXTENT_CACHE_SLOTS];
+long decompressedExtentCacheGeneration = 0;
+long decompressedExtentCacheHitCount = 0;
+long decompressedExtentCacheMissCount = 0;
+int requestedBlockIoBackend = BLOCK_IO_BACKEND_URING;
+int blockIoBackend = BLOCK_IO_BACKEND_SYNC;
+BlockIoRing blockIoRing = {.ringDescriptor = -1};
+BlockIoWorkerPool blockIoWorkerPool;
+long blockIoSubmissionCount = 0;
+long blockIoRequestCount = 0;
+int blockIoMaxInFlight = 0;
+VfsNode **journalNodeTable = NULL;
+int journalNodeTableCapacity = 0;
 
 void exitWithError(const char *message) {
     fprintf(stderr, "%s\n", message);
@@ -47,529 +459,5536 @@ FreeBlockNode* createFreeBlockNode(int blockIndex) {
     return node;
 }
 
-void initializeFreeBlockList(int totalBlocks) {
-    freeBlockHead = freeBlockTail = NULL;
-    for (int i = 0; i < totalBlocks; ++i) {
-        FreeBlockNode *node = createFreeBlockNode(i);
-        if (!freeBlockHead) {
-            freeBlockHead = freeBlockTail = node;
-        } else {
-            freeBlockTail->next = node;
-            node->prev = freeBlockTail;
-            freeBlockTail = node;
-        }
-    }
+BlockAllocatorShard* getAllocatorShardOfBlock(int blockIndex) {
+    return &blockAllocatorShards[blockIndex / (TOTAL_BLOCKS / BLOCK_ALLOCATOR_SHARD_COUNT)];
 }
 
-int allocateFreeBlock() {
-    if (!freeBlockHead) return -1;
-    FreeBlockNode *node = freeBlockHead;
-    int blockIndex = node->blockIndex;
-    freeBlockHead = node->next;
-    if (freeBlockHead) {
-        freeBlockHead->prev = NULL;
+void appendBlockToFreeList(int blockIndex) {
+    FreeBlockNode *node = createFreeBlockNode(blockIndex);
+    BlockAllocatorShard *shard = getAllocatorShardOfBlock(blockIndex);
+    pthread_mutex_lock(&shard->lock);
+    if (!shard->freeTail) {
+        shard->freeHead = shard->freeTail = node;
     } else {
-        freeBlockTail = NULL;
+        shard->freeTail->next = node;
+        node->prev = shard->freeTail;
+        shard->freeTail = node;
     }
-    free(node);
-    usedBlockCount++;
-    return blockIndex;
+    __atomic_add_fetch(&shard->freeCount, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&shard->lock);
 }
 
-void releaseFreeBlock(int blockIndex) {
-    FreeBlockNode *node = createFreeBlockNode(blockIndex);
-    if (!freeBlockTail) {
-        freeBlockHead = freeBlockTail = node;
-    } else {
-        freeBlockTail->next = node;
-        node->prev = freeBlockTail;
-        freeBlockTail = node;
+void releaseFreeBlockList() {
+    for (int i = 0; i < BLOCK_ALLOCATOR_SHARD_COUNT; ++i) {
+        FreeBlockNode *cursor = blockAllocatorShards[i].freeHead;
+        while (cursor) {
+            FreeBlockNode *next = cursor->next;
+            free(cursor);
+            cursor = next;
+        }
+        blockAllocatorShards[i].freeHead = blockAllocatorShards[i].freeTail = NULL;
+        blockAllocatorShards[i].freeCount = 0;
+    }
+}
+
+void initializeFreeBlockList(int totalBlocks) {
+    for (int i = 0; i < BLOCK_ALLOCATOR_SHARD_COUNT; ++i) {
+        pthread_mutex_init(&blockAllocatorShards[i].lock, NULL);
+        blockAllocatorShards[i].freeHead = blockAllocatorShards[i].freeTail = NULL;
+        blockAllocatorShards[i].freeCount = 0;
     }
-    usedBlockCount--;
+    for (int i = 0; i < totalBlocks; ++i) appendBlockToFreeList(i);
 }
 
 int getFreeBlockCount() {
-    return TOTAL_BLOCKS - usedBlockCount;
+    return TOTAL_BLOCKS - __atomic_load_n(&usedBlockCount, __ATOMIC_RELAXED);
 }
 
-VfsNode* createVfsNode(const char *name, int isDirectory, VfsNode *parent) {
-    if (strlen(name) > MAX_NAME_LEN) return NULL;
-    VfsNode *node = malloc(sizeof(VfsNode));
-    if (!node) exitWithError("Out of memory");
-    strncpy(node->name, name, MAX_NAME_LEN);
-    node->name[MAX_NAME_LEN] = '\0';
-    node->isDirectory = isDirectory;
-    node->parent = parent;
-    node->firstChild = NULL;
-    node->nextSibling = node->prevSibling = NULL;
-    node->allocatedBlocks = NULL;
-    node->allocatedBlockCount = 0;
-    node->fileSize = 0;
-    return node;
+int reserveFreeBlocks(int blockCount) {
+    if (blockCount <= 0) return 1;
+    int reservedTotal = __atomic_load_n(&blockReservationTotal, __ATOMIC_RELAXED);
+    do {
+        if (getFreeBlockCount() - reservedTotal < blockCount) return 0;
+    } while (!__atomic_compare_exchange_n(&blockReservationTotal, &reservedTotal, reservedTotal + blockCount, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    threadReservedBlockCount += blockCount;
+    return 1;
 }
 
-int attachChildNode(VfsNode *parent, VfsNode *child) {
-    if (!parent || !parent->isDirectory) return -1;
-    if (!parent->firstChild) {
-        parent->firstChild = child;
-        child->nextSibling = child->prevSibling = child;
-    } else {
-        VfsNode *first = parent->firstChild;
-        VfsNode *last = first->prevSibling;
-        last->nextSibling = child;
-        child->prevSibling = last;
-        child->nextSibling = first;
-        first->prevSibling = child;
+void releaseBlockReservation() {
+    __atomic_sub_fetch(&blockReservationTotal, threadReservedBlockCount, __ATOMIC_RELAXED);
+    threadReservedBlockCount = 0;
+}
+
+int getPreferredAllocatorShard() {
+    int cpu = sched_getcpu();
+    return cpu > 0 ? cpu % BLOCK_ALLOCATOR_SHARD_COUNT : 0;
+}
+
+int allocateFreeBlock() {
+    if (threadReservedBlockCount == 0 && !reserveFreeBlocks(1)) return -1;
+    int preferredShard = getPreferredAllocatorShard();
+    for (int attempt = 0; attempt < BLOCK_ALLOCATOR_SHARD_COUNT; ++attempt) {
+        BlockAllocatorShard *shard = &blockAllocatorShards[(preferredShard + attempt) % BLOCK_ALLOCATOR_SHARD_COUNT];
+        if (__atomic_load_n(&shard->freeCount, __ATOMIC_RELAXED) == 0) continue;
+        pthread_mutex_lock(&shard->lock);
+        FreeBlockNode *node = shard->freeHead;
+        if (node) {
+            shard->freeHead = node->next;
+            if (shard->freeHead) {
+                shard->freeHead->prev = NULL;
+            } else {
+                shard->freeTail = NULL;
+            }
+            __atomic_sub_fetch(&shard->freeCount, 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (!node) continue;
+        int blockIndex = node->blockIndex;
+        free(node);
+        __atomic_add_fetch(&usedBlockCount, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&blockReferenceCounts[blockIndex], 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&blockReferenceTotal, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&blockReservationTotal, 1, __ATOMIC_RELAXED);
+        threadReservedBlockCount--;
+        return blockIndex;
     }
-    child->parent = parent;
-    return 0;
+    return -1;
 }
 
-int detachChildNode(VfsNode *parent, VfsNode *child) {
-    if (!parent || !parent->isDirectory || !parent->firstChild || !child) return -1;
-    if (parent->firstChild == child && child->nextSibling == child) {
-        parent->firstChild = NULL;
-    } else {
-        if (parent->firstChild == child) parent->firstChild = child->nextSibling;
-        child->prevSibling->nextSibling = child->nextSibling;
-        child->nextSibling->prevSibling = child->prevSibling;
+void queueThreadPendingFree(int blockIndex) {
+    if (threadPendingFreeCount == threadPendingFreeCapacity) {
+        int newCapacity = threadPendingFreeCapacity > 0 ? threadPendingFreeCapacity * 2 : 64;
+        int *newBlocks = realloc(threadPendingFreeBlocks, sizeof(int) * newCapacity);
+        if (!newBlocks) exitWithError("Out of memory");
+        threadPendingFreeBlocks = newBlocks;
+        threadPendingFreeCapacity = newCapacity;
     }
-    child->nextSibling = child->prevSibling = NULL;
-    child->parent = NULL;
-    return 0;
+    threadPendingFreeBlocks[threadPendingFreeCount++] = blockIndex;
 }
 
-VfsNode* findChildNode(VfsNode *parent, const char *name) {
-    if (!parent || !parent->isDirectory) return NULL;
-    VfsNode *head = parent->firstChild;
-    if (!head) return NULL;
-    VfsNode *node = head;
-    do {
-        if (strcmp(node->name, name) == 0) return node;
-        node = node->nextSibling;
-    } while (node != head);
-    return NULL;
+void publishThreadPendingFrees() {
+    if (threadPendingFreeCount == 0) return;
+    pthread_mutex_lock(&pendingFreeLock);
+    memcpy(pendingFreeBlocks + pendingFreeBlockCount, threadPendingFreeBlocks, sizeof(int) * threadPendingFreeCount);
+    pendingFreeBlockCount += threadPendingFreeCount;
+    pthread_mutex_unlock(&pendingFreeLock);
+    threadPendingFreeCount = 0;
 }
 
-void freeVfsNode(VfsNode *node) {
-    if (!node) return;
-    if (node->allocatedBlocks) {
-        free(node->allocatedBlocks);
-        node->allocatedBlocks = NULL;
-    }
-    free(node);
+void releaseThreadPendingFrees() {
+    publishThreadPendingFrees();
+    free(threadPendingFreeBlocks);
+    threadPendingFreeBlocks = NULL;
+    threadPendingFreeCapacity = 0;
 }
 
-int writeFileContent(VfsNode *fileNode, const unsigned char *content, int size) {
-    if (!fileNode || fileNode->isDirectory) return -1;
-    if (size < 0) size = 0;
-    int requiredBlocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    if (requiredBlocks > getFreeBlockCount()) return -2;
-    if (fileNode->allocatedBlockCount > 0 && fileNode->allocatedBlocks) {
-        for (int i = 0; i < fileNode->allocatedBlockCount; ++i) {
-            releaseFreeBlock(fileNode->allocatedBlocks[i]);
-        }
-        free(fileNode->allocatedBlocks);
-        fileNode->allocatedBlocks = NULL;
-        fileNode->allocatedBlockCount = 0;
-        fileNode->fileSize = 0;
-    }
-    if (requiredBlocks == 0) {
-        fileNode->allocatedBlocks = NULL;
-        fileNode->allocatedBlockCount = 0;
-        fileNode->fileSize = 0;
-        return 0;
+void releaseFreeBlock(int blockIndex) {
+    if (journalReplayInProgress) return;
+    if (journalFileDescriptor >= 0) {
+        queueThreadPendingFree(blockIndex);
+        return;
     }
-    fileNode->allocatedBlocks = malloc(sizeof(int) * requiredBlocks);
-    if (!fileNode->allocatedBlocks) exitWithError("Out of memory");
-    for (int i = 0; i < requiredBlocks; ++i) {
-        int blockIndex = allocateFreeBlock();
-        if (blockIndex < 0) {
-            for (int j = 0; j < i; ++j) {
-                releaseFreeBlock(fileNode->allocatedBlocks[j]);
-            }
-            free(fileNode->allocatedBlocks);
-            fileNode->allocatedBlocks = NULL;
-            fileNode->allocatedBlockCount = 0;
-            return -2;
+    appendBlockToFreeList(blockIndex);
+    __atomic_sub_fetch(&usedBlockCount, 1, __ATOMIC_RELAXED);
+}
+
+void reclaimPendingFreeBlocks() {
+    pthread_mutex_lock(&pendingFreeLock);
+    for (int i = 0; i < pendingFreeBlockCount; ++i) appendBlockToFreeList(pendingFreeBlocks[i]);
+    __atomic_sub_fetch(&usedBlockCount, pendingFreeBlockCount, __ATOMIC_RELAXED);
+    pendingFreeBlockCount = 0;
+    pthread_mutex_unlock(&pendingFreeLock);
+}
+
+void rebuildFreeBlockList() {
+    releaseFreeBlockList();
+    usedBlockCount = 0;
+    for (int i = 0; i < TOTAL_BLOCKS; ++i) {
+        if (blockReferenceCounts[i] == 0) {
+            appendBlockToFreeList(i);
+        } else {
+            usedBlockCount++;
         }
-        fileNode->allocatedBlocks[i] = blockIndex;
-        unsigned char *blockStart = virtualDisk + ((size_t)blockIndex * BLOCK_SIZE);
-        int copyOffset = i * BLOCK_SIZE;
-        int bytesToCopy = BLOCK_SIZE;
-        if (copyOffset + bytesToCopy > size) bytesToCopy = size - copyOffset;
-        if (bytesToCopy > 0) memcpy(blockStart, content + copyOffset, bytesToCopy);
-        if (bytesToCopy < BLOCK_SIZE) memset(blockStart + bytesToCopy, 0, BLOCK_SIZE - bytesToCopy);
     }
-    fileNode->allocatedBlockCount = requiredBlocks;
-    fileNode->fileSize = size;
-    return 0;
 }
 
-int readFileContent(VfsNode *fileNode) {
-    if (!fileNode || fileNode->isDirectory) return -1;
-    if (fileNode->allocatedBlockCount == 0 || fileNode->allocatedBlocks == NULL || fileNode->fileSize == 0) return 0;
-    int remainingBytes = fileNode->fileSize;
-    for (int i = 0; i < fileNode->allocatedBlockCount; ++i) {
-        int blockIndex = fileNode->allocatedBlocks[i];
-        unsigned char *blockStart = virtualDisk + ((size_t)blockIndex * BLOCK_SIZE);
-        int bytesToPrint = (remainingBytes > BLOCK_SIZE) ? BLOCK_SIZE : remainingBytes;
-        fwrite(blockStart, 1, bytesToPrint, stdout);
-        remainingBytes -= bytesToPrint;
-        if (remainingBytes <= 0) break;
+int getBlockReferenceCount(int blockIndex) {
+    return __atomic_load_n(&blockReferenceCounts[blockIndex], __ATOMIC_ACQUIRE);
+}
+
+void unlinkDedupIndexEntry(int blockIndex) {
+    if (!blockIsIndexed[blockIndex]) return;
+    int *link = &dedupBucketHeads[blockFingerprints[blockIndex] % DEDUP_BUCKET_COUNT];
+    while (*link != blockIndex) link = &dedupNextInBucket[*link];
+    *link = dedupNextInBucket[blockIndex];
+    blockIsIndexed[blockIndex] = 0;
+}
+
+void insertDedupIndexEntry(int blockIndex, unsigned long long fingerprint) {
+    int bucket = (int)(fingerprint % DEDUP_BUCKET_COUNT);
+    blockFingerprints[blockIndex] = fingerprint;
+    dedupNextInBucket[blockIndex] = dedupBucketHeads[bucket];
+    dedupBucketHeads[bucket] = blockIndex;
+    blockIsIndexed[blockIndex] = 1;
+}
+
+void moveDedupIndexEntry(int fromBlock, int toBlock) {
+    pthread_mutex_lock(&dedupLock);
+    if (blockIsIndexed[fromBlock]) {
+        unsigned long long fingerprint = blockFingerprints[fromBlock];
+        unlinkDedupIndexEntry(fromBlock);
+        insertDedupIndexEntry(toBlock, fingerprint);
     }
-    return 0;
+    pthread_mutex_unlock(&dedupLock);
 }
 
-int deleteFileNode(VfsNode *fileNode) {
-    if (!fileNode || fileNode->isDirectory) return -1;
-    if (fileNode->allocatedBlockCount > 0 && fileNode->allocatedBlocks) {
-        for (int i = 0; i < fileNode->allocatedBlockCount; ++i) {
-            releaseFreeBlock(fileNode->allocatedBlocks[i]);
+void removeBlockFromDedupIndex(int blockIndex) {
+    pthread_mutex_lock(&dedupLock);
+    unlinkDedupIndexEntry(blockIndex);
+    pthread_mutex_unlock(&dedupLock);
+}
+
+int claimBlockForWrite(int blockIndex) {
+    pthread_mutex_lock(&dedupLock);
+    int exclusivelyOwned = getBlockReferenceCount(blockIndex) == 1;
+    if (exclusivelyOwned) unlinkDedupIndexEntry(blockIndex);
+    pthread_mutex_unlock(&dedupLock);
+    return exclusivelyOwned;
+}
+
+void clearDedupIndex() {
+    pthread_mutex_lock(&dedupLock);
+    for (int i = 0; i < DEDUP_BUCKET_COUNT; ++i) dedupBucketHeads[i] = -1;
+    memset(blockIsIndexed, 0, TOTAL_BLOCKS);
+    pthread_mutex_unlock(&dedupLock);
+}
+
+void retainDiskBlock(int blockIndex) {
+    __atomic_add_fetch(&blockReferenceCounts[blockIndex], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&blockReferenceTotal, 1, __ATOMIC_RELAXED);
+}
+
+int tryRetainDiskBlock(int blockIndex) {
+    int referenceCount = getBlockReferenceCount(blockIndex);
+    while (referenceCount > 0) {
+        if (__atomic_compare_exchange_n(&blockReferenceCounts[blockIndex], &referenceCount, referenceCount + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_add_fetch(&blockReferenceTotal, 1, __ATOMIC_RELAXED);
+            return 1;
         }
-        free(fileNode->allocatedBlocks);
-        fileNode->allocatedBlocks = NULL;
-        fileNode->allocatedBlockCount = 0;
-        fileNode->fileSize = 0;
     }
-    if (fileNode->parent) detachChildNode(fileNode->parent, fileNode);
-    freeVfsNode(fileNode);
     return 0;
 }
 
-int removeDirectoryNode(VfsNode *directoryNode) {
-    if (!directoryNode || !directoryNode->isDirectory) return -1;
-    if (directoryNode->firstChild != NULL) return -2;
-    if (directoryNode->parent) detachChildNode(directoryNode->parent, directoryNode);
-    freeVfsNode(directoryNode);
-    return 0;
+void releaseDiskBlock(int blockIndex) {
+    __atomic_sub_fetch(&blockReferenceTotal, 1, __ATOMIC_RELAXED);
+    if (__atomic_sub_fetch(&blockReferenceCounts[blockIndex], 1, __ATOMIC_ACQ_REL) == 0) {
+        removeBlockFromDedupIndex(blockIndex);
+        releaseFreeBlock(blockIndex);
+    }
 }
 
-int handleMakeDirectory(const char *name) {
-    if (!name || strlen(name) == 0) { printf("Usage: mkdir <name>\n"); return -1; }
-    if (strlen(name) > MAX_NAME_LEN) { printf("Error: name too long\n"); return -1; }
-    if (strchr(name, '/')) { printf("Error: name cannot contain '/'\n"); return -1; }
-    if (findChildNode(currentDirectory, name)) { printf("Error: directory '%s' already exists\n", name); return -1; }
-    VfsNode *directoryNode = createVfsNode(name, 1, currentDirectory);
-    attachChildNode(currentDirectory, directoryNode);
-    printf("Directory '%s' created\n", name);
-    return 0;
+VfsBlockMap* createBlockMap() {
+    VfsBlockMap *blockMap = malloc(sizeof(VfsBlockMap));
+    if (!blockMap) exitWithError("Out of memory");
+    blockMap->blocks = NULL;
+    blockMap->extentCompressedLengths = NULL;
+    blockMap->blockCount = 0;
+    blockMap->blockCapacity = 0;
+    blockMap->referenceCount = 1;
+    return blockMap;
 }
 
-int handleCreateFile(const char *name) {
-    if (!name || strlen(name) == 0) { printf("Usage: create <filename>\n"); return -1; }
-    if (strlen(name) > MAX_NAME_LEN) { printf("Error: name too long\n"); return -1; }
-    if (strchr(name, '/')) { printf("Error: name cannot contain '/'\n"); return -1; }
-    if (findChildNode(currentDirectory, name)) { printf("Error: file '%s' already exists\n", name); return -1; }
-    VfsNode *fileNode = createVfsNode(name, 0, currentDirectory);
-    attachChildNode(currentDirectory, fileNode);
-    printf("File '%s' created\n", name);
-    return 0;
+int getExtentSlotCount(const VfsBlockMap *blockMap, int extent) {
+    int slotCount = blockMap->blockCount - extent * COMPRESSION_EXTENT_BLOCKS;
+    return slotCount > COMPRESSION_EXTENT_BLOCKS ? COMPRESSION_EXTENT_BLOCKS : slotCount;
 }
 
-void buildAbsolutePath(VfsNode *node, char *outputBuffer, int bufferSize) {
-    if (!node || node == rootDirectory) {
-        strncpy(outputBuffer, "/", bufferSize - 1);
-        outputBuffer[bufferSize - 1] = '\0';
-        return;
-    }
-    char nameStack[256][MAX_NAME_LEN + 1];
-    int depth = 0;
-    VfsNode *cursor = node;
-    while (cursor && cursor != rootDirectory) {
-        strncpy(nameStack[depth], cursor->name, MAX_NAME_LEN);
-        nameStack[depth][MAX_NAME_LEN] = '\0';
-        depth++;
-        cursor = cursor->parent;
+int getCompressedExtentLength(const VfsBlockMap *blockMap, int extent) {
+    if (!blockMap || !blockMap->extentCompressedLengths) return 0;
+    return blockMap->extentCompressedLengths[extent];
+}
+
+DecompressedExtentEntry* getDecompressedExtentEntry(const VfsBlockMap *blockMap, int extent) {
+    size_t key = (size_t)blockMap / sizeof(VfsBlockMap) * 31 + (size_t)extent;
+    return &decompressedExtentCache[key % DECOMPRESSED_EXTENT_CACHE_SLOTS];
+}
+
+void invalidateDecompressedExtent(const VfsBlockMap *blockMap, int extent) {
+    DecompressedExtentEntry *entry = getDecompressedExtentEntry(blockMap, extent);
+    pthread_mutex_lock(&decompressedExtentCacheLock);
+    decompressedExtentCacheGeneration++;
+    if (entry->blockMap == blockMap && entry->extent == extent) entry->blockMap = NULL;
+    pthread_mutex_unlock(&decompressedExtentCacheLock);
+}
+
+void accountCompressedExtent(const VfsBlockMap *blockMap, int extent, int direction) {
+    if (direction < 0) invalidateDecompressedExtent(blockMap, extent);
+    int compressedLength = blockMap->extentCompressedLengths[extent];
+    __atomic_add_fetch(&compressedLogicalBlockTotal, direction * getExtentSlotCount(blockMap, extent), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&compressedPhysicalBlockTotal, direction * ((compressedLength + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE), __ATOMIC_RELAXED);
+}
+
+void releaseBlockMap(VfsBlockMap *blockMap) {
+    if (!blockMap || __atomic_sub_fetch(&blockMap->referenceCount, 1, __ATOMIC_ACQ_REL) > 0) return;
+    for (int extent = 0; extent * COMPRESSION_EXTENT_BLOCKS < blockMap->blockCount; ++extent) {
+        if (getCompressedExtentLength(blockMap, extent) > 0) accountCompressedExtent(blockMap, extent, -1);
     }
-    outputBuffer[0] = '\0';
-    for (int i = depth - 1; i >= 0; --i) {
-        strncat(outputBuffer, "/", bufferSize - strlen(outputBuffer) - 1);
-        strncat(outputBuffer, nameStack[i], bufferSize - strlen(outputBuffer) - 1);
+    for (int i = 0; i < blockMap->blockCount; ++i) {
+        if (blockMap->blocks[i] >= 0) releaseDiskBlock(blockMap->blocks[i]);
     }
-    if (strlen(outputBuffer) == 0) {
-        strncpy(outputBuffer, "/", bufferSize - 1);
+    free(blockMap->blocks);
+    free(blockMap->extentCompressedLengths);
+    free(blockMap);
+}
+
+unsigned int computePathHash(const char *path, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
     }
-    outputBuffer[bufferSize - 1] = '\0';
+    return hash;
 }
 
-int changeDirectory(const char *path) {
-    if (!path || strlen(path) == 0) { printf("Usage: cd <path>\n"); return -1; }
-    VfsNode *startNode = currentDirectory;
-    if (path[0] == '/') startNode = rootDirectory;
-    char pathCopy[MAX_CMD_LEN];
-    strncpy(pathCopy, path, sizeof(pathCopy) - 1);
-    pathCopy[sizeof(pathCopy) - 1] = '\0';
-    char *token = strtok(pathCopy, "/");
-    VfsNode *cursor = startNode;
-    while (token) {
-        if (strcmp(token, "") == 0) {
-            token = strtok(NULL, "/");
-            continue;
-        }
-        if (strcmp(token, ".") == 0) {
-            token = strtok(NULL, "/");
-            continue;
-        }
-        if (strcmp(token, "..") == 0) {
-            if (cursor->parent) cursor = cursor->parent;
-            token = strtok(NULL, "/");
-            continue;
-        }
-        VfsNode *nextNode = findChildNode(cursor, token);
-        if (!nextNode) {
-            printf("Error: path component '%s' not found\n", token);
-            return -1;
-        }
-        if (!nextNode->isDirectory) {
-            printf("Error: '%s' is not a directory\n", token);
-            return -1;
+size_t getPoolSlotSize(const ObjectPool *pool) {
+    return (pool->objectSize + OBJECT_SLAB_ALIGNMENT - 1) / OBJECT_SLAB_ALIGNMENT * OBJECT_SLAB_ALIGNMENT;
+}
+
+void* getPoolSlabObject(const ObjectPool *pool, ObjectSlab *slab, int index) {
+    return (char*)slab + OBJECT_SLAB_ALIGNMENT + (size_t)index * getPoolSlotSize(pool);
+}
+
+void* allocatePoolObject(ObjectPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->freeList) {
+        ObjectSlab *slab = calloc(1, OBJECT_SLAB_ALIGNMENT + OBJECT_SLAB_OBJECT_COUNT * getPoolSlotSize(pool));
+        if (!slab) exitWithError("Out of memory");
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->slabCount++;
+        for (int i = OBJECT_SLAB_OBJECT_COUNT - 1; i >= 0; --i) {
+            void **object = getPoolSlabObject(pool, slab, i);
+            *object = pool->freeList;
+            pool->freeList = object;
         }
-        cursor = nextNode;
-        token = strtok(NULL, "/");
     }
-    currentDirectory = cursor;
-    char fullPath[1024];
-    buildAbsolutePath(currentDirectory, fullPath, sizeof(fullPath));
-    printf("Moved to %s\n", fullPath);
-    return 0;
+    void **object = pool->freeList;
+    pool->freeList = *object;
+    pool->liveCount++;
+    pthread_mutex_unlock(&pool->lock);
+    return object;
 }
 
-void handleListDirectory() {
-    if (!currentDirectory->firstChild) {
-        printf("(empty)\n");
-        return;
+void releasePoolObject(ObjectPool *pool, void *object) {
+    pthread_mutex_lock(&pool->lock);
+    *(void**)object = pool->freeList;
+    pool->freeList = object;
+    pool->liveCount--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void releaseObjectPool(ObjectPool *pool) {
+    while (pool->slabs) {
+        ObjectSlab *next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
     }
-    VfsNode *head = currentDirectory->firstChild;
-    VfsNode *node = head;
-    do {
-        printf("%s%s\n", node->name, node->isDirectory ? "/" : "");
-        node = node->nextSibling;
-    } while (node != head);
+    pool->freeList = NULL;
+    pool->slabCount = pool->liveCount = 0;
 }
 
-void handleDiskUsage() {
-    int freeBlocks = getFreeBlockCount();
-    double usedPercent = (double)usedBlockCount / (double)TOTAL_BLOCKS * 100.0;
-    printf("Total Blocks: %d\nUsed Blocks: %d\nFree Blocks: %d\nDisk Usage: %.2f%%\n", TOTAL_BLOCKS, usedBlockCount, freeBlocks, usedPercent);
+int getNameSizeClass(int length) {
+    return ((int)sizeof(InternedName) + length + NAME_ARENA_SIZE_CLASS_BYTES) / NAME_ARENA_SIZE_CLASS_BYTES;
 }
 
-void parseWriteArguments(const char *argumentLine, char *fileNameOut, char **contentOut) {
-    fileNameOut[0] = '\0';
-    *contentOut = NULL;
-    if (!argumentLine) return;
-    const char *cursor = argumentLine;
-    while (*cursor && isspace((unsigned char)*cursor)) cursor++;
-    if (!*cursor) return;
-    int i = 0;
-    while (*cursor && !isspace((unsigned char)*cursor) && i < MAX_NAME_LEN) fileNameOut[i++] = *cursor++;
-    fileNameOut[i] = '\0';
-    while (*cursor && isspace((unsigned char)*cursor)) cursor++;
-    if (!*cursor) return;
-    if (*cursor == '"' || *cursor == '\'') {
-        char quoteChar = *cursor++;
-        const char *start = cursor;
-        while (*cursor && *cursor != quoteChar) cursor++;
-        size_t length = cursor - start;
-        *contentOut = malloc(length + 1);
-        if (!*contentOut) exitWithError("Out of memory");
-        memcpy(*contentOut, start, length);
-        (*contentOut)[length] = '\0';
-    } else {
-        size_t length = strlen(cursor);
-        while (length > 0 && (cursor[length - 1] == '\n' || cursor[length - 1] == '\r')) length--;
-        *contentOut = malloc(length + 1);
-        if (!*contentOut) exitWithError("Out of memory");
-        memcpy(*contentOut, cursor, length);
-        (*contentOut)[length] = '\0';
+InternedName* carveInternedName(int length) {
+    int sizeClass = getNameSizeClass(length);
+    InternedName *entry = nameArenaFreeLists[sizeClass];
+    if (entry) {
+        nameArenaFreeLists[sizeClass] = entry->next;
+        return entry;
+    }
+    size_t entrySize = (size_t)sizeClass * NAME_ARENA_SIZE_CLASS_BYTES;
+    if (!nameArenaChunks || nameArenaChunks->used + entrySize > NAME_ARENA_CHUNK_SIZE) {
+        NameArenaChunk *chunk = malloc(sizeof(NameArenaChunk));
+        if (!chunk) exitWithError("Out of memory");
+        chunk->next = nameArenaChunks;
+        chunk->used = 0;
+        nameArenaChunks = chunk;
     }
+    entry = (InternedName*)(nameArenaChunks->data + nameArenaChunks->used);
+    nameArenaChunks->used += entrySize;
+    nameArenaBytesUsed += (long)entrySize;
+    return entry;
 }
 
-void freeVfsTreeRecursive(VfsNode *directoryNode) {
-    if (!directoryNode) return;
-    while (directoryNode->firstChild) {
-        VfsNode *child = directoryNode->firstChild;
-        detachChildNode(directoryNode, child);
-        if (child->isDirectory) {
-            freeVfsTreeRecursive(child);
-        } else {
-            if (child->allocatedBlockCount > 0 && child->allocatedBlocks) {
-                for (int i = 0; i < child->allocatedBlockCount; ++i) {
-                    releaseFreeBlock(child->allocatedBlocks[i]);
-                }
-                free(child->allocatedBlocks);
-                child->allocatedBlocks = NULL;
-            }
-            freeVfsNode(child);
+void growNameInternTable() {
+    int newBucketCount = nameInternBucketCount ? nameInternBucketCount * 2 : NAME_INTERN_INITIAL_BUCKETS;
+    InternedName **newBuckets = calloc(newBucketCount, sizeof(InternedName*));
+    if (!newBuckets) exitWithError("Out of memory");
+    for (int i = 0; i < nameInternBucketCount; ++i) {
+        InternedName *entry = nameInternBuckets[i];
+        while (entry) {
+            InternedName *next = entry->next;
+            int bucket = entry->hash & (newBucketCount - 1);
+            entry->next = newBuckets[bucket];
+            newBuckets[bucket] = entry;
+            entry = next;
         }
     }
-    freeVfsNode(directoryNode);
+    free(nameInternBuckets);
+    nameInternBuckets = newBuckets;
+    nameInternBucketCount = newBucketCount;
 }
 
-void cleanupVfs() {
-    if (rootDirectory) {
-        freeVfsTreeRecursive(rootDirectory);
-        rootDirectory = currentDirectory = NULL;
+const char* internVfsName(const char *name) {
+    int length = (int)strlen(name);
+    unsigned int hash = computePathHash(name, length);
+    pthread_mutex_lock(&nameArenaLock);
+    if (nameInternCount >= nameInternBucketCount) growNameInternTable();
+    InternedName **bucket = &nameInternBuckets[hash & (nameInternBucketCount - 1)];
+    for (InternedName *entry = *bucket; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, name, length) == 0) {
+            entry->referenceCount++;
+            pthread_mutex_unlock(&nameArenaLock);
+            return entry->text;
+        }
     }
-    FreeBlockNode *cursor = freeBlockHead;
-    while (cursor) {
-        FreeBlockNode *next = cursor->next;
-        free(cursor);
-        cursor = next;
+    InternedName *entry = carveInternedName(length);
+    entry->hash = hash;
+    entry->referenceCount = 1;
+    entry->length = length;
+    memcpy(entry->text, name, length + 1);
+    entry->next = *bucket;
+    *bucket = entry;
+    nameInternCount++;
+    pthread_mutex_unlock(&nameArenaLock);
+    return entry->text;
+}
+
+void releaseVfsName(const char *name) {
+    if (!name) return;
+    InternedName *entry = (InternedName*)(name - offsetof(InternedName, text));
+    pthread_mutex_lock(&nameArenaLock);
+    if (--entry->referenceCount == 0) {
+        InternedName **link = &nameInternBuckets[entry->hash & (nameInternBucketCount - 1)];
+        while (*link != entry) link = &(*link)->next;
+        *link = entry->next;
+        int sizeClass = getNameSizeClass(entry->length);
+        entry->next = nameArenaFreeLists[sizeClass];
+        nameArenaFreeLists[sizeClass] = entry;
+        nameInternCount--;
     }
-    freeBlockHead = freeBlockTail = NULL;
-    if (virtualDisk) free(virtualDisk);
-    virtualDisk = NULL;
+    pthread_mutex_unlock(&nameArenaLock);
 }
 
-void runShellLoop() {
-    printf("Compact VFS ready. Type 'exit' to quit.\n");
-    char inputLine[MAX_CMD_LEN];
-    while (1) {
-        char currentPath[1024];
-        buildAbsolutePath(currentDirectory, currentPath, sizeof(currentPath));
-        printf("%s > ", currentPath);
-        if (!fgets(inputLine, sizeof(inputLine), stdin)) {
-            printf("\n");
-            break;
-        }
-        char *cursor = inputLine;
-        while (*cursor && (*cursor == '\n' || *cursor == '\r')) cursor++;
-        char command[64] = {0};
-        int cmdLen = 0;
-        while (*cursor && isspace((unsigned char)*cursor)) cursor++;
-        while (*cursor && !isspace((unsigned char)*cursor) && cmdLen < (int)sizeof(command) - 1) {
-            command[cmdLen++] = *cursor++;
-        }
-        command[cmdLen] = '\0';
-        while (*cursor && isspace((unsigned char)*cursor)) cursor++;
-        char arguments[MAX_CMD_LEN] = {0};
-        if (*cursor) {
-            strncpy(arguments, cursor, sizeof(arguments) - 1);
-            arguments[sizeof(arguments) - 1] = '\0';
-            int argLen = strlen(arguments);
-            while (argLen > 0 && (arguments[argLen - 1] == '\n' || arguments[argLen - 1] == '\r')) {
-                arguments[--argLen] = '\0';
-            }
-        }
-        if (strcmp(command, "mkdir") == 0) {
-            handleMakeDirectory(arguments);
-        } else if (strcmp(command, "create") == 0) {
-            handleCreateFile(arguments);
-        } else if (strcmp(command, "ls") == 0) {
-            handleListDirectory();
-        } else if (strcmp(command, "pwd") == 0) {
-            char pathBuffer[1024];
-            buildAbsolutePath(currentDirectory, pathBuffer, sizeof(pathBuffer));
-            printf("%s\n", pathBuffer);
-        } else if (strcmp(command, "df") == 0) {
-            handleDiskUsage();
-        } else if (strcmp(command, "cd") == 0) {
-            changeDirectory(arguments);
-        } else if (strcmp(command, "rmdir") == 0) {
-            if (!arguments || strlen(arguments) == 0) {
-                printf("Usage: rmdir <dirname>\n");
-            } else {
-                VfsNode *dirNode = findChildNode(currentDirectory, arguments);
-                if (!dirNode) {
-                    printf("Error: directory '%s' not found\n", arguments);
-                } else if (!dirNode->isDirectory) {
-                    printf("Error: '%s' is not a directory\n", arguments);
-                } else if (dirNode->firstChild != NULL) {
-                    printf("Error: directory not empty\n");
-                } else {
-                    removeDirectoryNode(dirNode);
-                    printf("Directory '%s' removed\n", arguments);
-                }
-            }
-        } else if (strcmp(command, "write") == 0) {
-            if (!arguments || strlen(arguments) == 0) {
-                printf("Usage: write <filename> \"content\"\n");
-                continue;
-            }
-            char fileName[MAX_NAME_LEN + 1];
-            char *content = NULL;
-            parseWriteArguments(arguments, fileName, &content);
-            if (strlen(fileName) == 0) {
-                printf("Error: missing filename\n");
-                if (content) free(content);
-                continue;
-            }
-            VfsNode *fileNode = findChildNode(currentDirectory, fileName);
-            if (!fileNode) {
-                printf("Error: file '%s' not found\n", fileName);
-                if (content) free(content);
-                continue;
-            }
-            if (fileNode->isDirectory) {
-                printf("Error: '%s' is a directory\n", fileName);
-                if (content) free(content);
+void releaseNameArena() {
+    while (nameArenaChunks) {
+        NameArenaChunk *next = nameArenaChunks->next;
+        free(nameArenaChunks);
+        nameArenaChunks = next;
+    }
+    memset(nameArenaFreeLists, 0, sizeof(nameArenaFreeLists));
+    free(nameInternBuckets);
+    nameInternBuckets = NULL;
+    nameInternBucketCount = nameInternCount = 0;
+    nameArenaBytesUsed = 0;
+}
+
+long getVfsTimestamp() {
+    if (journalReplayInProgress) return journalReplayTimestamp;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long wallClock = now.tv_sec * 1000000000L + now.tv_nsec;
+    long previous = __atomic_load_n(&lastVfsTimestamp, __ATOMIC_RELAXED);
+    long timestamp;
+    do {
+        timestamp = wallClock > previous ? wallClock : previous + 1;
+    } while (!__atomic_compare_exchange_n(&lastVfsTimestamp, &previous, timestamp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return timestamp;
+}
+
+VfsInode* createVfsInode(int isDirectory) {
+    VfsInode *inode = allocatePoolObject(&vfsInodePool);
+    inode->blockMap = NULL;
+    inode->fileSize = 0;
+    inode->linkCount = 0;
+    inode->modifyTime = inode->changeTime = inode->accessTime = getVfsTimestamp();
+    inode->attributeBlock = -1;
+    inode->attributeLength = 0;
+    inode->mode = isDirectory ? DEFAULT_DIRECTORY_MODE : DEFAULT_FILE_MODE;
+    pthread_rwlock_init(&inode->inodeLock, NULL);
+    return inode;
+}
+
+void releaseVfsInode(VfsInode *inode) {
+    if (--inode->linkCount > 0) return;
+    releaseBlockMap(inode->blockMap);
+    if (inode->attributeBlock >= 0) releaseDiskBlock(inode->attributeBlock);
+    pthread_rwlock_destroy(&inode->inodeLock);
+    releasePoolObject(&vfsInodePool, inode);
+}
+
+VfsNode* createLinkedVfsNode(const char *name, int isDirectory, VfsNode *parent, VfsNode *linkTarget) {
+    if (strlen(name) > MAX_NAME_LEN) return NULL;
+    VfsNode *node = allocatePoolObject(&vfsNodePool);
+    node->name = internVfsName(name);
+    node->isDirectory = isDirectory;
+    node->parent = parent;
+    node->firstChild = NULL;
+    node->nextSibling = node->prevSibling = NULL;
+    node->nameIndexRoot = node->nameIndexLeft = node->nameIndexRight = NULL;
+    node->nameIndexHeight = 1;
+    node->childCount = 0;
+    node->nodeId = __atomic_fetch_add(&nextNodeId, 1, __ATOMIC_RELAXED);
+    if (linkTarget) {
+        node->inode = linkTarget->inode;
+        node->nextLink = linkTarget->nextLink;
+        linkTarget->nextLink = node;
+    } else {
+        node->inode = createVfsInode(isDirectory);
+        node->nextLink = node;
+    }
+    node->inode->linkCount++;
+    node->subtreeSize = 0;
+    node->subtreeModifyTime = node->inode->modifyTime;
+    node->cachedPath = NULL;
+    node->cachedPathGeneration = 0;
+    node->pathCacheEntry = NULL;
+    return node;
+}
+
+void setVfsNodeName(VfsNode *node, const char *name) {
+    const char *previousName = node->name;
+    node->name = internVfsName(name);
+    releaseVfsName(previousName);
+}
+
+VfsNode* createVfsNode(const char *name, int isDirectory, VfsNode *parent) {
+    return createLinkedVfsNode(name, isDirectory, parent, NULL);
+}
+
+long getSubtreeSize(const VfsNode *node) {
+    return node->isDirectory ? __atomic_load_n(&node->subtreeSize, __ATOMIC_RELAXED) : node->inode->fileSize;
+}
+
+void propagateSubtreeSizeDelta(VfsNode *directoryNode, long delta) {
+    if (delta == 0) return;
+    for (; directoryNode; directoryNode = directoryNode->parent) __atomic_add_fetch(&directoryNode->subtreeSize, delta, __ATOMIC_RELAXED);
+}
+
+void setFileSize(VfsNode *fileNode, int newSize) {
+    long delta = (long)newSize - fileNode->inode->fileSize;
+    VfsNode *link = fileNode;
+    do {
+        if (link->parent) propagateSubtreeSizeDelta(link->parent, delta);
+        link = link->nextLink;
+    } while (link != fileNode);
+    fileNode->inode->fileSize = newSize;
+}
+
+void raiseSubtreeModifyTime(VfsNode *directoryNode, long timestamp) {
+    timestamp = (timestamp / SUBTREE_TIME_GRANULARITY_NANOS + 1) * SUBTREE_TIME_GRANULARITY_NANOS;
+    for (; directoryNode; directoryNode = directoryNode->parent) {
+        long current = __atomic_load_n(&directoryNode->subtreeModifyTime, __ATOMIC_RELAXED);
+        do {
+            if (current >= timestamp) return;
+        } while (!__atomic_compare_exchange_n(&directoryNode->subtreeModifyTime, &current, timestamp, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+}
+
+void touchVfsNode(VfsNode *node, int contentChanged) {
+    long timestamp = getVfsTimestamp();
+    __atomic_store_n(&node->inode->changeTime, timestamp, __ATOMIC_RELAXED);
+    if (!contentChanged) return;
+    __atomic_store_n(&node->inode->modifyTime, timestamp, __ATOMIC_RELAXED);
+    if (node->isDirectory) {
+        raiseSubtreeModifyTime(node, timestamp);
+        return;
+    }
+    VfsNode *link = node;
+    do {
+        raiseSubtreeModifyTime(link->parent, timestamp);
+        link = link->nextLink;
+    } while (link != node);
+}
+
+void refreshAccessTime(VfsNode *node) {
+    long accessTime = __atomic_load_n(&node->inode->accessTime, __ATOMIC_RELAXED);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    if (accessTime > __atomic_load_n(&node->inode->modifyTime, __ATOMIC_RELAXED) && now.tv_sec * 1000000000L + now.tv_nsec - accessTime < ACCESS_TIME_REFRESH_NANOS) return;
+    __atomic_store_n(&node->inode->accessTime, getVfsTimestamp(), __ATOMIC_RELAXED);
+}
+
+int getNameIndexHeight(const VfsNode *node) {
+    return node ? node->nameIndexHeight : 0;
+}
+
+void updateNameIndexHeight(VfsNode *node) {
+    int leftHeight = getNameIndexHeight(node->nameIndexLeft);
+    int rightHeight = getNameIndexHeight(node->nameIndexRight);
+    node->nameIndexHeight = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+}
+
+VfsNode* rotateNameIndex(VfsNode *node, int rotateLeft) {
+    VfsNode *pivot;
+    if (rotateLeft) {
+        pivot = node->nameIndexRight;
+        node->nameIndexRight = pivot->nameIndexLeft;
+        pivot->nameIndexLeft = node;
+    } else {
+        pivot = node->nameIndexLeft;
+        node->nameIndexLeft = pivot->nameIndexRight;
+        pivot->nameIndexRight = node;
+    }
+    updateNameIndexHeight(node);
+    updateNameIndexHeight(pivot);
+    return pivot;
+}
+
+VfsNode* rebalanceNameIndex(VfsNode *node) {
+    updateNameIndexHeight(node);
+    int balance = getNameIndexHeight(node->nameIndexLeft) - getNameIndexHeight(node->nameIndexRight);
+    if (balance > 1) {
+        VfsNode *left = node->nameIndexLeft;
+        if (getNameIndexHeight(left->nameIndexLeft) < getNameIndexHeight(left->nameIndexRight)) node->nameIndexLeft = rotateNameIndex(left, 1);
+        return rotateNameIndex(node, 0);
+    }
+    if (balance < -1) {
+        VfsNode *right = node->nameIndexRight;
+        if (getNameIndexHeight(right->nameIndexRight) < getNameIndexHeight(right->nameIndexLeft)) node->nameIndexRight = rotateNameIndex(right, 0);
+        return rotateNameIndex(node, 1);
+    }
+    return node;
+}
+
+VfsNode* insertNameIndex(VfsNode *root, VfsNode *child) {
+    if (!root) {
+        child->nameIndexLeft = child->nameIndexRight = NULL;
+        child->nameIndexHeight = 1;
+        return child;
+    }
+    if (strcmp(child->name, root->name) < 0) {
+        root->nameIndexLeft = insertNameIndex(root->nameIndexLeft, child);
+    } else {
+        root->nameIndexRight = insertNameIndex(root->nameIndexRight, child);
+    }
+    return rebalanceNameIndex(root);
+}
+
+VfsNode* removeMinimumNameIndex(VfsNode *root, VfsNode **minimumOut) {
+    if (!root->nameIndexLeft) {
+        *minimumOut = root;
+        return root->nameIndexRight;
+    }
+    root->nameIndexLeft = removeMinimumNameIndex(root->nameIndexLeft, minimumOut);
+    return rebalanceNameIndex(root);
+}
+
+VfsNode* removeNameIndex(VfsNode *root, VfsNode *child) {
+    if (!root) return NULL;
+    if (root != child) {
+        if (strcmp(child->name, root->name) < 0) {
+            root->nameIndexLeft = removeNameIndex(root->nameIndexLeft, child);
+        } else {
+            root->nameIndexRight = removeNameIndex(root->nameIndexRight, child);
+        }
+        return rebalanceNameIndex(root);
+    }
+    VfsNode *replacement;
+    if (!child->nameIndexLeft) {
+        replacement = child->nameIndexRight;
+    } else if (!child->nameIndexRight) {
+        replacement = child->nameIndexLeft;
+    } else {
+        VfsNode *remainingRight = removeMinimumNameIndex(child->nameIndexRight, &replacement);
+        replacement->nameIndexLeft = child->nameIndexLeft;
+        replacement->nameIndexRight = remainingRight;
+        replacement = rebalanceNameIndex(replacement);
+    }
+    child->nameIndexLeft = child->nameIndexRight = NULL;
+    child->nameIndexHeight = 1;
+    return replacement;
+}
+
+int attachChildNode(VfsNode *parent, VfsNode *child) {
+    if (!parent || !parent->isDirectory) return -1;
+    if (!parent->firstChild) {
+        parent->firstChild = child;
+        child->nextSibling = child->prevSibling = child;
+    } else {
+        VfsNode *first = parent->firstChild;
+        VfsNode *last = first->prevSibling;
+        last->nextSibling = child;
+        child->prevSibling = last;
+        child->nextSibling = first;
+        first->prevSibling = child;
+    }
+    child->parent = parent;
+    parent->nameIndexRoot = insertNameIndex(parent->nameIndexRoot, child);
+    parent->childCount++;
+    propagateSubtreeSizeDelta(parent, getSubtreeSize(child));
+    touchVfsNode(parent, 1);
+    return 0;
+}
+
+int detachChildNode(VfsNode *parent, VfsNode *child) {
+    if (!parent || !parent->isDirectory || !parent->firstChild || !child) return -1;
+    propagateSubtreeSizeDelta(parent, -getSubtreeSize(child));
+    parent->nameIndexRoot = removeNameIndex(parent->nameIndexRoot, child);
+    parent->childCount--;
+    if (parent->firstChild == child && child->nextSibling == child) {
+        parent->firstChild = NULL;
+    } else {
+        if (parent->firstChild == child) parent->firstChild = child->nextSibling;
+        child->prevSibling->nextSibling = child->nextSibling;
+        child->nextSibling->prevSibling = child->prevSibling;
+    }
+    child->nextSibling = child->prevSibling = NULL;
+    child->parent = NULL;
+    touchVfsNode(parent, 1);
+    return 0;
+}
+
+void lockNodeShared(VfsNode *node) {
+    pthread_rwlock_rdlock(&node->inode->inodeLock);
+}
+
+void lockNodeExclusive(VfsNode *node) {
+    pthread_rwlock_wrlock(&node->inode->inodeLock);
+}
+
+void unlockNode(VfsNode *node) {
+    pthread_rwlock_unlock(&node->inode->inodeLock);
+}
+
+VfsNode* findChildNode(VfsNode *parent, const char *name) {
+    if (!parent || !parent->isDirectory) return NULL;
+    VfsNode *node = parent->nameIndexRoot;
+    while (node) {
+        int comparison = strcmp(name, node->name);
+        if (comparison == 0) return node;
+        node = comparison < 0 ? node->nameIndexLeft : node->nameIndexRight;
+    }
+    return NULL;
+}
+
+int seekNameIndex(const VfsNode *directoryNode, const char *afterName, VfsNode **stack) {
+    int depth = 0;
+    VfsNode *node = directoryNode->nameIndexRoot;
+    while (node) {
+        if (!afterName || strcmp(node->name, afterName) > 0) {
+            stack[depth++] = node;
+            node = node->nameIndexLeft;
+        } else {
+            node = node->nameIndexRight;
+        }
+    }
+    return depth;
+}
+
+VfsNode* nextNameIndexEntry(VfsNode **stack, int *depth) {
+    if (*depth == 0) return NULL;
+    VfsNode *entry = stack[--*depth];
+    for (VfsNode *node = entry->nameIndexRight; node; node = node->nameIndexLeft) stack[(*depth)++] = node;
+    return entry;
+}
+
+VfsNode* lookupChildNode(VfsNode *parent, const char *name) {
+    if (!parent || !parent->isDirectory) return NULL;
+    lockNodeShared(parent);
+    VfsNode *node = findChildNode(parent, name);
+    unlockNode(parent);
+    return node;
+}
+
+void pushTraversalFrame(VfsTraversalStack *stack, VfsNode *node, VfsNode *context) {
+    if (stack->count == stack->capacity) {
+        int newCapacity = stack->capacity > 0 ? stack->capacity * 2 : 64;
+        VfsTraversalFrame *newFrames = realloc(stack->frames, sizeof(VfsTraversalFrame) * newCapacity);
+        if (!newFrames) exitWithError("Out of memory");
+        stack->frames = newFrames;
+        stack->capacity = newCapacity;
+    }
+    stack->frames[stack->count].node = node;
+    stack->frames[stack->count].context = context;
+    stack->count++;
+}
+
+void pushChildFrames(VfsTraversalStack *stack, const VfsNode *directoryNode, VfsNode *context) {
+    if (!directoryNode->isDirectory || !directoryNode->firstChild) return;
+    VfsNode *last = directoryNode->firstChild->prevSibling;
+    VfsNode *child = last;
+    do {
+        pushTraversalFrame(stack, child, context);
+        child = child->prevSibling;
+    } while (child != last);
+}
+
+int getFileBlockCount(const VfsNode *fileNode) {
+    return fileNode->inode->blockMap ? fileNode->inode->blockMap->blockCount : 0;
+}
+
+void unlinkPathCacheEntry(PathCacheEntry *entry) {
+    PathCacheEntry **link = &pathCacheBuckets[entry->pathHash & (pathCacheBucketCount - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    entry->node->pathCacheEntry = NULL;
+    free(entry->path);
+    free(entry);
+    pathCacheEntryCount--;
+}
+
+void growPathCache() {
+    int newBucketCount = pathCacheBucketCount ? pathCacheBucketCount * 2 : PATH_CACHE_INITIAL_BUCKETS;
+    PathCacheEntry **newBuckets = calloc(newBucketCount, sizeof(PathCacheEntry*));
+    if (!newBuckets) exitWithError("Out of memory");
+    for (int i = 0; i < pathCacheBucketCount; ++i) {
+        PathCacheEntry *entry = pathCacheBuckets[i];
+        while (entry) {
+            PathCacheEntry *next = entry->next;
+            int bucket = entry->pathHash & (newBucketCount - 1);
+            entry->next = newBuckets[bucket];
+            newBuckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(pathCacheBuckets);
+    pathCacheBuckets = newBuckets;
+    pathCacheBucketCount = newBucketCount;
+}
+
+void insertPathCacheEntry(const char *path, int length, unsigned int hash, VfsNode *node) {
+    if (node->pathCacheEntry) unlinkPathCacheEntry(node->pathCacheEntry);
+    if (pathCacheEntryCount >= pathCacheBucketCount) growPathCache();
+    PathCacheEntry *entry = malloc(sizeof(PathCacheEntry));
+    if (!entry) exitWithError("Out of memory");
+    entry->path = malloc(length + 1);
+    if (!entry->path) exitWithError("Out of memory");
+    memcpy(entry->path, path, length);
+    entry->path[length] = '\0';
+    entry->pathLength = length;
+    entry->pathHash = hash;
+    entry->generation = pathCacheGeneration;
+    entry->node = node;
+    int bucket = hash & (pathCacheBucketCount - 1);
+    entry->next = pathCacheBuckets[bucket];
+    pathCacheBuckets[bucket] = entry;
+    node->pathCacheEntry = entry;
+    pathCacheEntryCount++;
+}
+
+VfsNode* lookupPathCache(const char *path, int length, unsigned int hash) {
+    if (!pathCacheBucketCount) return NULL;
+    PathCacheEntry *entry = pathCacheBuckets[hash & (pathCacheBucketCount - 1)];
+    while (entry) {
+        if (entry->pathHash == hash && entry->pathLength == length && memcmp(entry->path, path, length) == 0) {
+            if (entry->generation == pathCacheGeneration) return entry->node;
+            unlinkPathCacheEntry(entry);
+            return NULL;
+        }
+        entry = entry->next;
+    }
+    return NULL;
+}
+
+void invalidatePathCaches() {
+    pathCacheGeneration++;
+}
+
+const char* getDirectoryPath(VfsNode *directoryNode) {
+    pthread_mutex_lock(&pathCacheLock);
+    if (directoryNode->cachedPath && directoryNode->cachedPathGeneration == pathCacheGeneration) {
+        pthread_mutex_unlock(&pathCacheLock);
+        return directoryNode->cachedPath;
+    }
+    free(directoryNode->cachedPath);
+    VfsNode *parent = directoryNode->parent;
+    char *path;
+    if (!parent) {
+        path = malloc(2);
+        if (!path) exitWithError("Out of memory");
+        strcpy(path, "/");
+    } else if (parent->cachedPath && parent->cachedPathGeneration == pathCacheGeneration) {
+        int parentLength = parent->parent ? strlen(parent->cachedPath) : 0;
+        int nameLength = strlen(directoryNode->name);
+        path = malloc(parentLength + nameLength + 2);
+        if (!path) exitWithError("Out of memory");
+        memcpy(path, parent->cachedPath, parentLength);
+        path[parentLength] = '/';
+        memcpy(path + parentLength + 1, directoryNode->name, nameLength + 1);
+    } else {
+        int pathLength = 0;
+        for (VfsNode *cursor = directoryNode; cursor->parent; cursor = cursor->parent) pathLength += strlen(cursor->name) + 1;
+        path = malloc(pathLength + 1);
+        if (!path) exitWithError("Out of memory");
+        path[pathLength] = '\0';
+        int writeOffset = pathLength;
+        for (VfsNode *cursor = directoryNode; cursor->parent; cursor = cursor->parent) {
+            int nameLength = strlen(cursor->name);
+            writeOffset -= nameLength;
+            memcpy(path + writeOffset, cursor->name, nameLength);
+            path[--writeOffset] = '/';
+        }
+    }
+    directoryNode->cachedPath = path;
+    directoryNode->cachedPathGeneration = pathCacheGeneration;
+    pthread_mutex_unlock(&pathCacheLock);
+    return path;
+}
+
+int normalizeVfsPath(const char *path, char *outputBuffer, int bufferSize) {
+    int length = 0;
+    if (path[0] != '/') {
+        const char *basePath = getDirectoryPath(currentDirectory);
+        length = strlen(basePath);
+        if (length >= bufferSize) return -1;
+        memcpy(outputBuffer, basePath, length);
+        if (length == 1) length = 0;
+    }
+    const char *cursor = path;
+    while (*cursor) {
+        while (*cursor == '/') cursor++;
+        if (!*cursor) break;
+        const char *componentEnd = cursor;
+        while (*componentEnd && *componentEnd != '/') componentEnd++;
+        int componentLength = componentEnd - cursor;
+        if (componentLength == 2 && cursor[0] == '.' && cursor[1] == '.') {
+            while (length > 0 && outputBuffer[length - 1] != '/') length--;
+            if (length > 0) length--;
+        } else if (componentLength != 1 || cursor[0] != '.') {
+            if (componentLength > MAX_NAME_LEN || length + componentLength + 2 > bufferSize) return -1;
+            outputBuffer[length++] = '/';
+            memcpy(outputBuffer + length, cursor, componentLength);
+            length += componentLength;
+        }
+        cursor = componentEnd;
+    }
+    if (length == 0) outputBuffer[length++] = '/';
+    outputBuffer[length] = '\0';
+    return length;
+}
+
+VfsNode* resolveNormalizedPath(char *path, int length) {
+    if (length == 1) return rootDirectory;
+    unsigned int hash = computePathHash(path, length);
+    pthread_mutex_lock(&pathCacheLock);
+    VfsNode *node = lookupPathCache(path, length, hash);
+    if (node) {
+        pathCacheHitCount++;
+        pthread_mutex_unlock(&pathCacheLock);
+        return node;
+    }
+    pathCacheMissCount++;
+    pthread_mutex_unlock(&pathCacheLock);
+    int parentLength = length - 1;
+    while (path[parentLength] != '/') parentLength--;
+    VfsNode *parent = resolveNormalizedPath(path, parentLength ? parentLength : 1);
+    if (!parent || !parent->isDirectory) return NULL;
+    char savedCharacter = path[length];
+    path[length] = '\0';
+    node = lookupChildNode(parent, path + parentLength + 1);
+    if (node) {
+        pthread_mutex_lock(&pathCacheLock);
+        insertPathCacheEntry(path, length, hash, node);
+        pthread_mutex_unlock(&pathCacheLock);
+    }
+    path[length] = savedCharacter;
+    return node;
+}
+
+VfsNode* resolveVfsPath(const char *path) {
+    char normalizedPath[MAX_CMD_LEN];
+    int length = normalizeVfsPath(path, normalizedPath, sizeof(normalizedPath));
+    if (length < 0) return NULL;
+    return resolveNormalizedPath(normalizedPath, length);
+}
+
+void freeVfsNode(VfsNode *node) {
+    if (!node) return;
+    pthread_mutex_lock(&pathCacheLock);
+    if (node->pathCacheEntry) unlinkPathCacheEntry(node->pathCacheEntry);
+    pthread_mutex_unlock(&pathCacheLock);
+    pthread_mutex_lock(&journalLock);
+    if (node->nodeId < journalNodeTableCapacity && journalNodeTable[node->nodeId] == node) journalNodeTable[node->nodeId] = NULL;
+    pthread_mutex_unlock(&journalLock);
+    VfsNode *previousLink = node;
+    while (previousLink->nextLink != node) previousLink = previousLink->nextLink;
+    previousLink->nextLink = node->nextLink;
+    free(node->cachedPath);
+    releaseVfsName(node->name);
+    releaseVfsInode(node->inode);
+    node->inode = NULL;
+    releasePoolObject(&vfsNodePool, node);
+}
+
+long getMonotonicMillis() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+unsigned int computeJournalChecksum(const unsigned char *data, size_t length) {
+    unsigned int hash = 2166136261U;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+void writeFullBuffer(int fileDescriptor, const unsigned char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fileDescriptor, data, length);
+        if (written <= 0) exitWithError("Cannot write journal");
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+void reserveJournalBuffer(size_t extraBytes) {
+    if (journalBufferLength + extraBytes <= journalBufferCapacity) return;
+    size_t newCapacity = journalBufferCapacity > 0 ? journalBufferCapacity : 4096;
+    while (newCapacity < journalBufferLength + extraBytes) newCapacity *= 2;
+    unsigned char *newBuffer = realloc(journalBuffer, newCapacity);
+    if (!newBuffer) exitWithError("Out of memory");
+    journalBuffer = newBuffer;
+    journalBufferCapacity = newCapacity;
+}
+
+void appendJournalBytes(const void *data, int length) {
+    reserveJournalBuffer(length);
+    memcpy(journalBuffer + journalBufferLength, data, length);
+    journalBufferLength += length;
+}
+
+void appendJournalInt(int value) {
+    appendJournalBytes(&value, sizeof(int));
+}
+
+void beginJournalRecord(int recordType) {
+    reserveJournalBuffer(JOURNAL_HEADER_SIZE);
+    journalRecordStart = journalBufferLength;
+    journalBuffer[journalRecordStart + 8] = (unsigned char)recordType;
+    journalBufferLength += JOURNAL_HEADER_SIZE;
+}
+
+void endJournalRecord() {
+    unsigned int payloadLength = (unsigned int)(journalBufferLength - journalRecordStart - JOURNAL_HEADER_SIZE);
+    unsigned int checksum = computeJournalChecksum(journalBuffer + journalRecordStart + 8, payloadLength + 1);
+    memcpy(journalBuffer + journalRecordStart, &payloadLength, 4);
+    memcpy(journalBuffer + journalRecordStart + 4, &checksum, 4);
+}
+
+int isJournalActive() {
+    return journalFileDescriptor >= 0 && !journalReplayInProgress;
+}
+
+void executeBlockIoRequest(BlockIoRequest *request) {
+    do {
+        if (request->isWrite) request->result = pwritev(imageFileDescriptor, request->vectors, request->vectorCount, request->offset);
+        else request->result = preadv(imageFileDescriptor, request->vectors, request->vectorCount, request->offset);
+    } while (request->result < 0 && errno == EINTR);
+}
+
+ssize_t getBlockIoRequestLength(const BlockIoRequest *request) {
+    ssize_t length = 0;
+    for (int i = 0; i < request->vectorCount; ++i) length += (ssize_t)request->vectors[i].iov_len;
+    return length;
+}
+
+int setupBlockIoRing() {
+    struct io_uring_params parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    int ringDescriptor = (int)syscall(__NR_io_uring_setup, BLOCK_IO_QUEUE_DEPTH, &parameters);
+    if (ringDescriptor < 0) return -1;
+    BlockIoRing ring = {.ringDescriptor = ringDescriptor};
+    ring.submissionRingSize = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+    ring.completionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(struct io_uring_cqe);
+    if (parameters.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.completionRingSize > ring.submissionRingSize) ring.submissionRingSize = ring.completionRingSize;
+        ring.completionRingSize = 0;
+    }
+    ring.submissionRing = mmap(NULL, ring.submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_SQ_RING);
+    ring.completionRing = ring.submissionRing;
+    if (ring.submissionRing != MAP_FAILED && ring.completionRingSize > 0) {
+        ring.completionRing = mmap(NULL, ring.completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_CQ_RING);
+    }
+    ring.submissionEntriesSize = parameters.sq_entries * sizeof(struct io_uring_sqe);
+    ring.submissionEntries = MAP_FAILED;
+    if (ring.submissionRing != MAP_FAILED && ring.completionRing != MAP_FAILED) {
+        ring.submissionEntries = mmap(NULL, ring.submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_SQES);
+    }
+    if (ring.submissionEntries == MAP_FAILED) {
+        if (ring.completionRing != MAP_FAILED && ring.completionRingSize > 0) munmap(ring.completionRing, ring.completionRingSize);
+        if (ring.submissionRing != MAP_FAILED) munmap(ring.submissionRing, ring.submissionRingSize);
+        close(ringDescriptor);
+        return -1;
+    }
+    unsigned char *submissionBase = ring.submissionRing;
+    unsigned char *completionBase = ring.completionRing;
+    ring.submissionTail = (unsigned *)(submissionBase + parameters.sq_off.tail);
+    ring.submissionMask = (unsigned *)(submissionBase + parameters.sq_off.ring_mask);
+    ring.submissionArray = (unsigned *)(submissionBase + parameters.sq_off.array);
+    ring.completionHead = (unsigned *)(completionBase + parameters.cq_off.head);
+    ring.completionTail = (unsigned *)(completionBase + parameters.cq_off.tail);
+    ring.completionMask = (unsigned *)(completionBase + parameters.cq_off.ring_mask);
+    ring.completionEntries = (struct io_uring_cqe *)(completionBase + parameters.cq_off.cqes);
+    ring.entryCount = parameters.sq_entries;
+    blockIoRing = ring;
+    return 0;
+}
+
+void releaseBlockIoRing() {
+    if (blockIoRing.ringDescriptor < 0) return;
+    munmap(blockIoRing.submissionEntries, blockIoRing.submissionEntriesSize);
+    if (blockIoRing.completionRingSize > 0) munmap(blockIoRing.completionRing, blockIoRing.completionRingSize);
+    munmap(blockIoRing.submissionRing, blockIoRing.submissionRingSize);
+    close(blockIoRing.ringDescriptor);
+    blockIoRing.ringDescriptor = -1;
+}
+
+int reapBlockIoCompletions(BlockIoRequest *requests) {
+    int reapedCount = 0;
+    unsigned head = *blockIoRing.completionHead;
+    unsigned tail = __atomic_load_n(blockIoRing.completionTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *completion = &blockIoRing.completionEntries[head & *blockIoRing.completionMask];
+        requests[completion->user_data].result = completion->res;
+        head++;
+        reapedCount++;
+    }
+    __atomic_store_n(blockIoRing.completionHead, head, __ATOMIC_RELEASE);
+    return reapedCount;
+}
+
+void submitBlockIoRing(BlockIoRequest *requests, int count) {
+    int position = 0;
+    while (position < count) {
+        int chunkCount = count - position < (int)blockIoRing.entryCount ? count - position : (int)blockIoRing.entryCount;
+        unsigned tail = *blockIoRing.submissionTail;
+        for (int i = 0; i < chunkCount; ++i) {
+            BlockIoRequest *request = &requests[position + i];
+            unsigned slot = (tail + i) & *blockIoRing.submissionMask;
+            struct io_uring_sqe *entry = &blockIoRing.submissionEntries[slot];
+            memset(entry, 0, sizeof(*entry));
+            entry->opcode = request->isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+            entry->fd = imageFileDescriptor;
+            entry->addr = (unsigned long)request->vectors;
+            entry->len = (unsigned)request->vectorCount;
+            entry->off = (unsigned long long)request->offset;
+            entry->user_data = (unsigned long long)(position + i);
+            blockIoRing.submissionArray[slot] = slot;
+        }
+        __atomic_store_n(blockIoRing.submissionTail, tail + chunkCount, __ATOMIC_RELEASE);
+        int unsubmittedCount = chunkCount;
+        int completedCount = 0;
+        while (completedCount < chunkCount) {
+            int result = (int)syscall(__NR_io_uring_enter, blockIoRing.ringDescriptor, unsubmittedCount, chunkCount - completedCount, IORING_ENTER_GETEVENTS, NULL, 0);
+            if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) exitWithError("Cannot submit disk image I/O");
+            if (result > 0) unsubmittedCount -= result;
+            completedCount += reapBlockIoCompletions(requests);
+        }
+        if (chunkCount > blockIoMaxInFlight) blockIoMaxInFlight = chunkCount;
+        blockIoSubmissionCount++;
+        position += chunkCount;
+    }
+}
+
+void* runBlockIoWorker(void *argument) {
+    (void)argument;
+    BlockIoWorkerPool *pool = &blockIoWorkerPool;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stopRequested && pool->nextRequest >= pool->requestCount) pthread_cond_wait(&pool->workAvailable, &pool->lock);
+        if (pool->stopRequested) break;
+        BlockIoRequest *request = &pool->requests[pool->nextRequest++];
+        pthread_mutex_unlock(&pool->lock);
+        executeBlockIoRequest(request);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finishedCount == pool->requestCount) pthread_cond_signal(&pool->workFinished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int startBlockIoWorkers() {
+    BlockIoWorkerPool *pool = &blockIoWorkerPool;
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->workAvailable, NULL);
+    pthread_cond_init(&pool->workFinished, NULL);
+    for (int i = 0; i < BLOCK_IO_WORKER_COUNT; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, runBlockIoWorker, NULL) != 0) break;
+        pool->threadCount++;
+    }
+    return pool->threadCount > 0 ? 0 : -1;
+}
+
+void stopBlockIoWorkers() {
+    BlockIoWorkerPool *pool = &blockIoWorkerPool;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopRequested = 1;
+    pthread_cond_broadcast(&pool->workAvailable);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threadCount; ++i) pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->workFinished);
+    pthread_cond_destroy(&pool->workAvailable);
+    pthread_mutex_destroy(&pool->lock);
+    pool->threadCount = 0;
+}
+
+void submitBlockIoWorkers(BlockIoRequest *requests, int count) {
+    BlockIoWorkerPool *pool = &blockIoWorkerPool;
+    pthread_mutex_lock(&pool->lock);
+    pool->requests = requests;
+    pool->requestCount = count;
+    pool->nextRequest = 0;
+    pool->finishedCount = 0;
+    pthread_cond_broadcast(&pool->workAvailable);
+    while (pool->finishedCount < pool->requestCount) pthread_cond_wait(&pool->workFinished, &pool->lock);
+    pool->requests = NULL;
+    pool->requestCount = 0;
+    pool->nextRequest = 0;
+    pthread_mutex_unlock(&pool->lock);
+    int inFlightCount = count < pool->threadCount ? count : pool->threadCount;
+    if (inFlightCount > blockIoMaxInFlight) blockIoMaxInFlight = inFlightCount;
+    blockIoSubmissionCount++;
+}
+
+void runBlockIoBatch(BlockIoRequest *requests, int count) {
+    if (count <= 0) return;
+    if (count == 1 || blockIoBackend == BLOCK_IO_BACKEND_SYNC) {
+        for (int i = 0; i < count; ++i) executeBlockIoRequest(&requests[i]);
+        if (blockIoMaxInFlight < 1) blockIoMaxInFlight = 1;
+        blockIoSubmissionCount += count;
+    } else if (blockIoBackend == BLOCK_IO_BACKEND_URING) {
+        submitBlockIoRing(requests, count);
+    } else {
+        submitBlockIoWorkers(requests, count);
+    }
+    blockIoRequestCount += count;
+    for (int i = 0; i < count; ++i) {
+        if (requests[i].result != getBlockIoRequestLength(&requests[i])) exitWithError(requests[i].isWrite ? "Cannot write disk image" : "Cannot read disk image");
+    }
+}
+
+void initializeBlockIo() {
+    blockIoBackend = BLOCK_IO_BACKEND_SYNC;
+    if (requestedBlockIoBackend == BLOCK_IO_BACKEND_URING && setupBlockIoRing() == 0) {
+        blockIoBackend = BLOCK_IO_BACKEND_URING;
+    } else if (requestedBlockIoBackend != BLOCK_IO_BACKEND_SYNC && startBlockIoWorkers() == 0) {
+        blockIoBackend = BLOCK_IO_BACKEND_THREADS;
+    }
+    blockIoSubmissionCount = 0;
+    blockIoRequestCount = 0;
+    blockIoMaxInFlight = 0;
+}
+
+void releaseBlockIo() {
+    if (blockIoBackend == BLOCK_IO_BACKEND_URING) releaseBlockIoRing();
+    if (blockIoBackend == BLOCK_IO_BACKEND_THREADS) stopBlockIoWorkers();
+    blockIoBackend = BLOCK_IO_BACKEND_SYNC;
+}
+
+const char* getBlockIoBackendName(int backend) {
+    if (backend == BLOCK_IO_BACKEND_URING) return "io_uring";
+    if (backend == BLOCK_IO_BACKEND_THREADS) return "threads";
+    return "sync";
+}
+
+void initializeBlockCache() {
+    blockCacheFrames = malloc(sizeof(BlockCacheFrame) * BLOCK_CACHE_FRAME_COUNT);
+    blockCacheData = malloc((size_t)BLOCK_CACHE_FRAME_COUNT * VFS_BLOCK_SIZE);
+    blockCacheFrameOfBlock = malloc(sizeof(int) * TOTAL_BLOCKS);
+    if (!blockCacheFrames || !blockCacheData || !blockCacheFrameOfBlock) exitWithError("Out of memory");
+    for (int i = 0; i < BLOCK_CACHE_FRAME_COUNT; ++i) {
+        blockCacheFrames[i].blockIndex = -1;
+        blockCacheFrames[i].pinCount = 0;
+        blockCacheFrames[i].isDirty = 0;
+        blockCacheFrames[i].isReferenced = 0;
+        blockCacheFrames[i].data = blockCacheData + (size_t)i * VFS_BLOCK_SIZE;
+    }
+    for (int i = 0; i < TOTAL_BLOCKS; ++i) blockCacheFrameOfBlock[i] = -1;
+    blockCacheClockHand = 0;
+    blockCacheDirtyFrameCount = 0;
+    initializeBlockIo();
+}
+
+void releaseBlockCache() {
+    releaseBlockIo();
+    free(blockCacheFrames);
+    free(blockCacheData);
+    free(blockCacheFrameOfBlock);
+    blockCacheFrames = NULL;
+    blockCacheData = NULL;
+    blockCacheFrameOfBlock = NULL;
+}
+
+int compareFramesByBlock(const void *left, const void *right) {
+    int leftBlock = (*(BlockCacheFrame * const *)left)->blockIndex;
+    int rightBlock = (*(BlockCacheFrame * const *)right)->blockIndex;
+    return (leftBlock > rightBlock) - (leftBlock < rightBlock);
+}
+
+void writeBackDirtyFrames() {
+    if (blockCacheDirtyFrameCount == 0) return;
+    BlockCacheFrame *dirtyFrames[BLOCK_CACHE_FRAME_COUNT];
+    int dirtyCount = 0;
+    for (int i = 0; i < BLOCK_CACHE_FRAME_COUNT; ++i) {
+        if (blockCacheFrames[i].isDirty) dirtyFrames[dirtyCount++] = &blockCacheFrames[i];
+    }
+    qsort(dirtyFrames, dirtyCount, sizeof(BlockCacheFrame *), compareFramesByBlock);
+    struct iovec vectors[BLOCK_CACHE_FRAME_COUNT];
+    BlockIoRequest requests[BLOCK_CACHE_FRAME_COUNT];
+    int requestCount = 0;
+    int runStart = 0;
+    while (runStart < dirtyCount) {
+        int firstBlock = dirtyFrames[runStart]->blockIndex;
+        int runLength = 0;
+        while (runStart + runLength < dirtyCount && runLength < BLOCK_CACHE_IO_VECTOR_COUNT && dirtyFrames[runStart + runLength]->blockIndex == firstBlock + runLength) {
+            vectors[runStart + runLength].iov_base = dirtyFrames[runStart + runLength]->data;
+            vectors[runStart + runLength].iov_len = VFS_BLOCK_SIZE;
+            runLength++;
+        }
+        requests[requestCount].vectors = vectors + runStart;
+        requests[requestCount].vectorCount = runLength;
+        requests[requestCount].isWrite = 1;
+        requests[requestCount].offset = (off_t)firstBlock * VFS_BLOCK_SIZE;
+        requestCount++;
+        runStart += runLength;
+    }
+    runBlockIoBatch(requests, requestCount);
+    for (int i = 0; i < dirtyCount; ++i) dirtyFrames[i]->isDirty = 0;
+    blockCacheWritebackBatchCount += requestCount;
+    blockCacheWritebackBlockCount += dirtyCount;
+    blockCacheDirtyFrameCount = 0;
+    imageNeedsSync = 1;
+}
+
+BlockCacheFrame* claimCacheFrame() {
+    for (int scanned = 0; scanned < 2 * BLOCK_CACHE_FRAME_COUNT; ++scanned) {
+        BlockCacheFrame *frame = &blockCacheFrames[blockCacheClockHand];
+        blockCacheClockHand = (blockCacheClockHand + 1) % BLOCK_CACHE_FRAME_COUNT;
+        if (frame->pinCount > 0) continue;
+        if (frame->isReferenced) {
+            frame->isReferenced = 0;
+            continue;
+        }
+        if (frame->isDirty) writeBackDirtyFrames();
+        if (frame->blockIndex >= 0) blockCacheFrameOfBlock[frame->blockIndex] = -1;
+        frame->blockIndex = -1;
+        return frame;
+    }
+    exitWithError("Block cache exhausted");
+    return NULL;
+}
+
+void installCacheFrame(BlockCacheFrame *frame, int blockIndex) {
+    frame->blockIndex = blockIndex;
+    frame->isDirty = 0;
+    frame->isReferenced = 1;
+    blockCacheFrameOfBlock[blockIndex] = (int)(frame - blockCacheFrames);
+}
+
+void lockBlockCache() {
+    if (blockCacheFrames) pthread_mutex_lock(&blockCacheLock);
+}
+
+void unlockBlockCache() {
+    if (blockCacheFrames) pthread_mutex_unlock(&blockCacheLock);
+}
+
+unsigned char* accessDiskBlock(int blockIndex, int overwritesBlock) {
+    if (!blockCacheFrames) return virtualDisk + ((size_t)blockIndex * VFS_BLOCK_SIZE);
+    int frameIndex = blockCacheFrameOfBlock[blockIndex];
+    if (frameIndex >= 0) {
+        if (!overwritesBlock) blockCacheHitCount++;
+        blockCacheFrames[frameIndex].isReferenced = 1;
+        return blockCacheFrames[frameIndex].data;
+    }
+    BlockCacheFrame *frame = claimCacheFrame();
+    if (!overwritesBlock) {
+        blockCacheMissCount++;
+        if (pread(imageFileDescriptor, frame->data, VFS_BLOCK_SIZE, (off_t)blockIndex * VFS_BLOCK_SIZE) != VFS_BLOCK_SIZE) exitWithError("Cannot read disk image");
+    }
+    installCacheFrame(frame, blockIndex);
+    return frame->data;
+}
+
+void completeReadaheadBatch(BlockIoRequest *requests, int requestCount, BlockCacheFrame **frames, int frameCount) {
+    runBlockIoBatch(requests, requestCount);
+    for (int i = 0; i < frameCount; ++i) frames[i]->pinCount--;
+    blockCacheReadaheadCount += frameCount;
+}
+
+void prefetchDiskBlocks(const int *blockIndexes, int count) {
+    if (!blockCacheFrames) return;
+    pthread_mutex_lock(&blockCacheLock);
+    BlockCacheFrame *batchFrames[BLOCK_CACHE_IO_VECTOR_COUNT];
+    struct iovec vectors[BLOCK_CACHE_IO_VECTOR_COUNT];
+    BlockIoRequest requests[BLOCK_CACHE_IO_VECTOR_COUNT];
+    int frameCount = 0;
+    int requestCount = 0;
+    int position = 0;
+    while (position < count) {
+        int firstBlock = blockIndexes[position];
+        if (firstBlock < 0 || blockCacheFrameOfBlock[firstBlock] >= 0) {
+            position++;
+            continue;
+        }
+        BlockIoRequest *request = &requests[requestCount++];
+        request->vectors = vectors + frameCount;
+        request->vectorCount = 0;
+        request->isWrite = 0;
+        request->offset = (off_t)firstBlock * VFS_BLOCK_SIZE;
+        while (position < count && frameCount < BLOCK_CACHE_IO_VECTOR_COUNT && blockIndexes[position] == firstBlock + request->vectorCount && blockCacheFrameOfBlock[blockIndexes[position]] < 0) {
+            BlockCacheFrame *frame = claimCacheFrame();
+            installCacheFrame(frame, blockIndexes[position]);
+            frame->pinCount++;
+            batchFrames[frameCount] = frame;
+            vectors[frameCount].iov_base = frame->data;
+            vectors[frameCount].iov_len = VFS_BLOCK_SIZE;
+            frameCount++;
+            request->vectorCount++;
+            position++;
+        }
+        if (frameCount == BLOCK_CACHE_IO_VECTOR_COUNT) {
+            completeReadaheadBatch(requests, requestCount, batchFrames, frameCount);
+            frameCount = 0;
+            requestCount = 0;
+        }
+    }
+    completeReadaheadBatch(requests, requestCount, batchFrames, frameCount);
+    pthread_mutex_unlock(&blockCacheLock);
+}
+
+const unsigned char* pinDiskBlock(int blockIndex) {
+    lockBlockCache();
+    const unsigned char *data = accessDiskBlock(blockIndex, 0);
+    if (blockCacheFrames) blockCacheFrames[blockCacheFrameOfBlock[blockIndex]].pinCount++;
+    unlockBlockCache();
+    return data;
+}
+
+void unpinDiskBlock(int blockIndex) {
+    lockBlockCache();
+    if (blockCacheFrames) blockCacheFrames[blockCacheFrameOfBlock[blockIndex]].pinCount--;
+    unlockBlockCache();
+}
+
+void markDiskBlockDirty(int blockIndex) {
+    if (!blockCacheFrames) return;
+    BlockCacheFrame *frame = &blockCacheFrames[blockCacheFrameOfBlock[blockIndex]];
+    if (frame->isDirty) return;
+    frame->isDirty = 1;
+    blockCacheDirtyFrameCount++;
+}
+
+void flushDirtyDiskBlocks() {
+    if (!blockCacheFrames) return;
+    pthread_mutex_lock(&blockCacheLock);
+    writeBackDirtyFrames();
+    if (imageNeedsSync) {
+        if (fdatasync(imageFileDescriptor) != 0) exitWithError("Cannot sync disk image");
+        imageNeedsSync = 0;
+    }
+    pthread_mutex_unlock(&blockCacheLock);
+}
+
+void writeFileMapRecord(const VfsNode *fileNode, int firstSlot, int endSlot) {
+    VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    int blockCount = blockMap ? blockMap->blockCount : 0;
+    if (firstSlot > blockCount) firstSlot = blockCount;
+    firstSlot = firstSlot / COMPRESSION_EXTENT_BLOCKS * COMPRESSION_EXTENT_BLOCKS;
+    endSlot = (endSlot + COMPRESSION_EXTENT_BLOCKS - 1) / COMPRESSION_EXTENT_BLOCKS * COMPRESSION_EXTENT_BLOCKS;
+    if (endSlot > blockCount) endSlot = blockCount;
+    if (endSlot < firstSlot) endSlot = firstSlot;
+    beginJournalRecord(JOURNAL_RECORD_FILE_MAP);
+    appendJournalInt(fileNode->nodeId);
+    appendJournalInt(fileNode->inode->fileSize);
+    appendJournalInt(blockCount);
+    appendJournalInt(firstSlot);
+    appendJournalInt(endSlot - firstSlot);
+    if (endSlot > firstSlot) {
+        appendJournalBytes(blockMap->blocks + firstSlot, sizeof(int) * (endSlot - firstSlot));
+        for (int extent = firstSlot / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < endSlot; ++extent) {
+            appendJournalInt(blockMap->extentCompressedLengths[extent]);
+        }
+    }
+    long modifyTime = __atomic_load_n(&fileNode->inode->modifyTime, __ATOMIC_RELAXED);
+    long changeTime = __atomic_load_n(&fileNode->inode->changeTime, __ATOMIC_RELAXED);
+    appendJournalBytes(&modifyTime, sizeof(long));
+    appendJournalBytes(&changeTime, sizeof(long));
+}
+
+void writeCreateRecord(const VfsNode *node) {
+    beginJournalRecord(JOURNAL_RECORD_CREATE);
+    appendJournalInt(node->nodeId);
+    appendJournalInt(node->parent->nodeId);
+    appendJournalInt(node->isDirectory);
+    appendJournalBytes(node->name, (int)strlen(node->name));
+}
+
+void writeLinkRecord(const VfsNode *linkNode, const VfsNode *targetNode) {
+    beginJournalRecord(JOURNAL_RECORD_LINK);
+    appendJournalInt(linkNode->nodeId);
+    appendJournalInt(linkNode->parent->nodeId);
+    appendJournalInt(targetNode->nodeId);
+    appendJournalBytes(linkNode->name, (int)strlen(linkNode->name));
+}
+
+void writeAttributeRecord(const VfsNode *node) {
+    const VfsInode *inode = node->inode;
+    long timestamps[3] = {__atomic_load_n(&inode->modifyTime, __ATOMIC_RELAXED), __atomic_load_n(&inode->changeTime, __ATOMIC_RELAXED), __atomic_load_n(&inode->accessTime, __ATOMIC_RELAXED)};
+    beginJournalRecord(JOURNAL_RECORD_ATTRIBUTES);
+    appendJournalInt(node->nodeId);
+    appendJournalInt(inode->mode);
+    appendJournalInt(inode->attributeBlock);
+    appendJournalInt(inode->attributeLength);
+    appendJournalBytes(timestamps, sizeof(timestamps));
+    if (inode->attributeBlock < 0) appendJournalBytes(inode->inlineAttributes, inode->attributeLength);
+}
+
+void writeCommitRecord() {
+    long timestamp = getVfsTimestamp();
+    beginJournalRecord(JOURNAL_RECORD_COMMIT);
+    appendJournalInt((int)journalCommitCount);
+    appendJournalBytes(&timestamp, sizeof(long));
+    endJournalRecord();
+}
+
+VfsNode* getPrimaryLink(VfsNode *fileNode) {
+    VfsNode *primaryLink = fileNode;
+    for (VfsNode *link = fileNode->nextLink; link != fileNode; link = link->nextLink) {
+        if (link->nodeId < primaryLink->nodeId) primaryLink = link;
+    }
+    return primaryLink;
+}
+
+VfsNode* findWrittenLink(VfsNode *fileNode, const unsigned char *writtenLinkBits) {
+    for (VfsNode *link = fileNode->nextLink; link != fileNode; link = link->nextLink) {
+        if (writtenLinkBits[link->nodeId / 8] & (1 << (link->nodeId % 8))) return link;
+    }
+    return NULL;
+}
+
+void writeCheckpointRecords(VfsNode *directoryNode) {
+    VfsTraversalStack stack = {0};
+    VfsTraversalStack attributeNodes = {0};
+    unsigned char *writtenLinkBits = calloc(__atomic_load_n(&nextNodeId, __ATOMIC_RELAXED) / 8 + 1, 1);
+    if (!writtenLinkBits) exitWithError("Out of memory");
+    pushTraversalFrame(&attributeNodes, directoryNode, NULL);
+    pushChildFrames(&stack, directoryNode, NULL);
+    while (stack.count > 0) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        if (!node->isDirectory && node->nextLink != node) {
+            VfsNode *writtenLink = findWrittenLink(node, writtenLinkBits);
+            if (writtenLink) {
+                writeLinkRecord(node, writtenLink);
+                endJournalRecord();
                 continue;
             }
-            int size = content ? (int)strlen(content) : 0;
-            int result = writeFileContent(fileNode, (const unsigned char *)(content ? content : ""), size);
-            if (content) free(content);
-            if (result == 0) {
-                printf("Data written (%d bytes) to %s/%s\n", size, currentPath, fileName);
-            } else if (result == -2) {
-                printf("Error: not enough disk space\n");
+            writtenLinkBits[node->nodeId / 8] |= 1 << (node->nodeId % 8);
+        }
+        pushTraversalFrame(&attributeNodes, node, NULL);
+        writeCreateRecord(node);
+        endJournalRecord();
+        if (node->isDirectory) {
+            pushChildFrames(&stack, node, NULL);
+        } else {
+            writeFileMapRecord(node, 0, getFileBlockCount(node));
+            endJournalRecord();
+        }
+    }
+    for (int i = 0; i < attributeNodes.count; ++i) {
+        writeAttributeRecord(attributeNodes.frames[i].node);
+        endJournalRecord();
+    }
+    free(stack.frames);
+    free(attributeNodes.frames);
+    free(writtenLinkBits);
+}
+
+void checkpointJournal() {
+    char temporaryPath[MAX_PATH_LEN + 8];
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", journalPath);
+    int checkpointDescriptor = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (checkpointDescriptor < 0) return;
+    writeCheckpointRecords(rootDirectory);
+    writeCommitRecord();
+    writeFullBuffer(checkpointDescriptor, journalBuffer, journalBufferLength);
+    if (fsync(checkpointDescriptor) != 0 || rename(temporaryPath, journalPath) != 0) exitWithError("Cannot checkpoint journal");
+    close(checkpointDescriptor);
+    close(journalFileDescriptor);
+    journalFileDescriptor = open(journalPath, O_RDWR | O_APPEND);
+    if (journalFileDescriptor < 0) exitWithError("Cannot reopen journal");
+    journalFileSize = (long)journalBufferLength;
+    journalBufferLength = 0;
+}
+
+long commitJournal() {
+    if (!isJournalActive()) return 0;
+    pthread_mutex_lock(&journalLock);
+    flushDirtyDiskBlocks();
+    if (journalPendingRecordCount > 0) {
+        writeCommitRecord();
+        writeFullBuffer(journalFileDescriptor, journalBuffer, journalBufferLength);
+        if (fsync(journalFileDescriptor) != 0) exitWithError("Cannot sync journal");
+        journalFileSize += (long)journalBufferLength;
+        journalBufferLength = 0;
+        journalPendingRecordCount = 0;
+        journalCommitCount++;
+    }
+    reclaimPendingFreeBlocks();
+    if (journalFileSize > JOURNAL_CHECKPOINT_BYTES) journalCheckpointRequested = 1;
+    long commitCount = journalCommitCount;
+    pthread_mutex_unlock(&journalLock);
+    return commitCount;
+}
+
+void runRequestedCheckpoint() {
+    if (!journalCheckpointRequested || !isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    commitJournal();
+    checkpointJournal();
+    journalCheckpointRequested = 0;
+    pthread_mutex_unlock(&journalLock);
+}
+
+void *runJournalCommitTimerThread(void *argument) {
+    (void)argument;
+    pthread_mutex_lock(&journalCommitTimerLock);
+    while (!journalCommitTimerStopRequested) {
+        if (!journalCommitTimerArmed) {
+            pthread_cond_wait(&journalCommitTimerCondition, &journalCommitTimerLock);
+            continue;
+        }
+        long remainingMillis = journalCommitTimerDueMillis - getMonotonicMillis();
+        if (remainingMillis > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += remainingMillis * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&journalCommitTimerCondition, &journalCommitTimerLock, &deadline);
+            continue;
+        }
+        journalCommitTimerArmed = 0;
+        pthread_mutex_unlock(&journalCommitTimerLock);
+        pthread_mutex_lock(&journalLock);
+        if (journalPendingRecordCount > 0 && getMonotonicMillis() - journalFirstPendingMillis >= JOURNAL_COMMIT_INTERVAL_MS) commitJournal();
+        pthread_mutex_unlock(&journalLock);
+        pthread_mutex_lock(&journalCommitTimerLock);
+    }
+    journalCommitTimerRunning = 0;
+    pthread_cond_broadcast(&journalCommitTimerCondition);
+    pthread_mutex_unlock(&journalCommitTimerLock);
+    return NULL;
+}
+
+void armJournalCommitTimer(long firstPendingMillis) {
+    pthread_mutex_lock(&journalCommitTimerLock);
+    if (!journalCommitTimerRunning) {
+        pthread_t thread;
+        journalCommitTimerStopRequested = 0;
+        if (pthread_create(&thread, NULL, runJournalCommitTimerThread, NULL) != 0) exitWithError("Cannot start journal commit thread");
+        pthread_detach(thread);
+        journalCommitTimerRunning = 1;
+    }
+    journalCommitTimerDueMillis = firstPendingMillis + JOURNAL_COMMIT_INTERVAL_MS;
+    if (!journalCommitTimerArmed) {
+        journalCommitTimerArmed = 1;
+        pthread_cond_broadcast(&journalCommitTimerCondition);
+    }
+    pthread_mutex_unlock(&journalCommitTimerLock);
+}
+
+void stopJournalCommitTimer() {
+    pthread_mutex_lock(&journalCommitTimerLock);
+    journalCommitTimerStopRequested = 1;
+    pthread_cond_broadcast(&journalCommitTimerCondition);
+    while (journalCommitTimerRunning) pthread_cond_wait(&journalCommitTimerCondition, &journalCommitTimerLock);
+    journalCommitTimerArmed = 0;
+    pthread_mutex_unlock(&journalCommitTimerLock);
+}
+
+void finishJournalOperation() {
+    endJournalRecord();
+    publishThreadPendingFrees();
+    journalRecordTotal++;
+    if (journalPendingRecordCount++ == 0) {
+        journalFirstPendingMillis = getMonotonicMillis();
+        armJournalCommitTimer(journalFirstPendingMillis);
+    }
+    if (journalPendingRecordCount >= JOURNAL_GROUP_COMMIT_RECORDS || journalBufferLength >= JOURNAL_GROUP_COMMIT_BYTES || getMonotonicMillis() - journalFirstPendingMillis >= JOURNAL_COMMIT_INTERVAL_MS) {
+        commitJournal();
+    }
+}
+
+void journalCreateNode(const VfsNode *node) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    writeCreateRecord(node);
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalRemoveNode(int nodeId) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    beginJournalRecord(JOURNAL_RECORD_REMOVE);
+    appendJournalInt(nodeId);
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalCloneNode(const VfsNode *sourceNode, const VfsNode *cloneNode) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    beginJournalRecord(JOURNAL_RECORD_CLONE);
+    appendJournalInt(sourceNode->nodeId);
+    appendJournalInt(cloneNode->parent->nodeId);
+    appendJournalInt(cloneNode->nodeId);
+    appendJournalBytes(cloneNode->name, (int)strlen(cloneNode->name));
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalLinkNode(const VfsNode *linkNode, const VfsNode *targetNode) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    writeLinkRecord(linkNode, targetNode);
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalMoveNode(const VfsNode *node) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    beginJournalRecord(JOURNAL_RECORD_MOVE);
+    appendJournalInt(node->nodeId);
+    appendJournalInt(node->parent->nodeId);
+    appendJournalBytes(node->name, (int)strlen(node->name));
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalFileMap(const VfsNode *fileNode, int firstSlot, int endSlot) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    writeFileMapRecord(fileNode, firstSlot, endSlot);
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journalNodeAttributes(const VfsNode *node) {
+    if (!isJournalActive()) return;
+    pthread_mutex_lock(&journalLock);
+    writeAttributeRecord(node);
+    finishJournalOperation();
+    pthread_mutex_unlock(&journalLock);
+}
+
+int ensureFreeBlocks(int requiredBlocks) {
+    int missingBlocks = requiredBlocks - threadReservedBlockCount;
+    if (missingBlocks <= 0) return 1;
+    if (reserveFreeBlocks(missingBlocks)) return 1;
+    if (__atomic_load_n(&pendingFreeBlockCount, __ATOMIC_RELAXED) > 0) commitJournal();
+    return reserveFreeBlocks(missingBlocks);
+}
+
+void readDiskBlockRange(int blockIndex, int offset, unsigned char *destination, int length) {
+    lockBlockCache();
+    memcpy(destination, accessDiskBlock(blockIndex, 0) + offset, length);
+    unlockBlockCache();
+}
+
+void writeDiskBlockRange(int blockIndex, int offset, const unsigned char *source, int length) {
+    lockBlockCache();
+    memcpy(accessDiskBlock(blockIndex, offset == 0 && length == VFS_BLOCK_SIZE) + offset, source, length);
+    markDiskBlockDirty(blockIndex);
+    unlockBlockCache();
+}
+
+void zeroDiskBlockRange(int blockIndex, int offset, int length) {
+    lockBlockCache();
+    memset(accessDiskBlock(blockIndex, offset == 0 && length == VFS_BLOCK_SIZE) + offset, 0, length);
+    markDiskBlockDirty(blockIndex);
+    unlockBlockCache();
+}
+
+unsigned long long computeBlockFingerprint(const unsigned char *data) {
+    unsigned long long hash = 1469598103934665603ULL;
+    for (int i = 0; i < VFS_BLOCK_SIZE; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void deduplicateFileBlock(VfsBlockMap *blockMap, int slot) {
+    int blockIndex = blockMap->blocks[slot];
+    if (blockIndex < 0 || __atomic_load_n(&blockIsIndexed[blockIndex], __ATOMIC_RELAXED)) return;
+    unsigned char content[VFS_BLOCK_SIZE];
+    unsigned char candidateContent[VFS_BLOCK_SIZE];
+    readDiskBlockRange(blockIndex, 0, content, VFS_BLOCK_SIZE);
+    unsigned long long fingerprint = computeBlockFingerprint(content);
+    int bucket = (int)(fingerprint % DEDUP_BUCKET_COUNT);
+    pthread_mutex_lock(&dedupLock);
+    if (blockIsIndexed[blockIndex]) {
+        pthread_mutex_unlock(&dedupLock);
+        return;
+    }
+    for (int candidate = dedupBucketHeads[bucket]; candidate >= 0; candidate = dedupNextInBucket[candidate]) {
+        if (blockFingerprints[candidate] != fingerprint) continue;
+        readDiskBlockRange(candidate, 0, candidateContent, VFS_BLOCK_SIZE);
+        if (memcmp(content, candidateContent, VFS_BLOCK_SIZE) != 0 || !tryRetainDiskBlock(candidate)) continue;
+        pthread_mutex_unlock(&dedupLock);
+        releaseDiskBlock(blockIndex);
+        blockMap->blocks[slot] = candidate;
+        __atomic_add_fetch(&dedupMergedBlockCount, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    insertDedupIndexEntry(blockIndex, fingerprint);
+    pthread_mutex_unlock(&dedupLock);
+}
+
+void deduplicateFileBlockRange(VfsNode *fileNode, int firstSlot, int endSlot) {
+    if (!dedupEnabled || !fileNode->inode->blockMap) return;
+    if (endSlot > fileNode->inode->blockMap->blockCount) endSlot = fileNode->inode->blockMap->blockCount;
+    for (int i = firstSlot; i < endSlot; ++i) deduplicateFileBlock(fileNode->inode->blockMap, i);
+}
+
+int loadNodeAttributes(const VfsNode *node, unsigned char *buffer) {
+    int length = node->inode->attributeLength;
+    if (node->inode->attributeBlock >= 0) {
+        readDiskBlockRange(node->inode->attributeBlock, 0, buffer, length);
+    } else {
+        memcpy(buffer, node->inode->inlineAttributes, length);
+    }
+    return length;
+}
+
+int findAttributeEntry(const unsigned char *attributes, int length, const char *name, int *entryLengthOut) {
+    int nameLength = (int)strlen(name);
+    for (int position = 0; position + 2 <= length;) {
+        int entryLength = 2 + attributes[position] + attributes[position + 1];
+        if (attributes[position] == nameLength && memcmp(attributes + position + 2, name, nameLength) == 0) {
+            *entryLengthOut = entryLength;
+            return position;
+        }
+        position += entryLength;
+    }
+    return -1;
+}
+
+int acquireSharedAttributeBlock(const unsigned char *content) {
+    unsigned long long fingerprint = computeBlockFingerprint(content);
+    unsigned char candidateContent[VFS_BLOCK_SIZE];
+    pthread_mutex_lock(&dedupLock);
+    for (int candidate = dedupBucketHeads[fingerprint % DEDUP_BUCKET_COUNT]; candidate >= 0; candidate = dedupNextInBucket[candidate]) {
+        if (blockFingerprints[candidate] != fingerprint) continue;
+        readDiskBlockRange(candidate, 0, candidateContent, VFS_BLOCK_SIZE);
+        if (memcmp(content, candidateContent, VFS_BLOCK_SIZE) != 0 || !tryRetainDiskBlock(candidate)) continue;
+        pthread_mutex_unlock(&dedupLock);
+        return candidate;
+    }
+    pthread_mutex_unlock(&dedupLock);
+    if (!ensureFreeBlocks(1)) return -2;
+    int blockIndex = allocateFreeBlock();
+    if (blockIndex < 0) return -2;
+    writeDiskBlockRange(blockIndex, 0, content, VFS_BLOCK_SIZE);
+    pthread_mutex_lock(&dedupLock);
+    insertDedupIndexEntry(blockIndex, fingerprint);
+    pthread_mutex_unlock(&dedupLock);
+    return blockIndex;
+}
+
+int storeNodeAttributes(VfsNode *node, const unsigned char *attributes, int length) {
+    if (length > VFS_BLOCK_SIZE) return -1;
+    VfsInode *inode = node->inode;
+    int previousBlock = inode->attributeBlock;
+    if (length <= INLINE_ATTRIBUTE_BYTES) {
+        memcpy(inode->inlineAttributes, attributes, length);
+        inode->attributeBlock = -1;
+    } else {
+        unsigned char content[VFS_BLOCK_SIZE] = {0};
+        memcpy(content, attributes, length);
+        int blockIndex = acquireSharedAttributeBlock(content);
+        if (blockIndex < 0) return blockIndex;
+        inode->attributeBlock = blockIndex;
+    }
+    inode->attributeLength = (unsigned short)length;
+    if (previousBlock >= 0) releaseDiskBlock(previousBlock);
+    touchVfsNode(node, 0);
+    return 0;
+}
+
+int setNodeAttribute(VfsNode *node, const char *name, const unsigned char *value, int valueLength) {
+    int nameLength = (int)strlen(name);
+    if (nameLength == 0 || nameLength > ATTRIBUTE_NAME_MAX_LEN || valueLength > ATTRIBUTE_VALUE_MAX_LEN) return -1;
+    unsigned char attributes[VFS_BLOCK_SIZE];
+    int length = loadNodeAttributes(node, attributes);
+    int entryLength;
+    int entryOffset = findAttributeEntry(attributes, length, name, &entryLength);
+    if (entryOffset >= 0) {
+        memmove(attributes + entryOffset, attributes + entryOffset + entryLength, length - entryOffset - entryLength);
+        length -= entryLength;
+    }
+    int insertPosition = 0;
+    while (insertPosition + 2 <= length) {
+        int existingNameLength = attributes[insertPosition];
+        int comparison = memcmp(attributes + insertPosition + 2, name, existingNameLength < nameLength ? existingNameLength : nameLength);
+        if (comparison > 0 || (comparison == 0 && existingNameLength > nameLength)) break;
+        insertPosition += 2 + existingNameLength + attributes[insertPosition + 1];
+    }
+    entryLength = 2 + nameLength + valueLength;
+    if (length + entryLength > VFS_BLOCK_SIZE) return -3;
+    memmove(attributes + insertPosition + entryLength, attributes + insertPosition, length - insertPosition);
+    attributes[insertPosition] = (unsigned char)nameLength;
+    attributes[insertPosition + 1] = (unsigned char)valueLength;
+    memcpy(attributes + insertPosition + 2, name, nameLength);
+    memcpy(attributes + insertPosition + 2 + nameLength, value, valueLength);
+    length += entryLength;
+    return storeNodeAttributes(node, attributes, length);
+}
+
+int removeNodeAttribute(VfsNode *node, const char *name) {
+    unsigned char attributes[VFS_BLOCK_SIZE];
+    int length = loadNodeAttributes(node, attributes);
+    int entryLength;
+    int entryOffset = findAttributeEntry(attributes, length, name, &entryLength);
+    if (entryOffset < 0) return -1;
+    memmove(attributes + entryOffset, attributes + entryOffset + entryLength, length - entryOffset - entryLength);
+    return storeNodeAttributes(node, attributes, length - entryLength);
+}
+
+void writeLengthExtension(unsigned char *destination, int *outputPosition, int length) {
+    while (length >= 255) {
+        destination[(*outputPosition)++] = 255;
+        length -= 255;
+    }
+    destination[(*outputPosition)++] = (unsigned char)length;
+}
+
+int compressExtentData(const unsigned char *source, int sourceLength, unsigned char *destination, int destinationCapacity) {
+    int hashTable[1 << COMPRESSION_HASH_BITS];
+    for (int i = 0; i < (1 << COMPRESSION_HASH_BITS); ++i) hashTable[i] = -1;
+    int anchor = 0;
+    int position = 0;
+    int outputPosition = 0;
+    int missCount = 0;
+    while (position + 4 <= sourceLength) {
+        unsigned int sequence, candidateSequence;
+        memcpy(&sequence, source + position, 4);
+        int hash = (int)((sequence * 2654435761U) >> (32 - COMPRESSION_HASH_BITS));
+        int candidate = hashTable[hash];
+        hashTable[hash] = position;
+        if (candidate >= 0) memcpy(&candidateSequence, source + candidate, 4);
+        if (candidate < 0 || candidateSequence != sequence) {
+            position += 1 + (missCount++ >> 5);
+            continue;
+        }
+        missCount = 0;
+        int matchLength = 4;
+        while (position + matchLength < sourceLength && source[candidate + matchLength] == source[position + matchLength]) matchLength++;
+        int literalLength = position - anchor;
+        if (outputPosition + 1 + literalLength + literalLength / 255 + 2 + matchLength / 255 + 2 > destinationCapacity) return -1;
+        unsigned char *token = destination + outputPosition++;
+        *token = (unsigned char)(((literalLength >= 15 ? 15 : literalLength) << 4) | (matchLength - 4 >= 15 ? 15 : matchLength - 4));
+        if (literalLength >= 15) writeLengthExtension(destination, &outputPosition, literalLength - 15);
+        memcpy(destination + outputPosition, source + anchor, literalLength);
+        outputPosition += literalLength;
+        destination[outputPosition++] = (unsigned char)((position - candidate) & 0xFF);
+        destination[outputPosition++] = (unsigned char)((position - candidate) >> 8);
+        if (matchLength - 4 >= 15) writeLengthExtension(destination, &outputPosition, matchLength - 4 - 15);
+        position += matchLength;
+        anchor = position;
+    }
+    int literalLength = sourceLength - anchor;
+    if (outputPosition + 1 + literalLength + literalLength / 255 + 1 > destinationCapacity) return -1;
+    destination[outputPosition++] = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (literalLength >= 15) writeLengthExtension(destination, &outputPosition, literalLength - 15);
+    memcpy(destination + outputPosition, source + anchor, literalLength);
+    return outputPosition + literalLength;
+}
+
+int readLengthExtension(const unsigned char *source, int sourceLength, int *inputPosition, int *length) {
+    int extensionByte;
+    do {
+        if (*inputPosition >= sourceLength) return -1;
+        extensionByte = source[(*inputPosition)++];
+        *length += extensionByte;
+    } while (extensionByte == 255);
+    return 0;
+}
+
+int decompressExtentData(const unsigned char *source, int sourceLength, unsigned char *destination, int destinationCapacity) {
+    int inputPosition = 0;
+    int outputPosition = 0;
+    while (inputPosition < sourceLength) {
+        int token = source[inputPosition++];
+        int literalLength = token >> 4;
+        if (literalLength == 15 && readLengthExtension(source, sourceLength, &inputPosition, &literalLength) != 0) return -1;
+        if (inputPosition + literalLength > sourceLength || outputPosition + literalLength > destinationCapacity) return -1;
+        memcpy(destination + outputPosition, source + inputPosition, literalLength);
+        inputPosition += literalLength;
+        outputPosition += literalLength;
+        if (inputPosition == sourceLength) break;
+        if (inputPosition + 2 > sourceLength) return -1;
+        int matchOffset = source[inputPosition] | (source[inputPosition + 1] << 8);
+        inputPosition += 2;
+        int matchLength = (token & 15) + 4;
+        if ((token & 15) == 15 && readLengthExtension(source, sourceLength, &inputPosition, &matchLength) != 0) return -1;
+        if (matchOffset == 0 || matchOffset > outputPosition || outputPosition + matchLength > destinationCapacity) return -1;
+        for (int i = 0; i < matchLength; ++i, ++outputPosition) {
+            destination[outputPosition] = destination[outputPosition - matchOffset];
+        }
+    }
+    return outputPosition;
+}
+
+void ensureBlockMapCapacity(VfsBlockMap *blockMap, int requiredCount) {
+    if (requiredCount <= blockMap->blockCapacity) return;
+    int newCapacity = blockMap->blockCapacity > 0 ? blockMap->blockCapacity : COMPRESSION_EXTENT_BLOCKS;
+    while (newCapacity < requiredCount) newCapacity *= 2;
+    int *newBlocks = realloc(blockMap->blocks, sizeof(int) * newCapacity);
+    if (!newBlocks) exitWithError("Out of memory");
+    int oldExtentCapacity = blockMap->blockCapacity / COMPRESSION_EXTENT_BLOCKS;
+    int newExtentCapacity = newCapacity / COMPRESSION_EXTENT_BLOCKS;
+    int *newLengths = realloc(blockMap->extentCompressedLengths, sizeof(int) * newExtentCapacity);
+    if (!newLengths) exitWithError("Out of memory");
+    memset(newLengths + oldExtentCapacity, 0, sizeof(int) * (newExtentCapacity - oldExtentCapacity));
+    blockMap->blocks = newBlocks;
+    blockMap->extentCompressedLengths = newLengths;
+    blockMap->blockCapacity = newCapacity;
+}
+
+VfsBlockMap* prepareBlockMapForWrite(VfsNode *fileNode) {
+    VfsBlockMap *sharedMap = fileNode->inode->blockMap;
+    if (!sharedMap) {
+        fileNode->inode->blockMap = createBlockMap();
+    } else if (__atomic_load_n(&sharedMap->referenceCount, __ATOMIC_ACQUIRE) > 1) {
+        VfsBlockMap *privateMap = createBlockMap();
+        ensureBlockMapCapacity(privateMap, sharedMap->blockCount);
+        for (int i = 0; i < sharedMap->blockCount; ++i) {
+            privateMap->blocks[i] = sharedMap->blocks[i];
+            if (sharedMap->blocks[i] >= 0) retainDiskBlock(sharedMap->blocks[i]);
+        }
+        privateMap->blockCount = sharedMap->blockCount;
+        for (int extent = 0; extent * COMPRESSION_EXTENT_BLOCKS < privateMap->blockCount; ++extent) {
+            privateMap->extentCompressedLengths[extent] = getCompressedExtentLength(sharedMap, extent);
+            if (privateMap->extentCompressedLengths[extent] > 0) accountCompressedExtent(privateMap, extent, 1);
+        }
+        fileNode->inode->blockMap = privateMap;
+        releaseBlockMap(sharedMap);
+    }
+    return fileNode->inode->blockMap;
+}
+
+int countTailInflationSlots(const VfsNode *fileNode) {
+    int blockCount = getFileBlockCount(fileNode);
+    if (blockCount % COMPRESSION_EXTENT_BLOCKS == 0) return 0;
+    int tailExtent = (blockCount - 1) / COMPRESSION_EXTENT_BLOCKS;
+    if (getCompressedExtentLength(fileNode->inode->blockMap, tailExtent) == 0) return 0;
+    return getExtentSlotCount(fileNode->inode->blockMap, tailExtent);
+}
+
+int countBlocksNeededForWrite(const VfsNode *fileNode, int firstSlot, int endSlot) {
+    VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    if (!blockMap) return 0;
+    if (endSlot > blockMap->blockCount) endSlot = blockMap->blockCount;
+    int count = 0;
+    int slot = firstSlot;
+    while (slot < endSlot) {
+        int extent = slot / COMPRESSION_EXTENT_BLOCKS;
+        if (getCompressedExtentLength(blockMap, extent) > 0) {
+            count += getExtentSlotCount(blockMap, extent);
+            slot = (extent + 1) * COMPRESSION_EXTENT_BLOCKS;
+            continue;
+        }
+        if (blockMap->blocks[slot] < 0 || __atomic_load_n(&blockMap->referenceCount, __ATOMIC_RELAXED) > 1 || getBlockReferenceCount(blockMap->blocks[slot]) > 1) count++;
+        slot++;
+    }
+    return count;
+}
+
+int isZeroBlockChunk(const unsigned char *data, int length) {
+    return length == VFS_BLOCK_SIZE && memcmp(data, zeroDiskBlock, VFS_BLOCK_SIZE) == 0;
+}
+
+int countBlocksNeededForRangeWrite(const VfsNode *fileNode, int offset, const unsigned char *source, int length) {
+    if (offset < 0 || length < 0 || length > MAX_FILE_SIZE - offset) return INT_MAX;
+    VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    int blockCount = getFileBlockCount(fileNode);
+    int firstSlot = offset / VFS_BLOCK_SIZE;
+    int endSlot = (offset + length + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE;
+    int count = endSlot > blockCount ? countTailInflationSlots(fileNode) : 0;
+    int slot = firstSlot;
+    while (slot < endSlot) {
+        int extent = slot / COMPRESSION_EXTENT_BLOCKS;
+        if (slot < blockCount && getCompressedExtentLength(blockMap, extent) > 0) {
+            count += getExtentSlotCount(blockMap, extent);
+            slot = (extent + 1) * COMPRESSION_EXTENT_BLOCKS;
+            continue;
+        }
+        int chunkStart = slot * VFS_BLOCK_SIZE > offset ? slot * VFS_BLOCK_SIZE : offset;
+        int chunkEnd = (slot + 1) * VFS_BLOCK_SIZE < offset + length ? (slot + 1) * VFS_BLOCK_SIZE : offset + length;
+        if (!isZeroBlockChunk(source + (chunkStart - offset), chunkEnd - chunkStart)) {
+            if (slot >= blockCount || blockMap->blocks[slot] < 0 || __atomic_load_n(&blockMap->referenceCount, __ATOMIC_RELAXED) > 1 || getBlockReferenceCount(blockMap->blocks[slot]) > 1) count++;
+        }
+        slot++;
+    }
+    return count;
+}
+
+int makeBlockWritable(VfsBlockMap *blockMap, int slot, int preserveContent) {
+    int blockIndex = blockMap->blocks[slot];
+    if (blockIndex >= 0 && claimBlockForWrite(blockIndex)) return blockIndex;
+    int copyIndex = allocateFreeBlock();
+    if (copyIndex < 0) return -2;
+    if (preserveContent && blockIndex < 0) {
+        zeroDiskBlockRange(copyIndex, 0, VFS_BLOCK_SIZE);
+    } else if (preserveContent) {
+        unsigned char buffer[VFS_BLOCK_SIZE];
+        readDiskBlockRange(blockIndex, 0, buffer, VFS_BLOCK_SIZE);
+        writeDiskBlockRange(copyIndex, 0, buffer, VFS_BLOCK_SIZE);
+    }
+    if (blockIndex >= 0) releaseDiskBlock(blockIndex);
+    blockMap->blocks[slot] = copyIndex;
+    return copyIndex;
+}
+
+void loadCompressedExtent(const VfsBlockMap *blockMap, int extent, unsigned char *rawOutput) {
+    unsigned char compressed[COMPRESSION_EXTENT_SIZE];
+    int compressedLength = blockMap->extentCompressedLengths[extent];
+    int firstSlot = extent * COMPRESSION_EXTENT_BLOCKS;
+    int rawLength = getExtentSlotCount(blockMap, extent) * VFS_BLOCK_SIZE;
+    for (int i = 0; i * VFS_BLOCK_SIZE < compressedLength; ++i) {
+        readDiskBlockRange(blockMap->blocks[firstSlot + i], 0, compressed + i * VFS_BLOCK_SIZE, VFS_BLOCK_SIZE);
+    }
+    if (decompressExtentData(compressed, compressedLength, rawOutput, rawLength) != rawLength) exitWithError("Corrupt compressed extent");
+}
+
+void readCompressedExtentRange(const VfsBlockMap *blockMap, int extent, int extentOffset, unsigned char *destination, int length) {
+    DecompressedExtentEntry *entry = getDecompressedExtentEntry(blockMap, extent);
+    int rawLength = getExtentSlotCount(blockMap, extent) * VFS_BLOCK_SIZE;
+    pthread_mutex_lock(&decompressedExtentCacheLock);
+    if (entry->blockMap == blockMap && entry->extent == extent && entry->rawLength == rawLength) {
+        memcpy(destination, entry->data + extentOffset, length);
+        decompressedExtentCacheHitCount++;
+        pthread_mutex_unlock(&decompressedExtentCacheLock);
+        return;
+    }
+    long generation = decompressedExtentCacheGeneration;
+    pthread_mutex_unlock(&decompressedExtentCacheLock);
+    unsigned char raw[COMPRESSION_EXTENT_SIZE];
+    loadCompressedExtent(blockMap, extent, raw);
+    memcpy(destination, raw + extentOffset, length);
+    pthread_mutex_lock(&decompressedExtentCacheLock);
+    decompressedExtentCacheMissCount++;
+    if (generation == decompressedExtentCacheGeneration) {
+        entry->blockMap = blockMap;
+        entry->extent = extent;
+        entry->rawLength = rawLength;
+        memcpy(entry->data, raw, rawLength);
+    }
+    pthread_mutex_unlock(&decompressedExtentCacheLock);
+}
+
+int inflateFileExtent(VfsBlockMap *blockMap, int extent) {
+    int compressedLength = getCompressedExtentLength(blockMap, extent);
+    if (compressedLength == 0) return 0;
+    int slotCount = getExtentSlotCount(blockMap, extent);
+    if (!ensureFreeBlocks(slotCount)) return -2;
+    unsigned char raw[COMPRESSION_EXTENT_SIZE];
+    loadCompressedExtent(blockMap, extent, raw);
+    accountCompressedExtent(blockMap, extent, -1);
+    int firstSlot = extent * COMPRESSION_EXTENT_BLOCKS;
+    for (int i = 0; i * VFS_BLOCK_SIZE < compressedLength; ++i) {
+        releaseDiskBlock(blockMap->blocks[firstSlot + i]);
+    }
+    for (int i = 0; i < slotCount; ++i) {
+        int blockIndex = allocateFreeBlock();
+        writeDiskBlockRange(blockIndex, 0, raw + i * VFS_BLOCK_SIZE, VFS_BLOCK_SIZE);
+        blockMap->blocks[firstSlot + i] = blockIndex;
+    }
+    blockMap->extentCompressedLengths[extent] = 0;
+    return 0;
+}
+
+void compressFileExtent(VfsBlockMap *blockMap, int extent) {
+    int slotCount = getExtentSlotCount(blockMap, extent);
+    if (getCompressedExtentLength(blockMap, extent) > 0 || slotCount < 2) return;
+    int firstSlot = extent * COMPRESSION_EXTENT_BLOCKS;
+    for (int i = 0; i < slotCount; ++i) {
+        if (blockMap->blocks[firstSlot + i] < 0) return;
+    }
+    unsigned char raw[COMPRESSION_EXTENT_SIZE];
+    unsigned char compressed[COMPRESSION_EXTENT_SIZE];
+    for (int i = 0; i < slotCount; ++i) {
+        readDiskBlockRange(blockMap->blocks[firstSlot + i], 0, raw + i * VFS_BLOCK_SIZE, VFS_BLOCK_SIZE);
+    }
+    int compressedLength = compressExtentData(raw, slotCount * VFS_BLOCK_SIZE, compressed, (slotCount - 1) * VFS_BLOCK_SIZE);
+    if (compressedLength < 0) {
+        __atomic_add_fetch(&compressionBypassCount, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    int physicalBlocks = (compressedLength + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE;
+    int copiesNeeded = 0;
+    for (int i = 0; i < physicalBlocks; ++i) {
+        if (getBlockReferenceCount(blockMap->blocks[firstSlot + i]) > 1) copiesNeeded++;
+    }
+    if (!ensureFreeBlocks(copiesNeeded)) return;
+    for (int i = 0; i < physicalBlocks; ++i) {
+        if (makeBlockWritable(blockMap, firstSlot + i, 1) < 0) return;
+    }
+    memset(compressed + compressedLength, 0, physicalBlocks * VFS_BLOCK_SIZE - compressedLength);
+    for (int i = 0; i < physicalBlocks; ++i) {
+        writeDiskBlockRange(blockMap->blocks[firstSlot + i], 0, compressed + i * VFS_BLOCK_SIZE, VFS_BLOCK_SIZE);
+    }
+    for (int i = physicalBlocks; i < slotCount; ++i) {
+        releaseDiskBlock(blockMap->blocks[firstSlot + i]);
+        blockMap->blocks[firstSlot + i] = -1;
+    }
+    blockMap->extentCompressedLengths[extent] = compressedLength;
+    accountCompressedExtent(blockMap, extent, 1);
+}
+
+void compressFileBlockRange(VfsNode *fileNode, int firstSlot, int endSlot) {
+    if (!compressionEnabled || !fileNode->inode->blockMap || firstSlot >= endSlot) return;
+    for (int extent = firstSlot / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < endSlot; ++extent) {
+        compressFileExtent(fileNode->inode->blockMap, extent);
+    }
+}
+
+void releaseFileBlocksFrom(VfsNode *fileNode, int firstBlock) {
+    if (firstBlock >= getFileBlockCount(fileNode)) return;
+    VfsBlockMap *blockMap = prepareBlockMapForWrite(fileNode);
+    for (int extent = (firstBlock + COMPRESSION_EXTENT_BLOCKS - 1) / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < blockMap->blockCount; ++extent) {
+        if (getCompressedExtentLength(blockMap, extent) == 0) continue;
+        accountCompressedExtent(blockMap, extent, -1);
+        blockMap->extentCompressedLengths[extent] = 0;
+    }
+    for (int i = firstBlock; i < blockMap->blockCount; ++i) {
+        if (blockMap->blocks[i] >= 0) releaseDiskBlock(blockMap->blocks[i]);
+    }
+    blockMap->blockCount = firstBlock;
+}
+
+void releaseAllFileBlocks(VfsNode *fileNode) {
+    releaseBlockMap(fileNode->inode->blockMap);
+    fileNode->inode->blockMap = NULL;
+    setFileSize(fileNode, 0);
+}
+
+int growFileBlocks(VfsNode *fileNode, int requiredBlocks) {
+    int blockCount = getFileBlockCount(fileNode);
+    if (requiredBlocks <= blockCount) return 0;
+    int inflationSlots = countTailInflationSlots(fileNode);
+    if (!ensureFreeBlocks(inflationSlots)) return -2;
+    VfsBlockMap *blockMap = prepareBlockMapForWrite(fileNode);
+    if (inflationSlots > 0) {
+        int result = inflateFileExtent(blockMap, (blockCount - 1) / COMPRESSION_EXTENT_BLOCKS);
+        if (result != 0) return result;
+    }
+    ensureBlockMapCapacity(blockMap, requiredBlocks);
+    while (blockMap->blockCount < requiredBlocks) blockMap->blocks[blockMap->blockCount++] = -1;
+    return 0;
+}
+
+int truncateFileContent(VfsNode *fileNode, int newSize) {
+    if (!fileNode || fileNode->isDirectory || newSize < 0 || newSize > MAX_FILE_SIZE) return -1;
+    if (newSize == 0) {
+        releaseAllFileBlocks(fileNode);
+        touchVfsNode(fileNode, 1);
+        journalFileMap(fileNode, 0, 0);
+        return 0;
+    }
+    int requiredBlocks = (newSize + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE;
+    if (newSize > fileNode->inode->fileSize) {
+        int previousBlockCount = getFileBlockCount(fileNode);
+        int result = growFileBlocks(fileNode, requiredBlocks);
+        if (result != 0) return result;
+        compressFileBlockRange(fileNode, previousBlockCount, requiredBlocks);
+        deduplicateFileBlockRange(fileNode, previousBlockCount, requiredBlocks);
+        setFileSize(fileNode, newSize);
+        touchVfsNode(fileNode, 1);
+        journalFileMap(fileNode, previousBlockCount, requiredBlocks);
+        return 0;
+    } else {
+        int tailOffset = newSize % VFS_BLOCK_SIZE;
+        int tailExtent = (requiredBlocks - 1) / COMPRESSION_EXTENT_BLOCKS;
+        int splitsExtent = requiredBlocks % COMPRESSION_EXTENT_BLOCKS != 0 && requiredBlocks < getFileBlockCount(fileNode);
+        if ((tailOffset > 0 || splitsExtent) && !ensureFreeBlocks(countBlocksNeededForWrite(fileNode, requiredBlocks - 1, requiredBlocks))) return -2;
+        VfsBlockMap *blockMap = prepareBlockMapForWrite(fileNode);
+        if (tailOffset > 0 || splitsExtent) {
+            int result = inflateFileExtent(blockMap, tailExtent);
+            if (result != 0) return result;
+        }
+        releaseFileBlocksFrom(fileNode, requiredBlocks);
+        if (tailOffset > 0 && blockMap->blocks[requiredBlocks - 1] >= 0) {
+            int blockIndex = makeBlockWritable(blockMap, requiredBlocks - 1, 1);
+            if (blockIndex < 0) return blockIndex;
+            zeroDiskBlockRange(blockIndex, tailOffset, VFS_BLOCK_SIZE - tailOffset);
+        }
+        if (tailOffset > 0 || splitsExtent) {
+            compressFileBlockRange(fileNode, requiredBlocks - 1, requiredBlocks);
+            deduplicateFileBlockRange(fileNode, tailExtent * COMPRESSION_EXTENT_BLOCKS, requiredBlocks);
+        }
+    }
+    setFileSize(fileNode, newSize);
+    touchVfsNode(fileNode, 1);
+    journalFileMap(fileNode, requiredBlocks - 1, requiredBlocks);
+    return 0;
+}
+
+int writeFileRange(VfsNode *fileNode, int offset, const unsigned char *source, int length) {
+    if (!fileNode || fileNode->isDirectory || offset < 0 || length < 0 || length > MAX_FILE_SIZE - offset) return -1;
+    if (length == 0) return 0;
+    int endOffset = offset + length;
+    int firstSlot = offset / VFS_BLOCK_SIZE;
+    int endSlot = (endOffset + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE;
+    int previousBlockCount = getFileBlockCount(fileNode);
+    if (!ensureFreeBlocks(countBlocksNeededForRangeWrite(fileNode, offset, source, length))) return -2;
+    int result = growFileBlocks(fileNode, endSlot);
+    if (result != 0) return result;
+    VfsBlockMap *blockMap = prepareBlockMapForWrite(fileNode);
+    int position = offset;
+    while (position < endOffset) {
+        int slot = position / VFS_BLOCK_SIZE;
+        int blockOffset = position % VFS_BLOCK_SIZE;
+        int chunk = VFS_BLOCK_SIZE - blockOffset;
+        if (chunk > endOffset - position) chunk = endOffset - position;
+        result = inflateFileExtent(blockMap, slot / COMPRESSION_EXTENT_BLOCKS);
+        if (result != 0) return result;
+        if (isZeroBlockChunk(source + (position - offset), chunk)) {
+            if (blockMap->blocks[slot] >= 0) releaseDiskBlock(blockMap->blocks[slot]);
+            blockMap->blocks[slot] = -1;
+            position += chunk;
+            continue;
+        }
+        int blockIndex = makeBlockWritable(blockMap, slot, chunk < VFS_BLOCK_SIZE);
+        if (blockIndex < 0) return blockIndex;
+        writeDiskBlockRange(blockIndex, blockOffset, source + (position - offset), chunk);
+        position += chunk;
+    }
+    if (endOffset > fileNode->inode->fileSize) setFileSize(fileNode, endOffset);
+    int touchedFirstSlot = previousBlockCount < firstSlot ? previousBlockCount : firstSlot;
+    compressFileBlockRange(fileNode, touchedFirstSlot, endSlot);
+    deduplicateFileBlockRange(fileNode, touchedFirstSlot / COMPRESSION_EXTENT_BLOCKS * COMPRESSION_EXTENT_BLOCKS, endSlot);
+    touchVfsNode(fileNode, 1);
+    journalFileMap(fileNode, touchedFirstSlot, endSlot);
+    return length;
+}
+
+int readFileRange(VfsNode *fileNode, int offset, unsigned char *destination, int length) {
+    if (!fileNode || fileNode->isDirectory || offset < 0 || length < 0) return -1;
+    refreshAccessTime(fileNode);
+    if (offset >= fileNode->inode->fileSize) return 0;
+    if (length > fileNode->inode->fileSize - offset) length = fileNode->inode->fileSize - offset;
+    VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    if (!blockMap) return 0;
+    int position = offset;
+    while (position < offset + length) {
+        int slot = position / VFS_BLOCK_SIZE;
+        int extent = slot / COMPRESSION_EXTENT_BLOCKS;
+        int chunk;
+        if (getCompressedExtentLength(blockMap, extent) > 0) {
+            int extentStart = extent * COMPRESSION_EXTENT_SIZE;
+            chunk = extentStart + getExtentSlotCount(blockMap, extent) * VFS_BLOCK_SIZE - position;
+            if (chunk > offset + length - position) chunk = offset + length - position;
+            readCompressedExtentRange(blockMap, extent, position - extentStart, destination + (position - offset), chunk);
+        } else {
+            int blockOffset = position % VFS_BLOCK_SIZE;
+            chunk = VFS_BLOCK_SIZE - blockOffset;
+            if (chunk > offset + length - position) chunk = offset + length - position;
+            if (blockMap->blocks[slot] < 0) {
+                memset(destination + (position - offset), 0, chunk);
             } else {
-                printf("Error: write failed\n");
-            }
-        } else if (strcmp(command, "read") == 0) {
-            if (!arguments || strlen(arguments) == 0) {
-                printf("Usage: read <filename>\n");
-                continue;
+                readDiskBlockRange(blockMap->blocks[slot], blockOffset, destination + (position - offset), chunk);
             }
-            VfsNode *fileNode = findChildNode(currentDirectory, arguments);
-            if (!fileNode) {
-                printf("Error: file '%s' not found\n", arguments);
-                continue;
+        }
+        position += chunk;
+    }
+    return length;
+}
+
+int appendFileContent(VfsNode *fileNode, const unsigned char *source, int length) {
+    if (!fileNode || fileNode->isDirectory) return -1;
+    return writeFileRange(fileNode, fileNode->inode->fileSize, source, length);
+}
+
+int writeFileContent(VfsNode *fileNode, const unsigned char *content, int size) {
+    if (!fileNode || fileNode->isDirectory) return -1;
+    if (size < 0) size = 0;
+    int requiredBlocks = (size + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE;
+    if (fileNode->inode->blockMap && __atomic_load_n(&fileNode->inode->blockMap->referenceCount, __ATOMIC_RELAXED) > 1) {
+        if (!ensureFreeBlocks(requiredBlocks)) return -2;
+        truncateFileContent(fileNode, 0);
+    }
+    if (!ensureFreeBlocks(requiredBlocks - getFileBlockCount(fileNode))) return -2;
+    if (size < fileNode->inode->fileSize) {
+        int result = truncateFileContent(fileNode, size);
+        if (result != 0) return result;
+    }
+    int result = writeFileRange(fileNode, 0, content, size);
+    return result < 0 ? result : 0;
+}
+
+VfsFileHandle* openFileHandle(VfsNode *fileNode, int openFlags) {
+    if (!fileNode || fileNode->isDirectory) return NULL;
+    if ((openFlags & VFS_OPEN_TRUNCATE) && truncateFileContent(fileNode, 0) != 0) return NULL;
+    VfsFileHandle *handle = malloc(sizeof(VfsFileHandle));
+    if (!handle) exitWithError("Out of memory");
+    handle->fileNode = fileNode;
+    handle->position = 0;
+    handle->openFlags = openFlags;
+    handle->sequentialEnd = 0;
+    handle->readaheadWindow = 0;
+    handle->readaheadEndSlot = 0;
+    return handle;
+}
+
+void prefetchFileBlocks(const VfsNode *fileNode, int firstSlot, int endSlot) {
+    int blockCount = getFileBlockCount(fileNode);
+    if (endSlot > blockCount) endSlot = blockCount;
+    if (firstSlot >= endSlot) return;
+    prefetchDiskBlocks(fileNode->inode->blockMap->blocks + firstSlot, endSlot - firstSlot);
+}
+
+void updateFileReadahead(VfsFileHandle *handle, int length) {
+    if (!blockCacheFrames) return;
+    if (handle->position != handle->sequentialEnd) {
+        handle->readaheadWindow = 0;
+        handle->readaheadEndSlot = 0;
+        return;
+    }
+    handle->readaheadWindow = handle->readaheadWindow > 0 ? handle->readaheadWindow * 2 : BLOCK_CACHE_READAHEAD_MIN_BLOCKS;
+    if (handle->readaheadWindow > BLOCK_CACHE_READAHEAD_MAX_BLOCKS) handle->readaheadWindow = BLOCK_CACHE_READAHEAD_MAX_BLOCKS;
+    int firstSlot = handle->position / VFS_BLOCK_SIZE;
+    int targetEndSlot = (handle->position + length + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE + handle->readaheadWindow;
+    if (handle->readaheadEndSlot < firstSlot) handle->readaheadEndSlot = firstSlot;
+    if (targetEndSlot <= handle->readaheadEndSlot) return;
+    prefetchFileBlocks(handle->fileNode, handle->readaheadEndSlot, targetEndSlot);
+    handle->readaheadEndSlot = targetEndSlot;
+}
+
+int readFromFileHandle(VfsFileHandle *handle, unsigned char *destination, int length) {
+    if (!handle || !(handle->openFlags & VFS_OPEN_READ) || length < 0) return -1;
+    if (length > MAX_FILE_SIZE - handle->position) length = MAX_FILE_SIZE - handle->position;
+    updateFileReadahead(handle, length);
+    int bytesRead = readFileRange(handle->fileNode, handle->position, destination, length);
+    if (bytesRead > 0) handle->position += bytesRead;
+    handle->sequentialEnd = handle->position;
+    return bytesRead;
+}
+
+int writeToFileHandle(VfsFileHandle *handle, const unsigned char *source, int length) {
+    if (!handle || !(handle->openFlags & (VFS_OPEN_WRITE | VFS_OPEN_APPEND))) return -1;
+    if (handle->openFlags & VFS_OPEN_APPEND) handle->position = handle->fileNode->inode->fileSize;
+    int bytesWritten = writeFileRange(handle->fileNode, handle->position, source, length);
+    if (bytesWritten > 0) handle->position += bytesWritten;
+    return bytesWritten;
+}
+
+void closeFileHandle(VfsFileHandle *handle) {
+    free(handle);
+}
+
+int readFileContent(VfsNode *fileNode) {
+    VfsFileHandle *handle = openFileHandle(fileNode, VFS_OPEN_READ);
+    if (!handle) return -1;
+    unsigned char buffer[COMPRESSION_EXTENT_SIZE];
+    int bytesRead;
+    while ((bytesRead = readFromFileHandle(handle, buffer, sizeof(buffer))) > 0) {
+        fwrite(buffer, 1, bytesRead, stdout);
+    }
+    closeFileHandle(handle);
+    return 0;
+}
+
+int deleteFileNode(VfsNode *fileNode) {
+    if (!fileNode || fileNode->isDirectory) return -1;
+    int nodeId = fileNode->nodeId;
+    if (fileNode->inode->linkCount == 1) {
+        releaseAllFileBlocks(fileNode);
+    } else {
+        touchVfsNode(fileNode, 0);
+    }
+    if (fileNode->parent) detachChildNode(fileNode->parent, fileNode);
+    freeVfsNode(fileNode);
+    journalRemoveNode(nodeId);
+    return 0;
+}
+
+int removeDirectoryNode(VfsNode *directoryNode) {
+    if (!directoryNode || !directoryNode->isDirectory) return -1;
+    if (directoryNode->firstChild != NULL) return -2;
+    int nodeId = directoryNode->nodeId;
+    if (directoryNode->parent) detachChildNode(directoryNode->parent, directoryNode);
+    freeVfsNode(directoryNode);
+    journalRemoveNode(nodeId);
+    return 0;
+}
+
+VfsNode* cloneVfsNode(const VfsNode *sourceNode, const char *cloneName) {
+    VfsNode *cloneNode = createVfsNode(cloneName, sourceNode->isDirectory, NULL);
+    if (sourceNode->inode->blockMap) {
+        __atomic_add_fetch(&sourceNode->inode->blockMap->referenceCount, 1, __ATOMIC_RELAXED);
+        cloneNode->inode->blockMap = sourceNode->inode->blockMap;
+    }
+    cloneNode->inode->fileSize = sourceNode->inode->fileSize;
+    cloneNode->inode->mode = sourceNode->inode->mode;
+    cloneNode->inode->attributeLength = sourceNode->inode->attributeLength;
+    cloneNode->inode->attributeBlock = sourceNode->inode->attributeBlock;
+    if (sourceNode->inode->attributeBlock >= 0) {
+        retainDiskBlock(sourceNode->inode->attributeBlock);
+    } else {
+        memcpy(cloneNode->inode->inlineAttributes, sourceNode->inode->inlineAttributes, sourceNode->inode->attributeLength);
+    }
+    return cloneNode;
+}
+
+VfsNode* cloneVfsSubtree(VfsNode *sourceNode, const char *cloneName) {
+    VfsNode *cloneRoot = cloneVfsNode(sourceNode, cloneName);
+    VfsTraversalStack stack = {0};
+    pushChildFrames(&stack, sourceNode, cloneRoot);
+    while (stack.count > 0) {
+        VfsTraversalFrame frame = stack.frames[--stack.count];
+        VfsNode *cloneNode = cloneVfsNode(frame.node, frame.node->name);
+        attachChildNode(frame.context, cloneNode);
+        pushChildFrames(&stack, frame.node, cloneNode);
+    }
+    free(stack.frames);
+    return cloneRoot;
+}
+
+int freeVfsTree(VfsNode *subtreeRoot) {
+    if (!subtreeRoot) return 0;
+    int freedNodeCount = 0;
+    VfsTraversalStack stack = {0};
+    pushTraversalFrame(&stack, subtreeRoot, NULL);
+    while (stack.count > 0) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        pushChildFrames(&stack, node, NULL);
+        freeVfsNode(node);
+        freedNodeCount++;
+    }
+    free(stack.frames);
+    return freedNodeCount;
+}
+
+int removeVfsSubtree(VfsNode *subtreeRoot) {
+    if (!subtreeRoot || subtreeRoot == rootDirectory) return -1;
+    int nodeId = subtreeRoot->nodeId;
+    if (subtreeRoot->parent) detachChildNode(subtreeRoot->parent, subtreeRoot);
+    int freedNodeCount = freeVfsTree(subtreeRoot);
+    journalRemoveNode(nodeId);
+    return freedNodeCount;
+}
+
+VfsNode* createChildNode(VfsNode *parent, const char *name, int isDirectory) {
+    VfsNode *node = createVfsNode(name, isDirectory, parent);
+    if (!node) return NULL;
+    attachChildNode(parent, node);
+    journalCreateNode(node);
+    return node;
+}
+
+int isAncestorOrSelf(const VfsNode *ancestor, const VfsNode *node) {
+    for (; node; node = node->parent) {
+        if (node == ancestor) return 1;
+    }
+    return 0;
+}
+
+int moveVfsNode(VfsNode *node, VfsNode *newParent, const char *newName) {
+    if (!node || !node->parent || !newParent || !newParent->isDirectory) return -1;
+    if (strlen(newName) == 0 || strlen(newName) > MAX_NAME_LEN || strchr(newName, '/')) return -1;
+    if (node->isDirectory && isAncestorOrSelf(node, newParent)) return -1;
+    VfsNode *existingNode = findChildNode(newParent, newName);
+    if (existingNode) return existingNode == node ? 0 : -1;
+    detachChildNode(node->parent, node);
+    setVfsNodeName(node, newName);
+    attachChildNode(newParent, node);
+    touchVfsNode(node, 0);
+    pthread_mutex_lock(&pathCacheLock);
+    invalidatePathCaches();
+    pthread_mutex_unlock(&pathCacheLock);
+    journalMoveNode(node);
+    return 0;
+}
+
+VfsNode* linkVfsNode(VfsNode *fileNode, VfsNode *parent, const char *name) {
+    if (!fileNode || fileNode->isDirectory || !parent || !parent->isDirectory) return NULL;
+    if (strlen(name) == 0 || strchr(name, '/') || findChildNode(parent, name)) return NULL;
+    VfsNode *linkNode = createLinkedVfsNode(name, 0, parent, fileNode);
+    if (!linkNode) return NULL;
+    attachChildNode(parent, linkNode);
+    touchVfsNode(fileNode, 0);
+    journalLinkNode(linkNode, fileNode);
+    return linkNode;
+}
+
+int countFileBlockRuns(const VfsBlockMap *blockMap, int *physicalBlockCountOut) {
+    int runCount = 0;
+    int physicalBlockCount = 0;
+    int previousBlock = -2;
+    for (int slot = 0; slot < blockMap->blockCount; ++slot) {
+        int blockIndex = blockMap->blocks[slot];
+        if (blockIndex < 0) continue;
+        if (blockIndex != previousBlock + 1) runCount++;
+        previousBlock = blockIndex;
+        physicalBlockCount++;
+    }
+    *physicalBlockCountOut = physicalBlockCount;
+    return runCount;
+}
+
+double measureFragmentation(int *fileCountOut, int *fragmentedFileCountOut) {
+    long breakCount = 0;
+    long transitionCount = 0;
+    int fileCount = 0;
+    int fragmentedFileCount = 0;
+    VfsTraversalStack stack = {0};
+    lockNodeShared(rootDirectory);
+    pushChildFrames(&stack, rootDirectory, NULL);
+    unlockNode(rootDirectory);
+    while (stack.count > 0) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        lockNodeShared(node);
+        if (node->isDirectory) {
+            pushChildFrames(&stack, node, NULL);
+        } else if (node->inode->blockMap) {
+            int physicalBlockCount;
+            int runCount = countFileBlockRuns(node->inode->blockMap, &physicalBlockCount);
+            if (physicalBlockCount > 0) {
+                fileCount++;
+                if (runCount > 1) fragmentedFileCount++;
+                breakCount += runCount - 1;
+                transitionCount += physicalBlockCount - 1;
             }
-            if (fileNode->isDirectory) {
-                printf("Error: '%s' is a directory\n", arguments);
-                continue;
+        }
+        unlockNode(node);
+    }
+    free(stack.frames);
+    if (fileCountOut) *fileCountOut = fileCount;
+    if (fragmentedFileCountOut) *fragmentedFileCountOut = fragmentedFileCount;
+    return transitionCount > 0 ? (double)breakCount / (double)transitionCount * 100.0 : 0.0;
+}
+
+void markFreeBlocks(unsigned char *blockIsFree) {
+    for (int i = 0; i < TOTAL_BLOCKS; ++i) blockIsFree[i] = getBlockReferenceCount(i) == 0;
+}
+
+int findFreeBlockRun(const unsigned char *blockIsFree, int length) {
+    int runStart = 0;
+    for (int i = 0; i < TOTAL_BLOCKS; ++i) {
+        if (!blockIsFree[i]) {
+            runStart = i + 1;
+        } else if (i - runStart + 1 == length) {
+            return runStart;
+        }
+    }
+    return -1;
+}
+
+int relocateFileBlocks(VfsNode *fileNode, unsigned char *blockIsFree) {
+    VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    if (!blockMap) return 0;
+    if (blockMap->referenceCount > 1) return -1;
+    int physicalBlockCount;
+    if (countFileBlockRuns(blockMap, &physicalBlockCount) <= 1) return 0;
+    int *slots = malloc(sizeof(int) * physicalBlockCount);
+    int *oldBlocks = malloc(sizeof(int) * physicalBlockCount);
+    if (!slots || !oldBlocks) exitWithError("Out of memory");
+    int count = 0;
+    for (int slot = 0; slot < blockMap->blockCount; ++slot) {
+        int blockIndex = blockMap->blocks[slot];
+        if (blockIndex < 0) continue;
+        if (getBlockReferenceCount(blockIndex) > 1) {
+            free(slots);
+            free(oldBlocks);
+            return -1;
+        }
+        slots[count] = slot;
+        oldBlocks[count++] = blockIndex;
+    }
+    int firstBlock = findFreeBlockRun(blockIsFree, count);
+    if (firstBlock < 0) {
+        free(slots);
+        free(oldBlocks);
+        return -2;
+    }
+    unsigned char content[VFS_BLOCK_SIZE];
+    for (int i = 0; i < count; ++i) {
+        if (i % BLOCK_CACHE_READAHEAD_MAX_BLOCKS == 0) prefetchDiskBlocks(oldBlocks + i, count - i < BLOCK_CACHE_READAHEAD_MAX_BLOCKS ? count - i : BLOCK_CACHE_READAHEAD_MAX_BLOCKS);
+        int newBlock = firstBlock + i;
+        readDiskBlockRange(oldBlocks[i], 0, content, VFS_BLOCK_SIZE);
+        writeDiskBlockRange(newBlock, 0, content, VFS_BLOCK_SIZE);
+        blockIsFree[newBlock] = 0;
+        __atomic_add_fetch(&usedBlockCount, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&blockReferenceCounts[newBlock], 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&blockReferenceTotal, 1, __ATOMIC_RELAXED);
+        moveDedupIndexEntry(oldBlocks[i], newBlock);
+        blockMap->blocks[slots[i]] = newBlock;
+    }
+    for (int i = 0; i < count; ++i) releaseDiskBlock(oldBlocks[i]);
+    journalFileMap(fileNode, 0, blockMap->blockCount);
+    free(slots);
+    free(oldBlocks);
+    return count;
+}
+
+int defragmentVfs(int blockBudget, int *relocatedFileCountOut, int *skippedFileCountOut) {
+    commitJournal();
+    unsigned char *blockIsFree = malloc(TOTAL_BLOCKS);
+    if (!blockIsFree) exitWithError("Out of memory");
+    markFreeBlocks(blockIsFree);
+    int relocatedBlockCount = 0;
+    int relocatedFileCount = 0;
+    int skippedFileCount = 0;
+    VfsTraversalStack stack = {0};
+    pushChildFrames(&stack, rootDirectory, NULL);
+    while (stack.count > 0 && (blockBudget <= 0 || relocatedBlockCount < blockBudget)) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        if (node->isDirectory) {
+            pushChildFrames(&stack, node, NULL);
+            continue;
+        }
+        int result = relocateFileBlocks(node, blockIsFree);
+        if (result == -2) {
+            commitJournal();
+            markFreeBlocks(blockIsFree);
+            result = relocateFileBlocks(node, blockIsFree);
+        }
+        if (result > 0) {
+            relocatedFileCount++;
+            relocatedBlockCount += result;
+        } else if (result < 0) {
+            skippedFileCount++;
+        }
+    }
+    free(stack.frames);
+    free(blockIsFree);
+    commitJournal();
+    rebuildFreeBlockList();
+    if (relocatedFileCountOut) *relocatedFileCountOut = relocatedFileCount;
+    if (skippedFileCountOut) *skippedFileCountOut = skippedFileCount;
+    return relocatedBlockCount;
+}
+
+void *runBackgroundDefragThread(void *argument) {
+    (void)argument;
+    pthread_mutex_lock(&defragBackgroundLock);
+    while (!defragBackgroundStopRequested) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)DEFRAG_BACKGROUND_INTERVAL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&defragBackgroundCondition, &defragBackgroundLock, &deadline);
+        if (defragBackgroundStopRequested) break;
+        pthread_mutex_unlock(&defragBackgroundLock);
+        pthread_rwlock_wrlock(&vfsTreeLock);
+        int relocatedBlockCount = defragmentVfs(DEFRAG_STEP_BLOCK_BUDGET, NULL, NULL);
+        runRequestedCheckpoint();
+        pthread_rwlock_unlock(&vfsTreeLock);
+        pthread_mutex_lock(&defragBackgroundLock);
+        defragBackgroundRelocatedBlockTotal += relocatedBlockCount;
+    }
+    releaseThreadPendingFrees();
+    defragBackgroundRunning = 0;
+    pthread_cond_broadcast(&defragBackgroundCondition);
+    pthread_mutex_unlock(&defragBackgroundLock);
+    return NULL;
+}
+
+void startBackgroundDefrag() {
+    pthread_mutex_lock(&defragBackgroundLock);
+    defragBackgroundStopRequested = 0;
+    if (!defragBackgroundRunning) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, runBackgroundDefragThread, NULL) != 0) exitWithError("Cannot start defrag thread");
+        pthread_detach(thread);
+        defragBackgroundRunning = 1;
+    }
+    pthread_mutex_unlock(&defragBackgroundLock);
+}
+
+void stopBackgroundDefrag(int waitForExit) {
+    pthread_mutex_lock(&defragBackgroundLock);
+    defragBackgroundStopRequested = 1;
+    pthread_cond_broadcast(&defragBackgroundCondition);
+    while (waitForExit && defragBackgroundRunning) pthread_cond_wait(&defragBackgroundCondition, &defragBackgroundLock);
+    pthread_mutex_unlock(&defragBackgroundLock);
+}
+
+int registerShellSession(VfsNode **directorySlot) {
+    pthread_mutex_lock(&sessionRegistryLock);
+    int sessionSlot = 0;
+    while (sessionSlot < MAX_SHELL_SESSIONS && sessionDirectorySlots[sessionSlot]) sessionSlot++;
+    if (sessionSlot < MAX_SHELL_SESSIONS) sessionDirectorySlots[sessionSlot] = directorySlot;
+    pthread_mutex_unlock(&sessionRegistryLock);
+    return sessionSlot < MAX_SHELL_SESSIONS ? sessionSlot : -1;
+}
+
+void unregisterShellSession(int sessionSlot) {
+    if (sessionSlot < 0) return;
+    pthread_mutex_lock(&sessionRegistryLock);
+    sessionDirectorySlots[sessionSlot] = NULL;
+    pthread_mutex_unlock(&sessionRegistryLock);
+}
+
+int getActiveSessionCount() {
+    int activeCount = 0;
+    pthread_mutex_lock(&sessionRegistryLock);
+    for (int i = 0; i < MAX_SHELL_SESSIONS; ++i) {
+        if (sessionDirectorySlots[i]) activeCount++;
+    }
+    pthread_mutex_unlock(&sessionRegistryLock);
+    return activeCount;
+}
+
+int isDirectoryInUse(const VfsNode *directoryNode) {
+    int inUse = 0;
+    pthread_mutex_lock(&sessionRegistryLock);
+    for (int i = 0; i < MAX_SHELL_SESSIONS && !inUse; ++i) {
+        if (sessionDirectorySlots[i] && isAncestorOrSelf(directoryNode, *sessionDirectorySlots[i])) inUse = 1;
+    }
+    pthread_mutex_unlock(&sessionRegistryLock);
+    return inUse;
+}
+
+int handleMakeDirectory(const char *name) {
+    if (!name || strlen(name) == 0) { printf("Usage: mkdir <name>\n"); return -1; }
+    if (strlen(name) > MAX_NAME_LEN) { printf("Error: name too long\n"); return -1; }
+    if (strchr(name, '/')) { printf("Error: name cannot contain '/'\n"); return -1; }
+    lockNodeExclusive(currentDirectory);
+    if (findChildNode(currentDirectory, name)) {
+        unlockNode(currentDirectory);
+        printf("Error: directory '%s' already exists\n", name);
+        return -1;
+    }
+    createChildNode(currentDirectory, name, 1);
+    unlockNode(currentDirectory);
+    printf("Directory '%s' created\n", name);
+    return 0;
+}
+
+int handleCreateFile(const char *name) {
+    if (!name || strlen(name) == 0) { printf("Usage: create <filename>\n"); return -1; }
+    if (strlen(name) > MAX_NAME_LEN) { printf("Error: name too long\n"); return -1; }
+    if (strchr(name, '/')) { printf("Error: name cannot contain '/'\n"); return -1; }
+    lockNodeExclusive(currentDirectory);
+    if (findChildNode(currentDirectory, name)) {
+        unlockNode(currentDirectory);
+        printf("Error: file '%s' already exists\n", name);
+        return -1;
+    }
+    createChildNode(currentDirectory, name, 0);
+    unlockNode(currentDirectory);
+    printf("File '%s' created\n", name);
+    return 0;
+}
+
+void buildAbsolutePath(VfsNode *node, char *outputBuffer, int bufferSize) {
+    if (!node || node->isDirectory) {
+        snprintf(outputBuffer, bufferSize, "%s", getDirectoryPath(node ? node : rootDirectory));
+        return;
+    }
+    const char *parentPath = getDirectoryPath(node->parent);
+    snprintf(outputBuffer, bufferSize, "%s%s%s", parentPath, parentPath[1] ? "/" : "", node->name);
+}
+
+int changeDirectory(const char *path) {
+    if (!path || strlen(path) == 0) { printf("Usage: cd <path>\n"); return -1; }
+    VfsNode *targetNode = resolveVfsPath(path);
+    if (!targetNode) {
+        printf("Error: path '%s' not found\n", path);
+        return -1;
+    }
+    if (!targetNode->isDirectory) {
+        printf("Error: '%s' is not a directory\n", path);
+        return -1;
+    }
+    currentDirectory = targetNode;
+    printf("Moved to %s\n", getDirectoryPath(currentDirectory));
+    return 0;
+}
+
+int getAllocatedBlockCount(const VfsNode *fileNode) {
+    const VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    int allocatedCount = 0;
+    for (int i = 0; blockMap && i < blockMap->blockCount; ++i) {
+        if (blockMap->blocks[i] >= 0) allocatedCount++;
+    }
+    return allocatedCount;
+}
+
+void flushListingBuffer(ListingBuffer *buffer) {
+    fwrite(buffer->data, 1, buffer->length, stdout);
+    buffer->length = 0;
+}
+
+void appendListingEntry(ListingBuffer *buffer, VfsNode *node, int longFormat) {
+    if (buffer->length + MAX_NAME_LEN + 64 > LISTING_BUFFER_SIZE) flushListingBuffer(buffer);
+    char *line = buffer->data + buffer->length;
+    int room = LISTING_BUFFER_SIZE - buffer->length;
+    if (!longFormat) {
+        buffer->length += snprintf(line, room, "%s%s\n", node->name, node->isDirectory ? "/" : "");
+    } else if (node->isDirectory) {
+        buffer->length += snprintf(line, room, "d %3s %12ld %12s %8s  %s/\n", "-", getSubtreeSize(node), "-", "-", node->name);
+    } else {
+        lockNodeShared(node);
+        int fileSize = node->inode->fileSize;
+        int linkCount = node->inode->linkCount;
+        int allocatedBlocks = getAllocatedBlockCount(node);
+        unlockNode(node);
+        buffer->length += snprintf(line, room, "- %3d %12d %12ld %8d  %s\n", linkCount, fileSize, (long)allocatedBlocks * VFS_BLOCK_SIZE, allocatedBlocks, node->name);
+    }
+}
+
+int compareListingEntries(const void *left, const void *right) {
+    const ListingEntry *leftEntry = left;
+    const ListingEntry *rightEntry = right;
+    if (leftEntry->size != rightEntry->size) return leftEntry->size > rightEntry->size ? -1 : 1;
+    return strcmp(leftEntry->node->name, rightEntry->node->name);
+}
+
+void swapListingEntries(ListingEntry *entries, int first, int second) {
+    ListingEntry saved = entries[first];
+    entries[first] = entries[second];
+    entries[second] = saved;
+}
+
+void pushListingHeap(ListingEntry *heap, int *count, int capacity, ListingEntry entry) {
+    if (*count == capacity) {
+        if (compareListingEntries(&entry, &heap[0]) >= 0) return;
+        heap[0] = entry;
+        int index = 0;
+        while (1) {
+            int worst = index;
+            int left = 2 * index + 1;
+            int right = left + 1;
+            if (left < *count && compareListingEntries(&heap[left], &heap[worst]) > 0) worst = left;
+            if (right < *count && compareListingEntries(&heap[right], &heap[worst]) > 0) worst = right;
+            if (worst == index) return;
+            swapListingEntries(heap, index, worst);
+            index = worst;
+        }
+    }
+    int index = (*count)++;
+    heap[index] = entry;
+    while (index > 0 && compareListingEntries(&heap[index], &heap[(index - 1) / 2]) > 0) {
+        swapListingEntries(heap, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+}
+
+long getListingSize(VfsNode *node) {
+    if (node->isDirectory) return getSubtreeSize(node);
+    lockNodeShared(node);
+    long size = node->inode->fileSize;
+    unlockNode(node);
+    return size;
+}
+
+int handleListDirectory(const char *arguments) {
+    const char *usage = "Usage: ls [-l] [-S] [--limit <n>] [--after <name>] [path]";
+    int longFormat = 0;
+    int sortBySize = 0;
+    int limit = 0;
+    char afterName[MAX_NAME_LEN + 1] = "";
+    char path[MAX_CMD_LEN] = "";
+    char token[MAX_CMD_LEN];
+    const char *cursor = arguments ? arguments : "";
+    int consumed;
+    while (sscanf(cursor, "%2047s%n", token, &consumed) == 1) {
+        cursor += consumed;
+        if (strcmp(token, "--limit") == 0) {
+            if (sscanf(cursor, "%d%n", &limit, &consumed) != 1 || limit <= 0) { printf("%s\n", usage); return -1; }
+            cursor += consumed;
+        } else if (strcmp(token, "--after") == 0) {
+            if (sscanf(cursor, "%50s%n", afterName, &consumed) != 1) { printf("%s\n", usage); return -1; }
+            cursor += consumed;
+        } else if (token[0] == '-' && token[1] && strspn(token + 1, "lS") == strlen(token + 1)) {
+            if (strchr(token, 'l')) longFormat = 1;
+            if (strchr(token, 'S')) sortBySize = 1;
+        } else if (token[0] == '-' || path[0]) {
+            printf("%s\n", usage);
+            return -1;
+        } else {
+            strcpy(path, token);
+        }
+    }
+    if (sortBySize && afterName[0]) { printf("Error: --after requires name order\n"); return -1; }
+    VfsNode *directoryNode = path[0] ? resolveVfsPath(path) : currentDirectory;
+    if (!directoryNode) { printf("Error: '%s' not found\n", path); return -1; }
+    ListingBuffer *buffer = malloc(sizeof(ListingBuffer));
+    if (!buffer) exitWithError("Out of memory");
+    buffer->length = 0;
+    if (!directoryNode->isDirectory) {
+        appendListingEntry(buffer, directoryNode, longFormat);
+        flushListingBuffer(buffer);
+        free(buffer);
+        return 0;
+    }
+    lockNodeShared(directoryNode);
+    int childCount = directoryNode->childCount;
+    if (childCount == 0) {
+        unlockNode(directoryNode);
+        free(buffer);
+        printf("(empty)\n");
+        return 0;
+    }
+    if (longFormat) buffer->length += snprintf(buffer->data, LISTING_BUFFER_SIZE, "total %d\n", childCount);
+    if (sortBySize) {
+        int capacity = limit > 0 && limit < childCount ? limit : childCount;
+        ListingEntry *heap = malloc(sizeof(ListingEntry) * capacity);
+        if (!heap) exitWithError("Out of memory");
+        int heapCount = 0;
+        VfsNode *head = directoryNode->firstChild;
+        VfsNode *child = head;
+        do {
+            ListingEntry entry = {child, getListingSize(child)};
+            pushListingHeap(heap, &heapCount, capacity, entry);
+            child = child->nextSibling;
+        } while (child != head);
+        qsort(heap, heapCount, sizeof(ListingEntry), compareListingEntries);
+        for (int i = 0; i < heapCount; ++i) appendListingEntry(buffer, heap[i].node, longFormat);
+        flushListingBuffer(buffer);
+        if (heapCount < childCount) printf("(showing %d of %d entries)\n", heapCount, childCount);
+        free(heap);
+    } else {
+        VfsNode *stack[NAME_INDEX_MAX_HEIGHT];
+        int depth = seekNameIndex(directoryNode, afterName[0] ? afterName : NULL, stack);
+        int listedCount = 0;
+        VfsNode *entry;
+        while ((limit == 0 || listedCount < limit) && (entry = nextNameIndexEntry(stack, &depth))) {
+            appendListingEntry(buffer, entry, longFormat);
+            listedCount++;
+            snprintf(afterName, sizeof(afterName), "%s", entry->name);
+        }
+        flushListingBuffer(buffer);
+        if (listedCount == 0) printf("(no entries after '%s')\n", afterName);
+        if (limit > 0 && depth > 0) printf("(more entries: ls --limit %d --after %s)\n", limit, afterName);
+    }
+    unlockNode(directoryNode);
+    free(buffer);
+    return 0;
+}
+
+void handleDiskUsage() {
+    pthread_mutex_lock(&journalLock);
+    int usedBlocks = __atomic_load_n(&usedBlockCount, __ATOMIC_RELAXED);
+    int freeBlocks = TOTAL_BLOCKS - usedBlocks;
+    double usedPercent = (double)usedBlocks / (double)TOTAL_BLOCKS * 100.0;
+    printf("Total Blocks: %d\nUsed Blocks: %d\nFree Blocks: %d\nDisk Usage: %.2f%%\n", TOTAL_BLOCKS, usedBlocks, freeBlocks, usedPercent);
+    pthread_mutex_lock(&pendingFreeLock);
+    int liveBlockCount = usedBlocks - pendingFreeBlockCount;
+    pthread_mutex_unlock(&pendingFreeLock);
+    printf("File Data: %ld bytes apparent, %ld bytes allocated\n", getSubtreeSize(rootDirectory), (long)liveBlockCount * VFS_BLOCK_SIZE);
+    long referenceTotal = __atomic_load_n(&blockReferenceTotal, __ATOMIC_RELAXED);
+    double dedupRatio = liveBlockCount > 0 ? (double)referenceTotal / (double)liveBlockCount : 1.0;
+    printf("Dedup: %s (%d blocks merged)\nDedup Ratio: %.2fx\n", dedupEnabled ? "on" : "off", __atomic_load_n(&dedupMergedBlockCount, __ATOMIC_RELAXED), dedupRatio);
+    long logicalBlocks = __atomic_load_n(&compressedLogicalBlockTotal, __ATOMIC_RELAXED);
+    long physicalBlocks = __atomic_load_n(&compressedPhysicalBlockTotal, __ATOMIC_RELAXED);
+    double compressionRatio = physicalBlocks > 0 ? (double)logicalBlocks / (double)physicalBlocks : 1.0;
+    if (journalFileDescriptor >= 0) {
+        printf("Journal: %s (%ld records, %ld commits, %ld bytes, %d pending)\n", journalPath, journalRecordTotal, journalCommitCount, journalFileSize, journalPendingRecordCount);
+    }
+    printf("Compression: %s (%d extents bypassed)\nCompression Ratio: %.2fx (%ld blocks stored in %ld)\n", compressionEnabled ? "on" : "off", __atomic_load_n(&compressionBypassCount, __ATOMIC_RELAXED), compressionRatio, logicalBlocks, physicalBlocks);
+    pthread_mutex_lock(&decompressedExtentCacheLock);
+    printf("Extent Cache: %d slots (%ld hits, %ld misses)\n", DECOMPRESSED_EXTENT_CACHE_SLOTS, decompressedExtentCacheHitCount, decompressedExtentCacheMissCount);
+    pthread_mutex_unlock(&decompressedExtentCacheLock);
+    if (blockCacheFrames) {
+        pthread_mutex_lock(&blockCacheLock);
+        long blockCacheLookups = blockCacheHitCount + blockCacheMissCount;
+        double hitRate = blockCacheLookups > 0 ? (double)blockCacheHitCount / (double)blockCacheLookups * 100.0 : 0.0;
+        printf("Block Cache: %d frames (%ld hits, %ld misses, %.2f%% hit rate, %ld readahead)\n", BLOCK_CACHE_FRAME_COUNT, blockCacheHitCount, blockCacheMissCount, hitRate, blockCacheReadaheadCount);
+        printf("Writeback: %ld blocks in %ld batches, %d dirty\n", blockCacheWritebackBlockCount, blockCacheWritebackBatchCount, blockCacheDirtyFrameCount);
+        printf("Block I/O: %s backend (%ld requests in %ld submissions, %d max in flight)\n", getBlockIoBackendName(blockIoBackend), blockIoRequestCount, blockIoSubmissionCount, blockIoMaxInFlight);
+        pthread_mutex_unlock(&blockCacheLock);
+    }
+    pthread_mutex_unlock(&journalLock);
+    pthread_mutex_lock(&pathCacheLock);
+    printf("Path Cache: %d entries (%ld hits, %ld misses)\n", pathCacheEntryCount, pathCacheHitCount, pathCacheMissCount);
+    pthread_mutex_unlock(&pathCacheLock);
+    printf("Allocator: %d shards (free", BLOCK_ALLOCATOR_SHARD_COUNT);
+    for (int i = 0; i < BLOCK_ALLOCATOR_SHARD_COUNT; ++i) printf(" %d", __atomic_load_n(&blockAllocatorShards[i].freeCount, __ATOMIC_RELAXED));
+    printf("), %d sessions\n", getActiveSessionCount());
+    pthread_mutex_lock(&vfsNodePool.lock);
+    int liveNodeCount = vfsNodePool.liveCount;
+    int nodeSlabCount = vfsNodePool.slabCount;
+    pthread_mutex_unlock(&vfsNodePool.lock);
+    pthread_mutex_lock(&nameArenaLock);
+    printf("Metadata: %d nodes in %d slabs (%ld KB), %d names interned (%ld bytes in arena)\n", liveNodeCount, nodeSlabCount, (long)nodeSlabCount * OBJECT_SLAB_OBJECT_COUNT * (long)getPoolSlotSize(&vfsNodePool) / 1024, nameInternCount, nameArenaBytesUsed);
+    pthread_mutex_unlock(&nameArenaLock);
+    int fileCount;
+    int fragmentedFileCount;
+    double fragmentationScore = measureFragmentation(&fileCount, &fragmentedFileCount);
+    pthread_mutex_lock(&defragBackgroundLock);
+    printf("Fragmentation: %.2f%% (%d of %d files fragmented), background defrag %s (%ld blocks moved)\n", fragmentationScore, fragmentedFileCount, fileCount, defragBackgroundRunning && !defragBackgroundStopRequested ? "on" : "off", defragBackgroundRelocatedBlockTotal);
+    pthread_mutex_unlock(&defragBackgroundLock);
+}
+
+void parseWriteArguments(const char *argumentLine, char *fileNameOut, char **contentOut) {
+    fileNameOut[0] = '\0';
+    *contentOut = NULL;
+    if (!argumentLine) return;
+    const char *cursor = argumentLine;
+    while (*cursor && isspace((unsigned char)*cursor)) cursor++;
+    if (!*cursor) return;
+    int i = 0;
+    while (*cursor && !isspace((unsigned char)*cursor) && i < MAX_NAME_LEN) fileNameOut[i++] = *cursor++;
+    fileNameOut[i] = '\0';
+    while (*cursor && isspace((unsigned char)*cursor)) cursor++;
+    if (!*cursor) return;
+    if (*cursor == '"' || *cursor == '\'') {
+        char quoteChar = *cursor++;
+        const char *start = cursor;
+        while (*cursor && *cursor != quoteChar) cursor++;
+        size_t length = cursor - start;
+        *contentOut = malloc(length + 1);
+        if (!*contentOut) exitWithError("Out of memory");
+        memcpy(*contentOut, start, length);
+        (*contentOut)[length] = '\0';
+    } else {
+        size_t length = strlen(cursor);
+        while (length > 0 && (cursor[length - 1] == '\n' || cursor[length - 1] == '\r')) length--;
+        *contentOut = malloc(length + 1);
+        if (!*contentOut) exitWithError("Out of memory");
+        memcpy(*contentOut, cursor, length);
+        (*contentOut)[length] = '\0';
+    }
+}
+
+void unmountDiskImage() {
+    if (journalFileDescriptor < 0) return;
+    stopJournalCommitTimer();
+    commitJournal();
+    runRequestedCheckpoint();
+    close(journalFileDescriptor);
+    close(imageFileDescriptor);
+    journalFileDescriptor = imageFileDescriptor = -1;
+    releaseBlockCache();
+    free(journalBuffer);
+    journalBuffer = NULL;
+    journalBufferLength = journalBufferCapacity = 0;
+}
+
+void releaseVfsMetadata() {
+    for (int i = 0; i < pathCacheBucketCount; ++i) {
+        while (pathCacheBuckets[i]) unlinkPathCacheEntry(pathCacheBuckets[i]);
+    }
+    for (ObjectSlab *slab = vfsNodePool.slabs; slab; slab = slab->next) {
+        for (int i = 0; i < OBJECT_SLAB_OBJECT_COUNT; ++i) {
+            VfsNode *node = getPoolSlabObject(&vfsNodePool, slab, i);
+            if (node->inode) free(node->cachedPath);
+        }
+    }
+    for (ObjectSlab *slab = vfsInodePool.slabs; slab; slab = slab->next) {
+        for (int i = 0; i < OBJECT_SLAB_OBJECT_COUNT; ++i) {
+            VfsInode *inode = getPoolSlabObject(&vfsInodePool, slab, i);
+            if (inode->linkCount == 0) continue;
+            releaseBlockMap(inode->blockMap);
+            pthread_rwlock_destroy(&inode->inodeLock);
+        }
+    }
+    releaseObjectPool(&vfsNodePool);
+    releaseObjectPool(&vfsInodePool);
+    releaseNameArena();
+}
+
+void cleanupVfs() {
+    stopBackgroundDefrag(1);
+    unmountDiskImage();
+    if (rootDirectory) {
+        releaseVfsMetadata();
+        rootDirectory = currentDirectory = NULL;
+    }
+    releaseFreeBlockList();
+    for (int i = 0; i < BLOCK_ALLOCATOR_SHARD_COUNT; ++i) pthread_mutex_destroy(&blockAllocatorShards[i].lock);
+    releaseThreadPendingFrees();
+    releaseBlockReservation();
+    if (virtualDisk) free(virtualDisk);
+    virtualDisk = NULL;
+    free(blockReferenceCounts);
+    blockReferenceCounts = NULL;
+    free(dedupBucketHeads);
+    free(dedupNextInBucket);
+    free(blockFingerprints);
+    free(blockIsIndexed);
+    dedupBucketHeads = dedupNextInBucket = NULL;
+    blockFingerprints = NULL;
+    blockIsIndexed = NULL;
+    free(pathCacheBuckets);
+    pathCacheBuckets = NULL;
+    pathCacheBucketCount = pathCacheEntryCount = 0;
+    free(pendingFreeBlocks);
+    pendingFreeBlocks = NULL;
+    pthread_rwlock_destroy(&vfsTreeLock);
+    pthread_mutex_destroy(&journalLock);
+}
+
+VfsNode* lookupFileForCommand(const char *fileName) {
+    VfsNode *fileNode = resolveVfsPath(fileName);
+    if (!fileNode) {
+        printf("Error: file '%s' not found\n", fileName);
+        return NULL;
+    }
+    if (fileNode->isDirectory) {
+        printf("Error: '%s' is a directory\n", fileName);
+        return NULL;
+    }
+    return fileNode;
+}
+
+int handleAppendFile(const char *arguments) {
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: append <filename> \"content\"\n"); return -1; }
+    char fileName[MAX_NAME_LEN + 1];
+    char *content = NULL;
+    parseWriteArguments(arguments, fileName, &content);
+    if (strlen(fileName) == 0) {
+        printf("Error: missing filename\n");
+        if (content) free(content);
+        return -1;
+    }
+    VfsNode *fileNode = lookupFileForCommand(fileName);
+    if (!fileNode) {
+        if (content) free(content);
+        return -1;
+    }
+    int size = content ? (int)strlen(content) : 0;
+    lockNodeExclusive(fileNode);
+    int result = appendFileContent(fileNode, (const unsigned char *)(content ? content : ""), size);
+    int newSize = fileNode->inode->fileSize;
+    unlockNode(fileNode);
+    if (content) free(content);
+    if (result == -2) { printf("Error: not enough disk space\n"); return -1; }
+    if (result < 0) { printf("Error: append failed\n"); return -1; }
+    printf("Data appended (%d bytes) to %s, size now %d bytes\n", size, fileName, newSize);
+    return 0;
+}
+
+int handleReadAt(const char *arguments) {
+    char fileName[MAX_NAME_LEN + 1];
+    int offset, length;
+    if (!arguments || sscanf(arguments, "%50s %d %d", fileName, &offset, &length) != 3 || offset < 0 || length < 0) {
+        printf("Usage: readat <filename> <offset> <length>\n");
+        return -1;
+    }
+    VfsNode *fileNode = lookupFileForCommand(fileName);
+    if (!fileNode) return -1;
+    unsigned char buffer[VFS_BLOCK_SIZE];
+    lockNodeShared(fileNode);
+    while (length > 0) {
+        int chunk = length > (int)sizeof(buffer) ? (int)sizeof(buffer) : length;
+        int bytesRead = readFileRange(fileNode, offset, buffer, chunk);
+        if (bytesRead <= 0) break;
+        fwrite(buffer, 1, bytesRead, stdout);
+        offset += bytesRead;
+        length -= bytesRead;
+    }
+    unlockNode(fileNode);
+    printf("\n");
+    return 0;
+}
+
+int handleTruncateFile(const char *arguments) {
+    char fileName[MAX_NAME_LEN + 1];
+    int newSize;
+    if (!arguments || sscanf(arguments, "%50s %d", fileName, &newSize) != 2 || newSize < 0) {
+        printf("Usage: truncate <filename> <size>\n");
+        return -1;
+    }
+    VfsNode *fileNode = lookupFileForCommand(fileName);
+    if (!fileNode) return -1;
+    lockNodeExclusive(fileNode);
+    int result = truncateFileContent(fileNode, newSize);
+    unlockNode(fileNode);
+    if (result == -2) { printf("Error: not enough disk space\n"); return -1; }
+    if (result < 0) { printf("Error: truncate failed\n"); return -1; }
+    printf("File '%s' truncated to %d bytes\n", fileName, newSize);
+    return 0;
+}
+
+int handleCloneNode(const char *arguments, int requireDirectory) {
+    const char *usage = requireDirectory ? "Usage: snapshot <dirname> <snapshotname>" : "Usage: clone <source> <destination>";
+    char sourceName[MAX_NAME_LEN + 1];
+    char cloneName[MAX_NAME_LEN + 1];
+    if (!arguments || sscanf(arguments, "%50s %50s", sourceName, cloneName) != 2) {
+        printf("%s\n", usage);
+        return -1;
+    }
+    if (strchr(cloneName, '/')) { printf("Error: name cannot contain '/'\n"); return -1; }
+    VfsNode *sourceNode = strcmp(sourceName, ".") == 0 ? currentDirectory : findChildNode(currentDirectory, sourceName);
+    if (!sourceNode) { printf("Error: '%s' not found\n", sourceName); return -1; }
+    if (requireDirectory && !sourceNode->isDirectory) { printf("Error: '%s' is not a directory\n", sourceName); return -1; }
+    if (findChildNode(currentDirectory, cloneName)) { printf("Error: '%s' already exists\n", cloneName); return -1; }
+    VfsNode *cloneNode = cloneVfsSubtree(sourceNode, cloneName);
+    attachChildNode(currentDirectory, cloneNode);
+    journalCloneNode(sourceNode, cloneNode);
+    printf("%s '%s' created from '%s'\n", requireDirectory ? "Snapshot" : "Clone", cloneName, sourceName);
+    return 0;
+}
+
+int consumeRecursiveFlag(const char **arguments) {
+    const char *cursor = *arguments;
+    if (cursor[0] != '-' || (cursor[1] != 'r' && cursor[1] != 'R')) return 0;
+    if (cursor[2] && !isspace((unsigned char)cursor[2])) return 0;
+    cursor += 2;
+    while (*cursor && isspace((unsigned char)*cursor)) cursor++;
+    *arguments = cursor;
+    return 1;
+}
+
+int handleRemoveNode(const char *arguments) {
+    int recursive = arguments ? consumeRecursiveFlag(&arguments) : 0;
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: rm [-r] <path>\n"); return -1; }
+    VfsNode *targetNode = resolveVfsPath(arguments);
+    if (!targetNode) { printf("Error: '%s' not found\n", arguments); return -1; }
+    if (targetNode->isDirectory && !recursive) { printf("Error: '%s' is a directory. Use rm -r\n", arguments); return -1; }
+    if (isAncestorOrSelf(targetNode, currentDirectory)) { printf("Error: cannot remove '%s': it contains the current directory\n", arguments); return -1; }
+    if (targetNode->isDirectory && isDirectoryInUse(targetNode)) { printf("Error: cannot remove '%s': it is in use by another session\n", arguments); return -1; }
+    int removedCount = removeVfsSubtree(targetNode);
+    printf("Removed '%s' (%d %s)\n", arguments, removedCount, removedCount == 1 ? "entry" : "entries");
+    return 0;
+}
+
+VfsNode* resolveNewNodeParent(char *path, const char **nameOut) {
+    char *separator = strrchr(path, '/');
+    *nameOut = separator ? separator + 1 : path;
+    VfsNode *parent;
+    if (!separator) {
+        parent = currentDirectory;
+    } else if (separator == path) {
+        parent = rootDirectory;
+    } else {
+        *separator = '\0';
+        parent = resolveVfsPath(path);
+        *separator = '/';
+    }
+    return parent && parent->isDirectory ? parent : NULL;
+}
+
+int handleMoveNode(const char *arguments) {
+    char sourcePath[MAX_CMD_LEN];
+    char destinationPath[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s %2047s", sourcePath, destinationPath) != 2) {
+        printf("Usage: mv <source> <destination>\n");
+        return -1;
+    }
+    VfsNode *sourceNode = resolveVfsPath(sourcePath);
+    if (!sourceNode) { printf("Error: '%s' not found\n", sourcePath); return -1; }
+    if (sourceNode == rootDirectory) { printf("Error: cannot move '/'\n"); return -1; }
+    VfsNode *destinationParent = resolveVfsPath(destinationPath);
+    const char *newName;
+    if (destinationParent == sourceNode) {
+        destinationParent = sourceNode->parent;
+        newName = sourceNode->name;
+    } else if (destinationParent) {
+        if (!destinationParent->isDirectory) { printf("Error: '%s' already exists\n", destinationPath); return -1; }
+        newName = sourceNode->name;
+    } else {
+        destinationParent = resolveNewNodeParent(destinationPath, &newName);
+        if (!destinationParent) { printf("Error: destination directory for '%s' not found\n", destinationPath); return -1; }
+        if (strlen(newName) == 0 || strlen(newName) > MAX_NAME_LEN) { printf("Error: invalid name '%s'\n", newName); return -1; }
+    }
+    if (sourceNode->isDirectory && isAncestorOrSelf(sourceNode, destinationParent)) {
+        printf("Error: cannot move '%s' into itself\n", sourcePath);
+        return -1;
+    }
+    VfsNode *existingNode = findChildNode(destinationParent, newName);
+    if (existingNode && existingNode != sourceNode) { printf("Error: '%s' already exists\n", newName); return -1; }
+    if (moveVfsNode(sourceNode, destinationParent, newName) != 0) { printf("Error: cannot move '%s'\n", sourcePath); return -1; }
+    char movedPath[MAX_CMD_LEN];
+    buildAbsolutePath(sourceNode, movedPath, sizeof(movedPath));
+    printf("Moved '%s' to %s\n", sourcePath, movedPath);
+    return 0;
+}
+
+int handleLinkNode(const char *arguments) {
+    char targetPath[MAX_CMD_LEN];
+    char linkPath[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s %2047s", targetPath, linkPath) != 2) {
+        printf("Usage: ln <target> <linkname>\n");
+        return -1;
+    }
+    VfsNode *targetNode = resolveVfsPath(targetPath);
+    if (!targetNode) { printf("Error: '%s' not found\n", targetPath); return -1; }
+    if (targetNode->isDirectory) { printf("Error: '%s' is a directory\n", targetPath); return -1; }
+    VfsNode *linkParent = resolveVfsPath(linkPath);
+    const char *linkName;
+    if (linkParent) {
+        if (!linkParent->isDirectory) { printf("Error: '%s' already exists\n", linkPath); return -1; }
+        linkName = targetNode->name;
+    } else {
+        linkParent = resolveNewNodeParent(linkPath, &linkName);
+        if (!linkParent) { printf("Error: destination directory for '%s' not found\n", linkPath); return -1; }
+        if (strlen(linkName) == 0 || strlen(linkName) > MAX_NAME_LEN) { printf("Error: invalid name '%s'\n", linkName); return -1; }
+    }
+    if (findChildNode(linkParent, linkName)) { printf("Error: '%s' already exists\n", linkName); return -1; }
+    VfsNode *linkNode = linkVfsNode(targetNode, linkParent, linkName);
+    if (!linkNode) { printf("Error: cannot link '%s'\n", targetPath); return -1; }
+    char createdPath[MAX_CMD_LEN];
+    buildAbsolutePath(linkNode, createdPath, sizeof(createdPath));
+    printf("Linked %s to '%s' (%d links)\n", createdPath, targetPath, linkNode->inode->linkCount);
+    return 0;
+}
+
+int handleCopyNode(const char *arguments) {
+    int recursive = arguments ? consumeRecursiveFlag(&arguments) : 0;
+    char sourcePath[MAX_CMD_LEN];
+    char destinationPath[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s %2047s", sourcePath, destinationPath) != 2) {
+        printf("Usage: cp [-r] <source> <destination>\n");
+        return -1;
+    }
+    VfsNode *sourceNode = resolveVfsPath(sourcePath);
+    if (!sourceNode) { printf("Error: '%s' not found\n", sourcePath); return -1; }
+    if (sourceNode->isDirectory && !recursive) { printf("Error: '%s' is a directory. Use cp -r\n", sourcePath); return -1; }
+    VfsNode *destinationParent = resolveVfsPath(destinationPath);
+    const char *cloneName;
+    if (destinationParent) {
+        if (!destinationParent->isDirectory) { printf("Error: '%s' already exists\n", destinationPath); return -1; }
+        if (sourceNode == rootDirectory) { printf("Error: copying '/' requires a new destination name\n"); return -1; }
+        cloneName = sourceNode->name;
+    } else {
+        destinationParent = resolveNewNodeParent(destinationPath, &cloneName);
+        if (!destinationParent) { printf("Error: destination directory for '%s' not found\n", destinationPath); return -1; }
+        if (strlen(cloneName) == 0 || strlen(cloneName) > MAX_NAME_LEN) { printf("Error: invalid name '%s'\n", cloneName); return -1; }
+    }
+    if (findChildNode(destinationParent, cloneName)) { printf("Error: '%s' already exists\n", cloneName); return -1; }
+    VfsNode *cloneNode = cloneVfsSubtree(sourceNode, cloneName);
+    attachChildNode(destinationParent, cloneNode);
+    journalCloneNode(sourceNode, cloneNode);
+    char clonePath[MAX_CMD_LEN];
+    buildAbsolutePath(cloneNode, clonePath, sizeof(clonePath));
+    printf("Copied '%s' to %s\n", sourcePath, clonePath);
+    return 0;
+}
+
+int handleDirectoryUsage(const char *arguments) {
+    VfsNode *targetNode = arguments && strlen(arguments) > 0 ? resolveVfsPath(arguments) : currentDirectory;
+    if (!targetNode) { printf("Error: '%s' not found\n", arguments); return -1; }
+    char pathBuffer[MAX_CMD_LEN];
+    lockNodeShared(targetNode);
+    if (targetNode->isDirectory && targetNode->firstChild) {
+        VfsNode *head = targetNode->firstChild;
+        VfsNode *child = head;
+        do {
+            if (child->isDirectory) {
+                buildAbsolutePath(child, pathBuffer, sizeof(pathBuffer));
+                printf("%ld\t%s\n", getSubtreeSize(child), pathBuffer);
             }
-            readFileContent(fileNode);
-            printf("\n");
-        } else if (strcmp(command, "delete") == 0) {
-            if (!arguments || strlen(arguments) == 0) {
-                printf("Usage: delete <filename>\n");
-                continue;
+            child = child->nextSibling;
+        } while (child != head);
+    }
+    unlockNode(targetNode);
+    buildAbsolutePath(targetNode, pathBuffer, sizeof(pathBuffer));
+    printf("%ld\t%s\n", getSubtreeSize(targetNode), pathBuffer);
+    return 0;
+}
+
+int handleFindNodes(const char *arguments) {
+    char pattern[MAX_CMD_LEN] = "";
+    char referencePath[MAX_CMD_LEN] = "";
+    char token[MAX_CMD_LEN];
+    int consumed;
+    int invalidArguments = 0;
+    const char *cursor = arguments ? arguments : "";
+    while (!invalidArguments && sscanf(cursor, "%2047s%n", token, &consumed) == 1) {
+        cursor += consumed;
+        if (strcmp(token, "-newer") == 0) {
+            invalidArguments = referencePath[0] || sscanf(cursor, "%2047s%n", referencePath, &consumed) != 1;
+            cursor += invalidArguments ? 0 : consumed;
+        } else if (!pattern[0]) {
+            strcpy(pattern, token);
+        } else {
+            invalidArguments = 1;
+        }
+    }
+    if (invalidArguments || (!pattern[0] && !referencePath[0])) { printf("Usage: find <pattern> [-newer <path>] | find -newer <path>\n"); return -1; }
+    if (!pattern[0]) strcpy(pattern, "*");
+    long referenceTime = 0;
+    if (referencePath[0]) {
+        VfsNode *referenceNode = resolveVfsPath(referencePath);
+        if (!referenceNode) { printf("Error: '%s' not found\n", referencePath); return -1; }
+        referenceTime = __atomic_load_n(&referenceNode->inode->modifyTime, __ATOMIC_RELAXED);
+    }
+    int matchCount = 0;
+    int scannedDirectoryCount = 0;
+    int skippedSubtreeCount = 0;
+    char pathBuffer[MAX_CMD_LEN];
+    VfsTraversalStack stack = {0};
+    if (!referencePath[0] || __atomic_load_n(&currentDirectory->subtreeModifyTime, __ATOMIC_RELAXED) > referenceTime) {
+        lockNodeShared(currentDirectory);
+        pushChildFrames(&stack, currentDirectory, NULL);
+        unlockNode(currentDirectory);
+        scannedDirectoryCount++;
+    } else {
+        skippedSubtreeCount++;
+    }
+    while (stack.count > 0) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        if (fnmatch(pattern, node->name, 0) == 0 && (!referencePath[0] || __atomic_load_n(&node->inode->modifyTime, __ATOMIC_RELAXED) > referenceTime)) {
+            buildAbsolutePath(node, pathBuffer, sizeof(pathBuffer));
+            printf("%s%s\n", pathBuffer, node->isDirectory ? "/" : "");
+            matchCount++;
+        }
+        if (!node->isDirectory) continue;
+        if (referencePath[0] && __atomic_load_n(&node->subtreeModifyTime, __ATOMIC_RELAXED) <= referenceTime) {
+            skippedSubtreeCount++;
+            continue;
+        }
+        lockNodeShared(node);
+        pushChildFrames(&stack, node, NULL);
+        unlockNode(node);
+        scannedDirectoryCount++;
+    }
+    free(stack.frames);
+    if (matchCount == 0) printf("(no matches)\n");
+    if (referencePath[0]) printf("(%d directories scanned, %d unchanged subtrees skipped)\n", scannedDirectoryCount, skippedSubtreeCount);
+    return 0;
+}
+
+void formatVfsTimestamp(long timestamp, char *outputBuffer, int bufferSize) {
+    time_t seconds = (time_t)(timestamp / 1000000000L);
+    struct tm localTime;
+    localtime_r(&seconds, &localTime);
+    int length = (int)strftime(outputBuffer, bufferSize, "%Y-%m-%d %H:%M:%S", &localTime);
+    snprintf(outputBuffer + length, bufferSize - length, ".%09ld", timestamp % 1000000000L);
+}
+
+void formatVfsMode(const VfsNode *node, char *outputBuffer) {
+    static const char permissionLetters[] = "rwxrwxrwx";
+    int mode = node->inode->mode;
+    outputBuffer[0] = node->isDirectory ? 'd' : '-';
+    for (int i = 0; i < 9; ++i) outputBuffer[i + 1] = (mode & (0400 >> i)) ? permissionLetters[i] : '-';
+    outputBuffer[10] = '\0';
+}
+
+int handleStatNode(const char *arguments) {
+    VfsNode *node = arguments && strlen(arguments) > 0 ? resolveVfsPath(arguments) : currentDirectory;
+    if (!node) { printf("Error: '%s' not found\n", arguments); return -1; }
+    char pathBuffer[MAX_CMD_LEN];
+    char modeText[11];
+    char timeText[3][64];
+    buildAbsolutePath(node, pathBuffer, sizeof(pathBuffer));
+    lockNodeShared(node);
+    VfsInode *inode = node->inode;
+    formatVfsMode(node, modeText);
+    formatVfsTimestamp(__atomic_load_n(&inode->accessTime, __ATOMIC_RELAXED), timeText[0], sizeof(timeText[0]));
+    formatVfsTimestamp(__atomic_load_n(&inode->modifyTime, __ATOMIC_RELAXED), timeText[1], sizeof(timeText[1]));
+    formatVfsTimestamp(__atomic_load_n(&inode->changeTime, __ATOMIC_RELAXED), timeText[2], sizeof(timeText[2]));
+    unsigned char attributes[VFS_BLOCK_SIZE];
+    int attributeLength = loadNodeAttributes(node, attributes);
+    int attributeCount = 0;
+    for (int position = 0; position + 2 <= attributeLength; position += 2 + attributes[position] + attributes[position + 1]) attributeCount++;
+    printf("  File: %s\n", pathBuffer);
+    if (node->isDirectory) {
+        printf("  Size: %-12ld Entries: %-8d directory\n", getSubtreeSize(node), node->childCount);
+    } else {
+        printf("  Size: %-12d Blocks: %-9d Links: %-4d regular file\n", inode->fileSize, getAllocatedBlockCount(node), inode->linkCount);
+    }
+    printf(" Inode: %-12d Mode: %04o (%s)\n", getPrimaryLink(node)->nodeId, inode->mode, modeText);
+    printf("Access: %s\nModify: %s\nChange: %s\n", timeText[0], timeText[1], timeText[2]);
+    if (node->isDirectory) {
+        char newestText[64];
+        formatVfsTimestamp(__atomic_load_n(&node->subtreeModifyTime, __ATOMIC_RELAXED), newestText, sizeof(newestText));
+        printf("Newest: %s\n", newestText);
+    }
+    if (inode->attributeBlock >= 0) {
+        printf(" Xattr: %d (%d bytes in shared block %d, %d references)\n", attributeCount, attributeLength, inode->attributeBlock, getBlockReferenceCount(inode->attributeBlock));
+    } else {
+        printf(" Xattr: %d (%d bytes inline)\n", attributeCount, attributeLength);
+    }
+    unlockNode(node);
+    return 0;
+}
+
+int handleChangeMode(const char *arguments) {
+    char modeText[32];
+    char path[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%31s %2047s", modeText, path) != 2) { printf("Usage: chmod <octal-mode> <path>\n"); return -1; }
+    char *end;
+    long mode = strtol(modeText, &end, 8);
+    if (*end || mode < 0 || mode > 07777) { printf("Error: invalid mode '%s'\n", modeText); return -1; }
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) { printf("Error: '%s' not found\n", path); return -1; }
+    lockNodeExclusive(node);
+    node->inode->mode = (unsigned short)mode;
+    touchVfsNode(node, 0);
+    journalNodeAttributes(node);
+    unlockNode(node);
+    printf("Mode of '%s' set to %04lo\n", path, mode);
+    return 0;
+}
+
+int handleTouchNode(const char *arguments) {
+    char path[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s", path) != 1) { printf("Usage: touch <path>\n"); return -1; }
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) {
+        const char *name;
+        VfsNode *parent = resolveNewNodeParent(path, &name);
+        if (!parent) { printf("Error: directory for '%s' not found\n", path); return -1; }
+        if (strlen(name) == 0 || strlen(name) > MAX_NAME_LEN) { printf("Error: invalid name '%s'\n", name); return -1; }
+        lockNodeExclusive(parent);
+        node = findChildNode(parent, name);
+        if (!node) node = createChildNode(parent, name, 0);
+        unlockNode(parent);
+        if (!node) { printf("Error: cannot create '%s'\n", path); return -1; }
+    }
+    lockNodeExclusive(node);
+    touchVfsNode(node, 1);
+    __atomic_store_n(&node->inode->accessTime, node->inode->modifyTime, __ATOMIC_RELAXED);
+    journalNodeAttributes(node);
+    unlockNode(node);
+    return 0;
+}
+
+int handleSetAttribute(const char *arguments) {
+    char path[MAX_CMD_LEN];
+    char name[ATTRIBUTE_NAME_MAX_LEN + 2];
+    int consumed = 0;
+    if (!arguments || sscanf(arguments, "%2047s %65s %n", path, name, &consumed) != 2 || consumed == 0) {
+        printf("Usage: setxattr <path> <name> <value>\n");
+        return -1;
+    }
+    const char *value = arguments + consumed;
+    int valueLength = (int)strlen(value);
+    if (valueLength >= 2 && value[0] == '"' && value[valueLength - 1] == '"') {
+        value++;
+        valueLength -= 2;
+    }
+    if (strlen(name) > ATTRIBUTE_NAME_MAX_LEN || valueLength > ATTRIBUTE_VALUE_MAX_LEN) {
+        printf("Error: attribute names are limited to %d bytes and values to %d bytes\n", ATTRIBUTE_NAME_MAX_LEN, ATTRIBUTE_VALUE_MAX_LEN);
+        return -1;
+    }
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) { printf("Error: '%s' not found\n", path); return -1; }
+    lockNodeExclusive(node);
+    int result = setNodeAttribute(node, name, (const unsigned char *)value, valueLength);
+    if (result == 0) journalNodeAttributes(node);
+    unlockNode(node);
+    if (result == -2) { printf("Error: not enough disk space\n"); return -1; }
+    if (result == -3) { printf("Error: attributes of '%s' would exceed %d bytes\n", path, VFS_BLOCK_SIZE); return -1; }
+    if (result != 0) { printf("Error: cannot set attribute '%s'\n", name); return -1; }
+    printf("Attribute '%s' set on %s\n", name, path);
+    return 0;
+}
+
+int handleGetAttribute(const char *arguments) {
+    char path[MAX_CMD_LEN];
+    char name[ATTRIBUTE_NAME_MAX_LEN + 2] = "";
+    if (!arguments || sscanf(arguments, "%2047s %65s", path, name) < 1) { printf("Usage: getxattr <path> [name]\n"); return -1; }
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) { printf("Error: '%s' not found\n", path); return -1; }
+    unsigned char attributes[VFS_BLOCK_SIZE];
+    lockNodeShared(node);
+    int length = loadNodeAttributes(node, attributes);
+    unlockNode(node);
+    int printedCount = 0;
+    for (int position = 0; position + 2 <= length; position += 2 + attributes[position] + attributes[position + 1]) {
+        int nameLength = attributes[position];
+        const char *entryName = (const char *)attributes + position + 2;
+        if (name[0] && ((int)strlen(name) != nameLength || memcmp(entryName, name, nameLength) != 0)) continue;
+        printf("%.*s=\"%.*s\"\n", nameLength, entryName, attributes[position + 1], entryName + nameLength);
+        printedCount++;
+    }
+    if (name[0] && printedCount == 0) { printf("Error: attribute '%s' not found\n", name); return -1; }
+    if (printedCount == 0) printf("(no attributes)\n");
+    return 0;
+}
+
+int handleRemoveAttribute(const char *arguments) {
+    char path[MAX_CMD_LEN];
+    char name[ATTRIBUTE_NAME_MAX_LEN + 2];
+    if (!arguments || sscanf(arguments, "%2047s %65s", path, name) != 2) { printf("Usage: rmxattr <path> <name>\n"); return -1; }
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) { printf("Error: '%s' not found\n", path); return -1; }
+    lockNodeExclusive(node);
+    int result = removeNodeAttribute(node, name);
+    if (result == 0) journalNodeAttributes(node);
+    unlockNode(node);
+    if (result != 0) { printf("Error: attribute '%s' not found\n", name); return -1; }
+    printf("Attribute '%s' removed from %s\n", name, path);
+    return 0;
+}
+
+int readFullChunk(int fileDescriptor, unsigned char *buffer, int capacity) {
+    int filled = 0;
+    while (filled < capacity) {
+        ssize_t bytesRead = read(fileDescriptor, buffer + filled, capacity - filled);
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead < 0) return -1;
+        if (bytesRead == 0) break;
+        filled += (int)bytesRead;
+    }
+    return filled;
+}
+
+int writeFullVectors(int fileDescriptor, struct iovec *vectors, int vectorCount) {
+    while (vectorCount > 0) {
+        ssize_t written = writev(fileDescriptor, vectors, vectorCount);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) return -1;
+        while (vectorCount > 0 && (size_t)written >= vectors->iov_len) {
+            written -= (ssize_t)vectors->iov_len;
+            vectors++;
+            vectorCount--;
+        }
+        if (vectorCount > 0) {
+            vectors->iov_base = (unsigned char *)vectors->iov_base + written;
+            vectors->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+int importHostFile(VfsNode *fileNode, int hostDescriptor) {
+    unsigned char *chunkBuffer = malloc(HOST_IO_CHUNK_SIZE);
+    if (!chunkBuffer) exitWithError("Out of memory");
+    int offset = 0;
+    int result = 0;
+    while (1) {
+        int bytesRead = readFullChunk(hostDescriptor, chunkBuffer, HOST_IO_CHUNK_SIZE);
+        if (bytesRead <= 0) {
+            result = bytesRead;
+            break;
+        }
+        result = writeFileRange(fileNode, offset, chunkBuffer, bytesRead);
+        if (result < 0) break;
+        offset += bytesRead;
+    }
+    free(chunkBuffer);
+    return result < 0 ? result : 0;
+}
+
+void replaceFileContent(VfsNode *fileNode, VfsNode *contentNode) {
+    VfsBlockMap *previousBlockMap = fileNode->inode->blockMap;
+    fileNode->inode->blockMap = contentNode->inode->blockMap;
+    contentNode->inode->blockMap = NULL;
+    setFileSize(fileNode, contentNode->inode->fileSize);
+    contentNode->inode->fileSize = 0;
+    releaseBlockMap(previousBlockMap);
+    touchVfsNode(fileNode, 1);
+    journalFileMap(fileNode, 0, getFileBlockCount(fileNode));
+}
+
+int exportFileToHost(const VfsNode *fileNode, int hostDescriptor) {
+    const VfsBlockMap *blockMap = fileNode->inode->blockMap;
+    struct iovec vectors[HOST_IO_VECTOR_COUNT];
+    int pinnedBlocks[HOST_IO_VECTOR_COUNT];
+    unsigned char *extentBuffers = NULL;
+    int vectorCount = 0;
+    int pinnedBlockCount = 0;
+    int bufferedExtentCount = 0;
+    int prefetchedEndSlot = 0;
+    int position = 0;
+    int result = 0;
+    while (position < fileNode->inode->fileSize && result == 0) {
+        if (vectorCount == HOST_IO_VECTOR_COUNT || bufferedExtentCount == HOST_IO_VECTOR_COUNT || pinnedBlockCount == HOST_IO_VECTOR_COUNT) {
+            result = writeFullVectors(hostDescriptor, vectors, vectorCount);
+            while (pinnedBlockCount > 0) unpinDiskBlock(pinnedBlocks[--pinnedBlockCount]);
+            vectorCount = bufferedExtentCount = 0;
+            if (result != 0) break;
+        }
+        int slot = position / VFS_BLOCK_SIZE;
+        if (slot >= prefetchedEndSlot) {
+            prefetchedEndSlot = slot + BLOCK_CACHE_READAHEAD_MAX_BLOCKS;
+            prefetchFileBlocks(fileNode, slot, prefetchedEndSlot);
+        }
+        int extent = slot / COMPRESSION_EXTENT_BLOCKS;
+        const unsigned char *data;
+        int length;
+        if (getCompressedExtentLength(blockMap, extent) > 0) {
+            if (!extentBuffers) {
+                extentBuffers = malloc((size_t)HOST_IO_VECTOR_COUNT * COMPRESSION_EXTENT_SIZE);
+                if (!extentBuffers) exitWithError("Out of memory");
             }
-            VfsNode *fileNode = findChildNode(currentDirectory, arguments);
-            if (!fileNode) {
-                printf("Error: file '%s' not found\n", arguments);
-                continue;
+            unsigned char *extentBuffer = extentBuffers + (size_t)bufferedExtentCount++ * COMPRESSION_EXTENT_SIZE;
+            loadCompressedExtent(blockMap, extent, extentBuffer);
+            data = extentBuffer;
+            length = getExtentSlotCount(blockMap, extent) * VFS_BLOCK_SIZE;
+        } else {
+            data = zeroDiskBlock;
+            if (blockMap->blocks[slot] >= 0) {
+                data = pinDiskBlock(blockMap->blocks[slot]);
+                pinnedBlocks[pinnedBlockCount++] = blockMap->blocks[slot];
             }
-            if (fileNode->isDirectory) {
-                printf("Error: '%s' is a directory. Use rmdir\n", arguments);
-                continue;
+            length = VFS_BLOCK_SIZE;
+        }
+        if (length > fileNode->inode->fileSize - position) length = fileNode->inode->fileSize - position;
+        if (vectorCount > 0 && (const unsigned char *)vectors[vectorCount - 1].iov_base + vectors[vectorCount - 1].iov_len == data) {
+            vectors[vectorCount - 1].iov_len += length;
+        } else {
+            vectors[vectorCount].iov_base = (void *)data;
+            vectors[vectorCount].iov_len = length;
+            vectorCount++;
+        }
+        position += length;
+    }
+    if (result == 0 && vectorCount > 0) result = writeFullVectors(hostDescriptor, vectors, vectorCount);
+    while (pinnedBlockCount > 0) unpinDiskBlock(pinnedBlocks[--pinnedBlockCount]);
+    free(extentBuffers);
+    return result;
+}
+
+int handleImportFile(const char *arguments) {
+    char hostPath[MAX_CMD_LEN];
+    char vfsPath[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s %2047s", hostPath, vfsPath) != 2) {
+        printf("Usage: import <hostpath> <vfspath>\n");
+        return -1;
+    }
+    VfsNode *fileNode = resolveVfsPath(vfsPath);
+    if (fileNode && fileNode->isDirectory) { printf("Error: '%s' is a directory\n", vfsPath); return -1; }
+    const char *fileName = NULL;
+    VfsNode *parent = NULL;
+    if (!fileNode) {
+        parent = resolveNewNodeParent(vfsPath, &fileName);
+        if (!parent) { printf("Error: destination directory for '%s' not found\n", vfsPath); return -1; }
+        if (strlen(fileName) == 0 || strlen(fileName) > MAX_NAME_LEN) { printf("Error: invalid name '%s'\n", fileName); return -1; }
+    }
+    int hostDescriptor = open(hostPath, O_RDONLY);
+    if (hostDescriptor < 0) { printf("Error: cannot open '%s': %s\n", hostPath, strerror(errno)); return -1; }
+    struct stat hostStat;
+    if (fstat(hostDescriptor, &hostStat) != 0 || !S_ISREG(hostStat.st_mode) || hostStat.st_size > INT_MAX) {
+        printf("Error: '%s' is not a regular file that fits in the VFS\n", hostPath);
+        close(hostDescriptor);
+        return -1;
+    }
+    posix_fadvise(hostDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+    VfsNode *importNode = fileNode ? createVfsNode(fileNode->name, 0, NULL) : createChildNode(parent, fileName, 0);
+    int result = importHostFile(importNode, hostDescriptor);
+    close(hostDescriptor);
+    if (result != 0) {
+        if (fileNode) {
+            freeVfsNode(importNode);
+            pthread_mutex_lock(&journalLock);
+            publishThreadPendingFrees();
+            pthread_mutex_unlock(&journalLock);
+        } else {
+            deleteFileNode(importNode);
+        }
+        if (result == -2) {
+            printf("Error: not enough disk space\n");
+        } else {
+            printf("Error: cannot read '%s'\n", hostPath);
+        }
+        return -1;
+    }
+    if (fileNode) {
+        replaceFileContent(fileNode, importNode);
+        freeVfsNode(importNode);
+    } else {
+        fileNode = importNode;
+    }
+    char filePath[MAX_CMD_LEN];
+    buildAbsolutePath(fileNode, filePath, sizeof(filePath));
+    printf("Imported %d bytes from %s to %s\n", fileNode->inode->fileSize, hostPath, filePath);
+    return 0;
+}
+
+int handleExportFile(const char *arguments) {
+    char vfsPath[MAX_CMD_LEN];
+    char hostPath[MAX_CMD_LEN];
+    if (!arguments || sscanf(arguments, "%2047s %2047s", vfsPath, hostPath) != 2) {
+        printf("Usage: export <vfspath> <hostpath>\n");
+        return -1;
+    }
+    VfsNode *fileNode = lookupFileForCommand(vfsPath);
+    if (!fileNode) return -1;
+    int hostDescriptor = open(hostPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (hostDescriptor < 0) { printf("Error: cannot open '%s': %s\n", hostPath, strerror(errno)); return -1; }
+    lockNodeShared(fileNode);
+    int exportedSize = fileNode->inode->fileSize;
+    int result = exportFileToHost(fileNode, hostDescriptor);
+    unlockNode(fileNode);
+    if (close(hostDescriptor) != 0) result = -1;
+    if (result != 0) { printf("Error: cannot write '%s': %s\n", hostPath, strerror(errno)); return -1; }
+    printf("Exported %d bytes from %s to %s\n", exportedSize, vfsPath, hostPath);
+    return 0;
+}
+
+int handleDedupMode(const char *arguments) {
+    if (arguments && strcmp(arguments, "on") == 0) {
+        dedupEnabled = 1;
+    } else if (arguments && strcmp(arguments, "off") == 0) {
+        dedupEnabled = 0;
+        clearDedupIndex();
+    } else {
+        printf("Usage: dedup <on|off>\n");
+        return -1;
+    }
+    printf("Deduplication %s\n", dedupEnabled ? "enabled" : "disabled");
+    return 0;
+}
+
+int handleCompressionMode(const char *arguments) {
+    if (arguments && strcmp(arguments, "on") == 0) {
+        compressionEnabled = 1;
+    } else if (arguments && strcmp(arguments, "off") == 0) {
+        compressionEnabled = 0;
+    } else {
+        printf("Usage: compress <on|off>\n");
+        return -1;
+    }
+    printf("Compression %s\n", compressionEnabled ? "enabled" : "disabled");
+    return 0;
+}
+
+int handleRemoveDirectory(const char *arguments) {
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: rmdir <dirname>\n"); return -1; }
+    VfsNode *dirNode = findChildNode(currentDirectory, arguments);
+    if (!dirNode) { printf("Error: directory '%s' not found\n", arguments); return -1; }
+    if (!dirNode->isDirectory) { printf("Error: '%s' is not a directory\n", arguments); return -1; }
+    if (dirNode->firstChild != NULL) { printf("Error: directory not empty\n"); return -1; }
+    if (isDirectoryInUse(dirNode)) { printf("Error: directory '%s' is in use by another session\n", arguments); return -1; }
+    removeDirectoryNode(dirNode);
+    printf("Directory '%s' removed\n", arguments);
+    return 0;
+}
+
+int handleWriteFile(const char *arguments) {
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: write <filename> \"content\"\n"); return -1; }
+    char fileName[MAX_NAME_LEN + 1];
+    char *content = NULL;
+    parseWriteArguments(arguments, fileName, &content);
+    if (strlen(fileName) == 0) {
+        printf("Error: missing filename\n");
+        if (content) free(content);
+        return -1;
+    }
+    VfsNode *fileNode = lookupFileForCommand(fileName);
+    if (!fileNode) {
+        if (content) free(content);
+        return -1;
+    }
+    int size = content ? (int)strlen(content) : 0;
+    lockNodeExclusive(fileNode);
+    int result = writeFileContent(fileNode, (const unsigned char *)(content ? content : ""), size);
+    unlockNode(fileNode);
+    if (content) free(content);
+    if (result == -2) { printf("Error: not enough disk space\n"); return -1; }
+    if (result != 0) { printf("Error: write failed\n"); return -1; }
+    char filePath[MAX_CMD_LEN];
+    buildAbsolutePath(fileNode, filePath, sizeof(filePath));
+    printf("Data written (%d bytes) to %s\n", size, filePath);
+    return 0;
+}
+
+int handleReadFile(const char *arguments) {
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: read <filename>\n"); return -1; }
+    VfsNode *fileNode = lookupFileForCommand(arguments);
+    if (!fileNode) return -1;
+    lockNodeShared(fileNode);
+    readFileContent(fileNode);
+    unlockNode(fileNode);
+    printf("\n");
+    return 0;
+}
+
+int handleDeleteFile(const char *arguments) {
+    if (!arguments || strlen(arguments) == 0) { printf("Usage: delete <filename>\n"); return -1; }
+    VfsNode *fileNode = findChildNode(currentDirectory, arguments);
+    if (!fileNode) { printf("Error: file '%s' not found\n", arguments); return -1; }
+    if (fileNode->isDirectory) { printf("Error: '%s' is a directory. Use rmdir\n", arguments); return -1; }
+    deleteFileNode(fileNode);
+    printf("File '%s' deleted\n", arguments);
+    return 0;
+}
+
+int handleDefragment(const char *arguments) {
+    char option[32] = "";
+    char value[32] = "";
+    if (arguments) sscanf(arguments, "%31s %31s", option, value);
+    if (strcmp(option, "--background") == 0) {
+        if (strcmp(value, "on") == 0) {
+            startBackgroundDefrag();
+        } else if (strcmp(value, "off") == 0) {
+            stopBackgroundDefrag(0);
+        } else {
+            printf("Usage: defrag [--step <blocks> | --background <on|off>]\n");
+            return -1;
+        }
+        printf("Background defrag %s\n", strcmp(value, "on") == 0 ? "enabled" : "disabled");
+        return 0;
+    }
+    int blockBudget = 0;
+    if (strcmp(option, "--step") == 0) {
+        blockBudget = value[0] ? atoi(value) : DEFRAG_STEP_BLOCK_BUDGET;
+        if (blockBudget <= 0) {
+            printf("Error: invalid block budget '%s'\n", value);
+            return -1;
+        }
+    } else if (option[0]) {
+        printf("Usage: defrag [--step <blocks> | --background <on|off>]\n");
+        return -1;
+    }
+    double scoreBefore = measureFragmentation(NULL, NULL);
+    int relocatedFileCount;
+    int skippedFileCount;
+    int relocatedBlockCount = defragmentVfs(blockBudget, &relocatedFileCount, &skippedFileCount);
+    double scoreAfter = measureFragmentation(NULL, NULL);
+    printf("Defragmented: %d blocks moved in %d files (%d skipped)\n", relocatedBlockCount, relocatedFileCount, skippedFileCount);
+    printf("Fragmentation: %.2f%% -> %.2f%%\n", scoreBefore, scoreAfter);
+    return 0;
+}
+
+int handleSyncJournal() {
+    if (journalFileDescriptor < 0) { printf("No disk image mounted\n"); return -1; }
+    long commitCount = commitJournal();
+    printf("Journal committed (%ld commits)\n", commitCount);
+    return 0;
+}
+
+int isExclusiveShellCommand(const char *command) {
+    static const char *exclusiveCommands[] = {"rm", "rmdir", "delete", "cp", "snapshot", "clone", "import", "dedup", "compress", "defrag", "mv", "ln"};
+    for (size_t i = 0; i < sizeof(exclusiveCommands) / sizeof(exclusiveCommands[0]); ++i) {
+        if (strcmp(command, exclusiveCommands[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+int executeShellCommand(const char *command, const char *arguments) {
+    if (strcmp(command, "mkdir") == 0) return handleMakeDirectory(arguments);
+    if (strcmp(command, "create") == 0) return handleCreateFile(arguments);
+    if (strcmp(command, "ls") == 0) return handleListDirectory(arguments);
+    if (strcmp(command, "pwd") == 0) {
+        printf("%s\n", getDirectoryPath(currentDirectory));
+        return 0;
+    }
+    if (strcmp(command, "df") == 0) {
+        handleDiskUsage();
+        return 0;
+    }
+    if (strcmp(command, "cd") == 0) return changeDirectory(arguments);
+    if (strcmp(command, "rmdir") == 0) return handleRemoveDirectory(arguments);
+    if (strcmp(command, "write") == 0) return handleWriteFile(arguments);
+    if (strcmp(command, "read") == 0) return handleReadFile(arguments);
+    if (strcmp(command, "append") == 0) return handleAppendFile(arguments);
+    if (strcmp(command, "readat") == 0) return handleReadAt(arguments);
+    if (strcmp(command, "truncate") == 0) return handleTruncateFile(arguments);
+    if (strcmp(command, "snapshot") == 0) return handleCloneNode(arguments, 1);
+    if (strcmp(command, "clone") == 0) return handleCloneNode(arguments, 0);
+    if (strcmp(command, "rm") == 0) return handleRemoveNode(arguments);
+    if (strcmp(command, "cp") == 0) return handleCopyNode(arguments);
+    if (strcmp(command, "mv") == 0) return handleMoveNode(arguments);
+    if (strcmp(command, "ln") == 0) return handleLinkNode(arguments);
+    if (strcmp(command, "du") == 0) return handleDirectoryUsage(arguments);
+    if (strcmp(command, "find") == 0) return handleFindNodes(arguments);
+    if (strcmp(command, "stat") == 0) return handleStatNode(arguments);
+    if (strcmp(command, "chmod") == 0) return handleChangeMode(arguments);
+    if (strcmp(command, "touch") == 0) return handleTouchNode(arguments);
+    if (strcmp(command, "setxattr") == 0) return handleSetAttribute(arguments);
+    if (strcmp(command, "getxattr") == 0) return handleGetAttribute(arguments);
+    if (strcmp(command, "rmxattr") == 0) return handleRemoveAttribute(arguments);
+    if (strcmp(command, "import") == 0) return handleImportFile(arguments);
+    if (strcmp(command, "export") == 0) return handleExportFile(arguments);
+    if (strcmp(command, "dedup") == 0) return handleDedupMode(arguments);
+    if (strcmp(command, "sync") == 0) return handleSyncJournal();
+    if (strcmp(command, "compress") == 0) return handleCompressionMode(arguments);
+    if (strcmp(command, "delete") == 0) return handleDeleteFile(arguments);
+    if (strcmp(command, "defrag") == 0) return handleDefragment(arguments);
+    printf("Unknown command: %s\n", command);
+    return -1;
+}
+
+void recordShellCommandResult(const char *command, int status) {
+    int index = 0;
+    while (index < shellCommandStatsCount && strcmp(shellCommandStats[index].name, command) != 0) index++;
+    if (index == shellCommandStatsCount) {
+        if (shellCommandStatsCount == SHELL_STATS_MAX_TYPES) return;
+        strncpy(shellCommandStats[index].name, command, sizeof(shellCommandStats[index].name) - 1);
+        shellCommandStats[index].name[sizeof(shellCommandStats[index].name) - 1] = '\0';
+        shellCommandStats[index].commandCount = shellCommandStats[index].errorCount = 0;
+        shellCommandStatsCount++;
+    }
+    shellCommandStats[index].commandCount++;
+    if (status < 0) shellCommandStats[index].errorCount++;
+}
+
+void printBatchSummary(long elapsedMillis) {
+    long totalCommands = 0;
+    long totalErrors = 0;
+    for (int i = 0; i < shellCommandStatsCount; ++i) {
+        totalCommands += shellCommandStats[i].commandCount;
+        totalErrors += shellCommandStats[i].errorCount;
+    }
+    double elapsedSeconds = elapsedMillis / 1000.0;
+    flockfile(stderr);
+    if (shellSessionId > 0) {
+        fprintf(stderr, "Session %d batch summary: %ld commands, %ld errors, %.3f s", shellSessionId, totalCommands, totalErrors, elapsedSeconds);
+    } else {
+        fprintf(stderr, "Batch summary: %ld commands, %ld errors, %.3f s", totalCommands, totalErrors, elapsedSeconds);
+    }
+    if (elapsedMillis > 0) fprintf(stderr, " (%.0f commands/s)", totalCommands / elapsedSeconds);
+    fprintf(stderr, "\n");
+    for (int i = 0; i < shellCommandStatsCount; ++i) {
+        fprintf(stderr, "  %-10s %10ld (%ld errors)\n", shellCommandStats[i].name, shellCommandStats[i].commandCount, shellCommandStats[i].errorCount);
+    }
+    funlockfile(stderr);
+}
+
+int runShellLoop(FILE *inputStream) {
+    if (!batchModeEnabled) printf("Compact VFS ready. Type 'exit' to quit.\n");
+    long startMillis = getMonotonicMillis();
+    long lineNumber = 0;
+    int exitStatus = 0;
+    char inputLine[MAX_CMD_LEN];
+    if (!currentDirectory) currentDirectory = rootDirectory;
+    int sessionSlot = registerShellSession(&currentDirectory);
+    while (1) {
+        if (!batchModeEnabled) {
+            pthread_rwlock_rdlock(&vfsTreeLock);
+            printf("%s > ", getDirectoryPath(currentDirectory));
+            pthread_rwlock_unlock(&vfsTreeLock);
+            fflush(stdout);
+        }
+        if (!fgets(inputLine, sizeof(inputLine), inputStream)) {
+            commitJournal();
+            if (!batchModeEnabled) printf("\n");
+            break;
+        }
+        lineNumber++;
+        char *cursor = inputLine;
+        while (*cursor && (*cursor == '\n' || *cursor == '\r')) cursor++;
+        char command[64] = {0};
+        int cmdLen = 0;
+        while (*cursor && isspace((unsigned char)*cursor)) cursor++;
+        while (*cursor && !isspace((unsigned char)*cursor) && cmdLen < (int)sizeof(command) - 1) {
+            command[cmdLen++] = *cursor++;
+        }
+        command[cmdLen] = '\0';
+        while (*cursor && isspace((unsigned char)*cursor)) cursor++;
+        char arguments[MAX_CMD_LEN];
+        arguments[0] = '\0';
+        if (*cursor) {
+            strncpy(arguments, cursor, sizeof(arguments) - 1);
+            arguments[sizeof(arguments) - 1] = '\0';
+            int argLen = strlen(arguments);
+            while (argLen > 0 && (arguments[argLen - 1] == '\n' || arguments[argLen - 1] == '\r')) {
+                arguments[--argLen] = '\0';
             }
-            deleteFileNode(fileNode);
-            printf("File '%s' deleted\n", arguments);
-        } else if (strcmp(command, "exit") == 0) {
-            cleanupVfs();
-            printf("Memory released. Exiting...\n");
+        }
+        if (cmdLen == 0 || command[0] == '#') continue;
+        if (strcmp(command, "exit") == 0) {
+            commitJournal();
+            shellExitRequested = 1;
+            break;
+        }
+        if (isExclusiveShellCommand(command)) {
+            pthread_rwlock_wrlock(&vfsTreeLock);
+        } else {
+            pthread_rwlock_rdlock(&vfsTreeLock);
+        }
+        int status = executeShellCommand(command, arguments);
+        releaseBlockReservation();
+        pthread_rwlock_unlock(&vfsTreeLock);
+        if (journalCheckpointRequested) {
+            pthread_rwlock_wrlock(&vfsTreeLock);
+            runRequestedCheckpoint();
+            pthread_rwlock_unlock(&vfsTreeLock);
+        }
+        if (batchModeEnabled) recordShellCommandResult(command, status);
+        if (status < 0 && stopOnFirstError) {
+            commitJournal();
+            fflush(stdout);
+            fprintf(stderr, "Stopped at line %ld: %s%s%s\n", lineNumber, command, arguments[0] ? " " : "", arguments);
+            exitStatus = EXIT_FAILURE;
             break;
-        } else if (strlen(command) > 0) {
-            printf("Unknown command: %s\n", command);
         }
     }
+    unregisterShellSession(sessionSlot);
+    pthread_mutex_lock(&journalLock);
+    publishThreadPendingFrees();
+    pthread_mutex_unlock(&journalLock);
+    if (batchModeEnabled) {
+        fflush(stdout);
+        printBatchSummary(getMonotonicMillis() - startMillis);
+    }
+    return exitStatus;
+}
+
+void* runShellSessionThread(void *argument) {
+    ShellSession *session = argument;
+    shellSessionId = session->sessionId;
+    FILE *inputStream = fopen(session->scriptPath, "r");
+    if (!inputStream) {
+        fprintf(stderr, "Session %d: cannot open '%s': %s\n", session->sessionId, session->scriptPath, strerror(errno));
+        session->exitStatus = EXIT_FAILURE;
+        return NULL;
+    }
+    session->exitStatus = runShellLoop(inputStream);
+    fclose(inputStream);
+    releaseThreadPendingFrees();
+    return NULL;
+}
+
+int runConcurrentSessions(ShellSession *sessions, int sessionCount, FILE *inputStream) {
+    pthread_t *threads = malloc(sizeof(pthread_t) * sessionCount);
+    if (!threads) exitWithError("Out of memory");
+    for (int i = 0; i < sessionCount; ++i) {
+        if (pthread_create(&threads[i], NULL, runShellSessionThread, &sessions[i]) != 0) exitWithError("Cannot start session thread");
+    }
+    int exitStatus = inputStream ? runShellLoop(inputStream) : 0;
+    for (int i = 0; i < sessionCount; ++i) {
+        pthread_join(threads[i], NULL);
+        if (sessions[i].exitStatus != 0) exitStatus = EXIT_FAILURE;
+    }
+    free(threads);
+    return exitStatus;
+}
+
+void registerJournalNode(VfsNode *node) {
+    if (node->nodeId >= journalNodeTableCapacity) {
+        int newCapacity = journalNodeTableCapacity > 0 ? journalNodeTableCapacity : 256;
+        while (newCapacity <= node->nodeId) newCapacity *= 2;
+        VfsNode **newTable = realloc(journalNodeTable, sizeof(VfsNode *) * newCapacity);
+        if (!newTable) exitWithError("Out of memory");
+        memset(newTable + journalNodeTableCapacity, 0, sizeof(VfsNode *) * (newCapacity - journalNodeTableCapacity));
+        journalNodeTable = newTable;
+        journalNodeTableCapacity = newCapacity;
+    }
+    journalNodeTable[node->nodeId] = node;
+    if (node->nodeId >= nextNodeId) nextNodeId = node->nodeId + 1;
+}
+
+void registerJournalSubtree(VfsNode *node) {
+    VfsTraversalStack stack = {0};
+    pushTraversalFrame(&stack, node, NULL);
+    while (stack.count > 0) {
+        VfsNode *cursor = stack.frames[--stack.count].node;
+        registerJournalNode(cursor);
+        pushChildFrames(&stack, cursor, NULL);
+    }
+    free(stack.frames);
+}
+
+VfsNode* lookupJournalNode(int nodeId) {
+    if (nodeId < 0 || nodeId >= journalNodeTableCapacity) return NULL;
+    return journalNodeTable[nodeId];
+}
+
+int readJournalInt(const unsigned char *payload, int *position) {
+    int value;
+    memcpy(&value, payload + *position, sizeof(int));
+    *position += sizeof(int);
+    return value;
+}
+
+void applyFileMapRecord(const unsigned char *payload, int payloadLength) {
+    int position = 0;
+    VfsNode *fileNode = lookupJournalNode(readJournalInt(payload, &position));
+    int fileSize = readJournalInt(payload, &position);
+    int blockCount = readJournalInt(payload, &position);
+    int firstSlot = readJournalInt(payload, &position);
+    int slotCount = readJournalInt(payload, &position);
+    if (!fileNode || fileNode->isDirectory) return;
+    VfsBlockMap *blockMap = prepareBlockMapForWrite(fileNode);
+    int oldBlockCount = blockMap->blockCount;
+    int endSlot = firstSlot + slotCount;
+    for (int extent = firstSlot / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < oldBlockCount; ++extent) {
+        if (getCompressedExtentLength(blockMap, extent) > 0) accountCompressedExtent(blockMap, extent, -1);
+    }
+    for (int slot = firstSlot; slot < oldBlockCount; ++slot) {
+        if ((slot < endSlot || slot >= blockCount) && blockMap->blocks[slot] >= 0) releaseDiskBlock(blockMap->blocks[slot]);
+    }
+    ensureBlockMapCapacity(blockMap, blockCount);
+    for (int slot = firstSlot; slot < endSlot; ++slot) {
+        blockMap->blocks[slot] = readJournalInt(payload, &position);
+        if (blockMap->blocks[slot] >= 0) retainDiskBlock(blockMap->blocks[slot]);
+    }
+    blockMap->blockCount = blockCount;
+    for (int extent = firstSlot / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < endSlot; ++extent) {
+        blockMap->extentCompressedLengths[extent] = readJournalInt(payload, &position);
+    }
+    int firstDroppedSlot = endSlot > blockCount ? endSlot : blockCount;
+    for (int extent = (firstDroppedSlot + COMPRESSION_EXTENT_BLOCKS - 1) / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < oldBlockCount; ++extent) {
+        blockMap->extentCompressedLengths[extent] = 0;
+    }
+    for (int extent = firstSlot / COMPRESSION_EXTENT_BLOCKS; extent * COMPRESSION_EXTENT_BLOCKS < blockCount; ++extent) {
+        if (blockMap->extentCompressedLengths[extent] > 0) accountCompressedExtent(blockMap, extent, 1);
+    }
+    setFileSize(fileNode, fileSize);
+    if (position + 2 * (int)sizeof(long) <= payloadLength) {
+        memcpy(&fileNode->inode->modifyTime, payload + position, sizeof(long));
+        memcpy(&fileNode->inode->changeTime, payload + position + sizeof(long), sizeof(long));
+    }
+}
+
+void applyAttributeRecord(const unsigned char *payload, int payloadLength) {
+    int position = 0;
+    VfsNode *node = lookupJournalNode(readJournalInt(payload, &position));
+    int mode = readJournalInt(payload, &position);
+    int attributeBlock = readJournalInt(payload, &position);
+    int attributeLength = readJournalInt(payload, &position);
+    if (!node || attributeLength < 0 || attributeLength > VFS_BLOCK_SIZE) return;
+    VfsInode *inode = node->inode;
+    memcpy(&inode->modifyTime, payload + position, sizeof(long));
+    memcpy(&inode->changeTime, payload + position + sizeof(long), sizeof(long));
+    memcpy(&inode->accessTime, payload + position + 2 * sizeof(long), sizeof(long));
+    position += 3 * sizeof(long);
+    if (attributeBlock >= 0) {
+        retainDiskBlock(attributeBlock);
+    } else if (position + attributeLength <= payloadLength && attributeLength <= INLINE_ATTRIBUTE_BYTES) {
+        memcpy(inode->inlineAttributes, payload + position, attributeLength);
+    } else {
+        attributeLength = 0;
+    }
+    if (inode->attributeBlock >= 0) releaseDiskBlock(inode->attributeBlock);
+    inode->attributeBlock = attributeBlock;
+    inode->attributeLength = (unsigned short)attributeLength;
+    inode->mode = (unsigned short)mode;
+}
+
+void rebuildSubtreeModifyTimes() {
+    VfsTraversalStack stack = {0};
+    VfsTraversalStack visitOrder = {0};
+    pushTraversalFrame(&stack, rootDirectory, NULL);
+    while (stack.count > 0) {
+        VfsNode *node = stack.frames[--stack.count].node;
+        node->subtreeModifyTime = node->inode->modifyTime;
+        pushTraversalFrame(&visitOrder, node, NULL);
+        pushChildFrames(&stack, node, NULL);
+    }
+    for (int i = visitOrder.count - 1; i > 0; --i) {
+        VfsNode *node = visitOrder.frames[i].node;
+        if (node->parent && node->parent->subtreeModifyTime < node->subtreeModifyTime) node->parent->subtreeModifyTime = node->subtreeModifyTime;
+    }
+    free(stack.frames);
+    free(visitOrder.frames);
+}
+
+long findJournalGroupEnd(const unsigned char *journalData, long position, long lastCommitEnd) {
+    while (position < lastCommitEnd) {
+        unsigned int payloadLength;
+        memcpy(&payloadLength, journalData + position, 4);
+        int recordType = journalData[position + 8];
+        position += JOURNAL_HEADER_SIZE + payloadLength;
+        if (recordType != JOURNAL_RECORD_COMMIT) continue;
+        if (payloadLength >= sizeof(int) + sizeof(long)) memcpy(&journalReplayTimestamp, journalData + position - payloadLength + sizeof(int), sizeof(long));
+        break;
+    }
+    return position;
+}
+
+void readJournalName(const unsigned char *payload, int position, int payloadLength, char *nameOut) {
+    int nameLength = payloadLength - position > MAX_NAME_LEN ? MAX_NAME_LEN : payloadLength - position;
+    memcpy(nameOut, payload + position, nameLength);
+    nameOut[nameLength] = '\0';
+}
+
+void applyJournalRecord(int recordType, const unsigned char *payload, int payloadLength) {
+    int position = 0;
+    if (recordType == JOURNAL_RECORD_CREATE) {
+        int nodeId = readJournalInt(payload, &position);
+        VfsNode *parent = lookupJournalNode(readJournalInt(payload, &position));
+        int isDirectory = readJournalInt(payload, &position);
+        char name[MAX_NAME_LEN + 1];
+        readJournalName(payload, position, payloadLength, name);
+        if (!parent) return;
+        VfsNode *node = createVfsNode(name, isDirectory, parent);
+        node->nodeId = nodeId;
+        attachChildNode(parent, node);
+        registerJournalNode(node);
+    } else if (recordType == JOURNAL_RECORD_REMOVE) {
+        VfsNode *node = lookupJournalNode(readJournalInt(payload, &position));
+        if (node) removeVfsSubtree(node);
+    } else if (recordType == JOURNAL_RECORD_FILE_MAP) {
+        applyFileMapRecord(payload, payloadLength);
+    } else if (recordType == JOURNAL_RECORD_ATTRIBUTES) {
+        applyAttributeRecord(payload, payloadLength);
+    } else if (recordType == JOURNAL_RECORD_CLONE) {
+        VfsNode *sourceNode = lookupJournalNode(readJournalInt(payload, &position));
+        VfsNode *parent = lookupJournalNode(readJournalInt(payload, &position));
+        int firstCloneId = readJournalInt(payload, &position);
+        char name[MAX_NAME_LEN + 1];
+        readJournalName(payload, position, payloadLength, name);
+        if (!sourceNode || !parent) return;
+        nextNodeId = firstCloneId;
+        VfsNode *cloneNode = cloneVfsSubtree(sourceNode, name);
+        attachChildNode(parent, cloneNode);
+        registerJournalSubtree(cloneNode);
+    } else if (recordType == JOURNAL_RECORD_LINK) {
+        int nodeId = readJournalInt(payload, &position);
+        VfsNode *parent = lookupJournalNode(readJournalInt(payload, &position));
+        VfsNode *targetNode = lookupJournalNode(readJournalInt(payload, &position));
+        char name[MAX_NAME_LEN + 1];
+        readJournalName(payload, position, payloadLength, name);
+        if (!parent || !targetNode || targetNode->isDirectory) return;
+        VfsNode *node = createLinkedVfsNode(name, 0, parent, targetNode);
+        node->nodeId = nodeId;
+        attachChildNode(parent, node);
+        registerJournalNode(node);
+    } else if (recordType == JOURNAL_RECORD_MOVE) {
+        VfsNode *node = lookupJournalNode(readJournalInt(payload, &position));
+        VfsNode *parent = lookupJournalNode(readJournalInt(payload, &position));
+        char name[MAX_NAME_LEN + 1];
+        readJournalName(payload, position, payloadLength, name);
+        if (!node || !node->parent || !parent) return;
+        detachChildNode(node->parent, node);
+        setVfsNodeName(node, name);
+        attachChildNode(parent, node);
+    }
+}
+
+int replayJournal() {
+    struct stat journalStat;
+    if (fstat(journalFileDescriptor, &journalStat) != 0) return -1;
+    long journalLength = (long)journalStat.st_size;
+    unsigned char *journalData = malloc(journalLength > 0 ? journalLength : 1);
+    if (!journalData) exitWithError("Out of memory");
+    if (journalLength > 0 && pread(journalFileDescriptor, journalData, journalLength, 0) != journalLength) {
+        free(journalData);
+        return -1;
+    }
+    long position = 0;
+    long lastCommitEnd = 0;
+    while (position + JOURNAL_HEADER_SIZE <= journalLength) {
+        unsigned int payloadLength, checksum;
+        memcpy(&payloadLength, journalData + position, 4);
+        memcpy(&checksum, journalData + position + 4, 4);
+        if (payloadLength > (unsigned long)(journalLength - position - JOURNAL_HEADER_SIZE)) break;
+        if (computeJournalChecksum(journalData + position + 8, payloadLength + 1) != checksum) break;
+        position += JOURNAL_HEADER_SIZE + payloadLength;
+        if (journalData[position - payloadLength - 1] == JOURNAL_RECORD_COMMIT) lastCommitEnd = position;
+    }
+    journalReplayTimestamp = getVfsTimestamp();
+    journalReplayInProgress = 1;
+    registerJournalNode(rootDirectory);
+    position = 0;
+    long groupEnd = 0;
+    while (position < lastCommitEnd) {
+        if (position >= groupEnd) groupEnd = findJournalGroupEnd(journalData, position, lastCommitEnd);
+        unsigned int payloadLength;
+        memcpy(&payloadLength, journalData + position, 4);
+        int recordType = journalData[position + 8];
+        if (recordType == JOURNAL_RECORD_COMMIT) {
+            journalCommitCount++;
+        } else {
+            applyJournalRecord(recordType, journalData + position + JOURNAL_HEADER_SIZE, (int)payloadLength);
+            journalRecordTotal++;
+        }
+        position += JOURNAL_HEADER_SIZE + payloadLength;
+    }
+    journalReplayInProgress = 0;
+    if (journalReplayTimestamp > lastVfsTimestamp) lastVfsTimestamp = journalReplayTimestamp;
+    rebuildSubtreeModifyTimes();
+    free(journalData);
+    free(journalNodeTable);
+    journalNodeTable = NULL;
+    journalNodeTableCapacity = 0;
+    if (lastCommitEnd < journalLength && ftruncate(journalFileDescriptor, lastCommitEnd) != 0) return -1;
+    journalFileSize = lastCommitEnd;
+    rebuildFreeBlockList();
+    return 0;
+}
+
+int mountDiskImage(const char *imagePath) {
+    off_t diskBytes = (off_t)TOTAL_BLOCKS * VFS_BLOCK_SIZE;
+    imageFileDescriptor = open(imagePath, O_RDWR | O_CREAT, 0644);
+    if (imageFileDescriptor < 0) return -1;
+    struct stat imageStat;
+    if (fstat(imageFileDescriptor, &imageStat) != 0) return -1;
+    if (imageStat.st_size < diskBytes && ftruncate(imageFileDescriptor, diskBytes) != 0) return -1;
+    initializeBlockCache();
+    free(virtualDisk);
+    virtualDisk = NULL;
+    snprintf(journalPath, sizeof(journalPath), "%s.journal", imagePath);
+    journalFileDescriptor = open(journalPath, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (journalFileDescriptor < 0) return -1;
+    return replayJournal();
 }
 
 void initializeVfs() {
-    virtualDisk = malloc((size_t)TOTAL_BLOCKS * BLOCK_SIZE);
+    virtualDisk = malloc((size_t)TOTAL_BLOCKS * VFS_BLOCK_SIZE);
     if (!virtualDisk) exitWithError("Cannot allocate virtual disk");
-    memset(virtualDisk, 0, (size_t)TOTAL_BLOCKS * BLOCK_SIZE);
+    memset(virtualDisk, 0, (size_t)TOTAL_BLOCKS * VFS_BLOCK_SIZE);
+    blockReferenceCounts = calloc(TOTAL_BLOCKS, sizeof(int));
+    if (!blockReferenceCounts) exitWithError("Out of memory");
+    dedupBucketHeads = malloc(sizeof(int) * DEDUP_BUCKET_COUNT);
+    dedupNextInBucket = malloc(sizeof(int) * TOTAL_BLOCKS);
+    blockFingerprints = malloc(sizeof(unsigned long long) * TOTAL_BLOCKS);
+    blockIsIndexed = malloc(TOTAL_BLOCKS);
+    if (!dedupBucketHeads || !dedupNextInBucket || !blockFingerprints || !blockIsIndexed) exitWithError("Out of memory");
+    clearDedupIndex();
+    pendingFreeBlocks = malloc(sizeof(int) * TOTAL_BLOCKS);
+    if (!pendingFreeBlocks) exitWithError("Out of memory");
     initializeFreeBlockList(TOTAL_BLOCKS);
+    pthread_rwlockattr_t treeLockAttributes;
+    pthread_rwlockattr_init(&treeLockAttributes);
+    pthread_rwlockattr_setkind_np(&treeLockAttributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&vfsTreeLock, &treeLockAttributes);
+    pthread_rwlockattr_destroy(&treeLockAttributes);
+    pthread_mutexattr_t journalLockAttributes;
+    pthread_mutexattr_init(&journalLockAttributes);
+    pthread_mutexattr_settype(&journalLockAttributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&journalLock, &journalLockAttributes);
+    pthread_mutexattr_destroy(&journalLockAttributes);
     rootDirectory = createVfsNode("/", 1, NULL);
     currentDirectory = rootDirectory;
     usedBlockCount = 0;
 }
 
-int main() {
-    initializeVfs();
-    runShellLoop();
+void reserveFrameBuffer(VfsFrameBuffer *buffer, int extraBytes) {
+    if (buffer->length + extraBytes <= buffer->capacity) return;
+    int newCapacity = buffer->capacity ? buffer->capacity : VFS_SERVER_BUFFER_SIZE;
+    while (newCapacity < buffer->length + extraBytes) newCapacity *= 2;
+    unsigned char *newData = realloc(buffer->data, newCapacity);
+    if (!newData) exitWithError("Out of memory");
+    buffer->data = newData;
+    buffer->capacity = newCapacity;
+}
+
+void appendFrameBytes(VfsFrameBuffer *buffer, const void *bytes, int length) {
+    reserveFrameBuffer(buffer, length);
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+void appendFrameInt(VfsFrameBuffer *buffer, int value) {
+    appendFrameBytes(buffer, &value, sizeof(int));
+}
+
+void appendFrameLong(VfsFrameBuffer *buffer, long value) {
+    appendFrameBytes(buffer, &value, sizeof(long));
+}
+
+void beginFrame(VfsFrameBuffer *buffer, unsigned int requestId, int frameType) {
+    reserveFrameBuffer(buffer, VFS_FRAME_HEADER_SIZE);
+    buffer->frameStart = buffer->length;
+    memcpy(buffer->data + buffer->length + 4, &requestId, 4);
+    buffer->data[buffer->length + 8] = (unsigned char)frameType;
+    buffer->length += VFS_FRAME_HEADER_SIZE;
+}
+
+void endFrame(VfsFrameBuffer *buffer) {
+    unsigned int payloadLength = (unsigned int)(buffer->length - buffer->frameStart - VFS_FRAME_HEADER_SIZE);
+    memcpy(buffer->data + buffer->frameStart, &payloadLength, 4);
+}
+
+int sendFullBuffer(int socketDescriptor, const unsigned char *data, int length) {
+    while (length > 0) {
+        ssize_t sent = send(socketDescriptor, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return -1;
+        data += sent;
+        length -= (int)sent;
+    }
+    return 0;
+}
+
+int copyFramePath(const unsigned char *bytes, int length, char *pathOut) {
+    if (length <= 0 || length >= MAX_PATH_LEN) return -1;
+    memcpy(pathOut, bytes, length);
+    pathOut[length] = '\0';
+    return memchr(pathOut, '\0', length) ? -1 : 0;
+}
+
+int serveLookup(const char *path, VfsFrameBuffer *response) {
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) return VFS_STATUS_NOT_FOUND;
+    lockNodeShared(node);
+    appendFrameInt(response, node->isDirectory);
+    appendFrameLong(response, getSubtreeSize(node));
+    appendFrameInt(response, node->isDirectory ? node->childCount : node->inode->linkCount);
+    unlockNode(node);
+    return VFS_STATUS_OK;
+}
+
+int serveReadDirectory(const char *path, const char *afterName, int limit, VfsFrameBuffer *response) {
+    VfsNode *directoryNode = resolveVfsPath(path);
+    if (!directoryNode) return VFS_STATUS_NOT_FOUND;
+    if (!directoryNode->isDirectory) return VFS_STATUS_NOT_DIRECTORY;
+    if (limit <= 0 || limit > VFS_READDIR_MAX_ENTRIES) limit = VFS_READDIR_MAX_ENTRIES;
+    int countOffset = response->length;
+    appendFrameInt(response, 0);
+    appendFrameInt(response, 0);
+    VfsNode *stack[NAME_INDEX_MAX_HEIGHT];
+    lockNodeShared(directoryNode);
+    int depth = seekNameIndex(directoryNode, afterName[0] ? afterName : NULL, stack);
+    int entryCount = 0;
+    VfsNode *entry;
+    while (entryCount < limit && (entry = nextNameIndexEntry(stack, &depth))) {
+        unsigned char nameLength = (unsigned char)strlen(entry->name);
+        lockNodeShared(entry);
+        long size = getSubtreeSize(entry);
+        unlockNode(entry);
+        appendFrameBytes(response, &(unsigned char){(unsigned char)entry->isDirectory}, 1);
+        appendFrameLong(response, size);
+        appendFrameBytes(response, &nameLength, 1);
+        appendFrameBytes(response, entry->name, nameLength);
+        entryCount++;
+    }
+    unlockNode(directoryNode);
+    int hasMore = depth > 0;
+    memcpy(response->data + countOffset, &entryCount, sizeof(int));
+    memcpy(response->data + countOffset + sizeof(int), &hasMore, sizeof(int));
+    return VFS_STATUS_OK;
+}
+
+int serveRead(const char *path, int offset, int length, VfsFrameBuffer *response) {
+    VfsNode *fileNode = resolveVfsPath(path);
+    if (!fileNode) return VFS_STATUS_NOT_FOUND;
+    if (fileNode->isDirectory) return VFS_STATUS_IS_DIRECTORY;
+    if (offset < 0 || length < 0) return VFS_STATUS_INVALID;
+    if (length > HOST_IO_CHUNK_SIZE) length = HOST_IO_CHUNK_SIZE;
+    if (offset > INT_MAX - length) return VFS_STATUS_INVALID;
+    reserveFrameBuffer(response, length);
+    lockNodeShared(fileNode);
+    int bytesRead = readFileRange(fileNode, offset, response->data + response->length, length);
+    unlockNode(fileNode);
+    if (bytesRead > 0) response->length += bytesRead;
+    return VFS_STATUS_OK;
+}
+
+int serveWrite(const char *path, int offset, const unsigned char *data, int length, VfsFrameBuffer *response) {
+    VfsNode *fileNode = resolveVfsPath(path);
+    if (!fileNode) return VFS_STATUS_NOT_FOUND;
+    if (fileNode->isDirectory) return VFS_STATUS_IS_DIRECTORY;
+    if (offset < 0 || length < 0 || offset > INT_MAX - length) return VFS_STATUS_INVALID;
+    lockNodeExclusive(fileNode);
+    int result = writeFileRange(fileNode, offset, data, length);
+    unlockNode(fileNode);
+    if (result == -2) return VFS_STATUS_NO_SPACE;
+    if (result < 0) return VFS_STATUS_INVALID;
+    appendFrameInt(response, result);
+    return VFS_STATUS_OK;
+}
+
+int serveTruncate(const char *path, int size) {
+    VfsNode *fileNode = resolveVfsPath(path);
+    if (!fileNode) return VFS_STATUS_NOT_FOUND;
+    if (fileNode->isDirectory) return VFS_STATUS_IS_DIRECTORY;
+    lockNodeExclusive(fileNode);
+    int result = truncateFileContent(fileNode, size);
+    unlockNode(fileNode);
+    if (result == -2) return VFS_STATUS_NO_SPACE;
+    return result < 0 ? VFS_STATUS_INVALID : VFS_STATUS_OK;
+}
+
+int serveCreate(char *path, int isDirectory) {
+    const char *name;
+    VfsNode *parent = resolveNewNodeParent(path, &name);
+    if (!parent) return VFS_STATUS_NOT_FOUND;
+    if (strlen(name) == 0 || strlen(name) > MAX_NAME_LEN) return VFS_STATUS_INVALID;
+    lockNodeExclusive(parent);
+    int status = VFS_STATUS_OK;
+    if (findChildNode(parent, name)) {
+        status = VFS_STATUS_EXISTS;
+    } else {
+        createChildNode(parent, name, isDirectory);
+    }
+    unlockNode(parent);
+    return status;
+}
+
+int serveUnlink(const char *path) {
+    VfsNode *node = resolveVfsPath(path);
+    if (!node) return VFS_STATUS_NOT_FOUND;
+    if (node == rootDirectory) return VFS_STATUS_INVALID;
+    if (!node->isDirectory) {
+        deleteFileNode(node);
+        return VFS_STATUS_OK;
+    }
+    if (node->firstChild) return VFS_STATUS_NOT_EMPTY;
+    if (isDirectoryInUse(node)) return VFS_STATUS_BUSY;
+    removeDirectoryNode(node);
+    return VFS_STATUS_OK;
+}
+
+int executeServerOperation(int opcode, const unsigned char *payload, int payloadLength, VfsFrameBuffer *response) {
+    char path[MAX_PATH_LEN];
+    int position = 0;
+    if (opcode == VFS_OP_LOOKUP || opcode == VFS_OP_UNLINK) {
+        if (copyFramePath(payload, payloadLength, path) != 0) return VFS_STATUS_INVALID;
+        return opcode == VFS_OP_LOOKUP ? serveLookup(path, response) : serveUnlink(path);
+    }
+    if (opcode == VFS_OP_CREATE) {
+        if (payloadLength < (int)sizeof(int)) return VFS_STATUS_INVALID;
+        int isDirectory = readJournalInt(payload, &position);
+        if (copyFramePath(payload + position, payloadLength - position, path) != 0) return VFS_STATUS_INVALID;
+        return serveCreate(path, isDirectory != 0);
+    }
+    if (opcode == VFS_OP_READ) {
+        if (payloadLength < 2 * (int)sizeof(int)) return VFS_STATUS_INVALID;
+        int offset = readJournalInt(payload, &position);
+        int length = readJournalInt(payload, &position);
+        if (copyFramePath(payload + position, payloadLength - position, path) != 0) return VFS_STATUS_INVALID;
+        return serveRead(path, offset, length, response);
+    }
+    if (opcode == VFS_OP_WRITE) {
+        if (payloadLength < 2 * (int)sizeof(int)) return VFS_STATUS_INVALID;
+        int offset = readJournalInt(payload, &position);
+        int pathLength = readJournalInt(payload, &position);
+        if (pathLength < 0 || pathLength > payloadLength - position) return VFS_STATUS_INVALID;
+        if (copyFramePath(payload + position, pathLength, path) != 0) return VFS_STATUS_INVALID;
+        position += pathLength;
+        return serveWrite(path, offset, payload + position, payloadLength - position, response);
+    }
+    if (opcode == VFS_OP_TRUNCATE) {
+        if (payloadLength < (int)sizeof(int)) return VFS_STATUS_INVALID;
+        int size = readJournalInt(payload, &position);
+        if (copyFramePath(payload + position, payloadLength - position, path) != 0) return VFS_STATUS_INVALID;
+        return serveTruncate(path, size);
+    }
+    if (opcode == VFS_OP_READDIR) {
+        if (payloadLength < 2 * (int)sizeof(int)) return VFS_STATUS_INVALID;
+        int limit = readJournalInt(payload, &position);
+        int afterLength = readJournalInt(payload, &position);
+        if (afterLength < 0 || afterLength > MAX_NAME_LEN || afterLength > payloadLength - position) return VFS_STATUS_INVALID;
+        char afterName[MAX_NAME_LEN + 1];
+        memcpy(afterName, payload + position, afterLength);
+        afterName[afterLength] = '\0';
+        position += afterLength;
+        if (copyFramePath(payload + position, payloadLength - position, path) != 0) return VFS_STATUS_INVALID;
+        return serveReadDirectory(path, afterName, limit, response);
+    }
+    return VFS_STATUS_INVALID;
+}
+
+void processServerRequest(int opcode, unsigned int requestId, const unsigned char *payload, int payloadLength, VfsFrameBuffer *response) {
+    beginFrame(response, requestId, VFS_STATUS_OK);
+    int frameStart = response->frameStart;
+    if (opcode == VFS_OP_UNLINK) {
+        pthread_rwlock_wrlock(&vfsTreeLock);
+    } else {
+        pthread_rwlock_rdlock(&vfsTreeLock);
+    }
+    int status = executeServerOperation(opcode, payload, payloadLength, response);
+    releaseBlockReservation();
+    pthread_rwlock_unlock(&vfsTreeLock);
+    if (journalCheckpointRequested) {
+        pthread_rwlock_wrlock(&vfsTreeLock);
+        runRequestedCheckpoint();
+        pthread_rwlock_unlock(&vfsTreeLock);
+    }
+    if (status != VFS_STATUS_OK) response->length = frameStart + VFS_FRAME_HEADER_SIZE;
+    response->frameStart = frameStart;
+    response->data[frameStart + 8] = (unsigned char)status;
+    endFrame(response);
+    __atomic_add_fetch(&serverRequestTotal, 1, __ATOMIC_RELAXED);
+}
+
+void* runServerConnectionThread(void *argument) {
+    VfsServerConnection *connection = argument;
+    currentDirectory = rootDirectory;
+    unsigned char *input = malloc(VFS_SERVER_BUFFER_SIZE);
+    if (!input) exitWithError("Out of memory");
+    VfsFrameBuffer response = {0};
+    int inputLength = 0;
+    while (1) {
+        ssize_t bytesRead = recv(connection->socketDescriptor, input + inputLength, VFS_SERVER_BUFFER_SIZE - inputLength, 0);
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) break;
+        inputLength += (int)bytesRead;
+        int position = 0;
+        int protocolError = 0;
+        while (inputLength - position >= VFS_FRAME_HEADER_SIZE) {
+            unsigned int payloadLength;
+            unsigned int requestId;
+            memcpy(&payloadLength, input + position, 4);
+            memcpy(&requestId, input + position + 4, 4);
+            if (payloadLength > VFS_FRAME_MAX_PAYLOAD) {
+                protocolError = 1;
+                break;
+            }
+            if ((unsigned int)(inputLength - position - VFS_FRAME_HEADER_SIZE) < payloadLength) break;
+            processServerRequest(input[position + 8], requestId, input + position + VFS_FRAME_HEADER_SIZE, (int)payloadLength, &response);
+            position += VFS_FRAME_HEADER_SIZE + (int)payloadLength;
+        }
+        commitJournal();
+        if (response.length > 0 && sendFullBuffer(connection->socketDescriptor, response.data, response.length) != 0) break;
+        response.length = 0;
+        if (protocolError) break;
+        memmove(input, input + position, inputLength - position);
+        inputLength -= position;
+    }
+    free(input);
+    free(response.data);
+    pthread_mutex_lock(&journalLock);
+    publishThreadPendingFrees();
+    pthread_mutex_unlock(&journalLock);
+    releaseThreadPendingFrees();
+    close(connection->socketDescriptor);
+    __atomic_store_n(&connection->isActive, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void handleServerSignal(int signalNumber) {
+    (void)signalNumber;
+    serverStopRequested = 1;
+}
+
+VfsServerConnection* claimServerConnection() {
+    for (int i = 0; i < VFS_SERVER_MAX_CONNECTIONS; ++i) {
+        VfsServerConnection *connection = &serverConnections[i];
+        if (__atomic_load_n(&connection->isActive, __ATOMIC_ACQUIRE)) continue;
+        if (connection->hasThread) {
+            pthread_join(connection->thread, NULL);
+            connection->hasThread = 0;
+        }
+        return connection;
+    }
+    return NULL;
+}
+
+int runVfsServer(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, socketPath);
+    int listenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenDescriptor < 0) exitWithError("Cannot create socket");
+    unlink(socketPath);
+    if (bind(listenDescriptor, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenDescriptor, VFS_SERVER_MAX_CONNECTIONS) != 0) {
+        perror(socketPath);
+        close(listenDescriptor);
+        return EXIT_FAILURE;
+    }
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = handleServerSignal;
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    printf("Serving VFS on %s\n", socketPath);
+    fflush(stdout);
+    while (!serverStopRequested) {
+        int clientDescriptor = accept(listenDescriptor, NULL, NULL);
+        if (clientDescriptor < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+        VfsServerConnection *connection = claimServerConnection();
+        if (!connection) {
+            close(clientDescriptor);
+            continue;
+        }
+        connection->socketDescriptor = clientDescriptor;
+        connection->isActive = 1;
+        sigset_t previousSignals;
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previousSignals);
+        if (pthread_create(&connection->thread, NULL, runServerConnectionThread, connection) != 0) exitWithError("Cannot start connection thread");
+        pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+        connection->hasThread = 1;
+    }
+    close(listenDescriptor);
+    unlink(socketPath);
+    for (int i = 0; i < VFS_SERVER_MAX_CONNECTIONS; ++i) {
+        VfsServerConnection *connection = &serverConnections[i];
+        if (!connection->hasThread) continue;
+        if (__atomic_load_n(&connection->isActive, __ATOMIC_ACQUIRE)) shutdown(connection->socketDescriptor, SHUT_RDWR);
+        pthread_join(connection->thread, NULL);
+        connection->hasThread = 0;
+    }
+    printf("Server stopped after %ld requests\n", serverRequestTotal);
+    return 0;
+}
+
+int connectToVfsServer(const char *socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) return -1;
+    strcpy(address.sun_path, socketPath);
+    int socketDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketDescriptor < 0) return -1;
+    if (connect(socketDescriptor, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(socketDescriptor);
+        return -1;
+    }
+    return socketDescriptor;
+}
+
+void appendPathRequest(VfsFrameBuffer *requests, unsigned int requestId, int opcode, const char *path) {
+    beginFrame(requests, requestId, opcode);
+    appendFrameBytes(requests, path, (int)strlen(path));
+    endFrame(requests);
+}
+
+void appendReadRequest(VfsFrameBuffer *requests, unsigned int requestId, const char *path, int offset, int length) {
+    beginFrame(requests, requestId, VFS_OP_READ);
+    appendFrameInt(requests, offset);
+    appendFrameInt(requests, length);
+    appendFrameBytes(requests, path, (int)strlen(path));
+    endFrame(requests);
+}
+
+int receiveFrame(int socketDescriptor, VfsFrameBuffer *frame, int *statusOut) {
+    unsigned char header[VFS_FRAME_HEADER_SIZE];
+    if (readFullChunk(socketDescriptor, header, VFS_FRAME_HEADER_SIZE) != VFS_FRAME_HEADER_SIZE) return -1;
+    unsigned int payloadLength;
+    memcpy(&payloadLength, header, 4);
+    if (payloadLength > VFS_FRAME_MAX_PAYLOAD) return -1;
+    frame->length = 0;
+    reserveFrameBuffer(frame, (int)payloadLength);
+    if (readFullChunk(socketDescriptor, frame->data, (int)payloadLength) != (int)payloadLength) return -1;
+    frame->length = (int)payloadLength;
+    *statusOut = header[8];
+    return 0;
+}
+
+const char* getVfsStatusMessage(int status) {
+    static const char *statusMessages[] = {"ok", "not found", "already exists", "invalid request", "not enough disk space", "directory not empty", "is a directory", "not a directory", "in use by another session"};
+    return status >= 0 && status < (int)(sizeof(statusMessages) / sizeof(statusMessages[0])) ? statusMessages[status] : "unknown error";
+}
+
+int exchangeFrames(int socketDescriptor, VfsFrameBuffer *requests, int requestCount, VfsFrameBuffer *response, int *statuses) {
+    if (sendFullBuffer(socketDescriptor, requests->data, requests->length) != 0) return -1;
+    requests->length = 0;
+    for (int i = 0; i < requestCount; ++i) {
+        if (receiveFrame(socketDescriptor, response, &statuses[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+long lookupRemoteSize(int socketDescriptor, const char *path, int *isDirectoryOut) {
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    int status;
+    appendPathRequest(&requests, 0, VFS_OP_LOOKUP, path);
+    long size = -1;
+    if (exchangeFrames(socketDescriptor, &requests, 1, &response, &status) == 0 && status == VFS_STATUS_OK) {
+        int position = 0;
+        *isDirectoryOut = readJournalInt(response.data, &position);
+        memcpy(&size, response.data + position, sizeof(long));
+    } else if (status != VFS_STATUS_OK) {
+        fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(status));
+    }
+    free(requests.data);
+    free(response.data);
+    return size;
+}
+
+int runClientReadDirectory(int socketDescriptor, const char *path) {
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    char afterName[MAX_NAME_LEN + 1] = "";
+    int hasMore = 1;
+    int exitStatus = 0;
+    while (hasMore) {
+        int status;
+        beginFrame(&requests, 0, VFS_OP_READDIR);
+        appendFrameInt(&requests, VFS_READDIR_MAX_ENTRIES);
+        appendFrameInt(&requests, (int)strlen(afterName));
+        appendFrameBytes(&requests, afterName, (int)strlen(afterName));
+        appendFrameBytes(&requests, path, (int)strlen(path));
+        endFrame(&requests);
+        if (exchangeFrames(socketDescriptor, &requests, 1, &response, &status) != 0) { exitStatus = EXIT_FAILURE; break; }
+        if (status != VFS_STATUS_OK) {
+            fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(status));
+            exitStatus = EXIT_FAILURE;
+            break;
+        }
+        int position = 0;
+        int entryCount = readJournalInt(response.data, &position);
+        hasMore = readJournalInt(response.data, &position);
+        for (int i = 0; i < entryCount; ++i) {
+            int isDirectory = response.data[position++];
+            long size;
+            memcpy(&size, response.data + position, sizeof(long));
+            position += sizeof(long);
+            int nameLength = response.data[position++];
+            memcpy(afterName, response.data + position, nameLength);
+            afterName[nameLength] = '\0';
+            position += nameLength;
+            printf("%c %12ld  %s%s\n", isDirectory ? 'd' : '-', size, afterName, isDirectory ? "/" : "");
+        }
+    }
+    free(requests.data);
+    free(response.data);
+    return exitStatus;
+}
+
+int runClientCat(int socketDescriptor, const char *path) {
+    int isDirectory = 0;
+    long size = lookupRemoteSize(socketDescriptor, path, &isDirectory);
+    if (size < 0) return EXIT_FAILURE;
+    if (isDirectory) { fprintf(stderr, "Error: %s: is a directory\n", path); return EXIT_FAILURE; }
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    int statuses[VFS_CLIENT_PIPELINE_DEPTH];
+    int exitStatus = 0;
+    for (long offset = 0; offset < size && exitStatus == 0;) {
+        int requestCount = 0;
+        while (requestCount < VFS_CLIENT_PIPELINE_DEPTH && offset < size) {
+            appendReadRequest(&requests, requestCount++, path, (int)offset, HOST_IO_CHUNK_SIZE);
+            offset += HOST_IO_CHUNK_SIZE;
+        }
+        if (sendFullBuffer(socketDescriptor, requests.data, requests.length) != 0) exitStatus = EXIT_FAILURE;
+        requests.length = 0;
+        for (int i = 0; i < requestCount && exitStatus == 0; ++i) {
+            if (receiveFrame(socketDescriptor, &response, &statuses[i]) != 0 || statuses[i] != VFS_STATUS_OK) {
+                exitStatus = EXIT_FAILURE;
+                break;
+            }
+            fwrite(response.data, 1, response.length, stdout);
+        }
+    }
+    free(requests.data);
+    free(response.data);
+    return exitStatus;
+}
+
+int runClientPut(int socketDescriptor, const char *hostPath, const char *path) {
+    int hostDescriptor = open(hostPath, O_RDONLY);
+    if (hostDescriptor < 0) { perror(hostPath); return EXIT_FAILURE; }
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    int statuses[VFS_CLIENT_PIPELINE_DEPTH];
+    beginFrame(&requests, 0, VFS_OP_CREATE);
+    appendFrameInt(&requests, 0);
+    appendFrameBytes(&requests, path, (int)strlen(path));
+    endFrame(&requests);
+    beginFrame(&requests, 1, VFS_OP_TRUNCATE);
+    appendFrameInt(&requests, 0);
+    appendFrameBytes(&requests, path, (int)strlen(path));
+    endFrame(&requests);
+    int exitStatus = exchangeFrames(socketDescriptor, &requests, 2, &response, statuses) == 0 ? 0 : EXIT_FAILURE;
+    if (exitStatus == 0 && statuses[0] != VFS_STATUS_OK && statuses[0] != VFS_STATUS_EXISTS) {
+        fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(statuses[0]));
+        exitStatus = EXIT_FAILURE;
+    } else if (exitStatus == 0 && statuses[1] != VFS_STATUS_OK) {
+        fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(statuses[1]));
+        exitStatus = EXIT_FAILURE;
+    }
+    unsigned char *chunk = malloc(HOST_IO_CHUNK_SIZE);
+    if (!chunk) exitWithError("Out of memory");
+    long totalBytes = 0;
+    long startMillis = getMonotonicMillis();
+    int endOfFile = 0;
+    while (exitStatus == 0 && !endOfFile) {
+        int requestCount = 0;
+        while (requestCount < VFS_CLIENT_PIPELINE_DEPTH) {
+            int chunkLength = readFullChunk(hostDescriptor, chunk, HOST_IO_CHUNK_SIZE);
+            if (chunkLength <= 0) {
+                endOfFile = 1;
+                break;
+            }
+            beginFrame(&requests, requestCount++, VFS_OP_WRITE);
+            appendFrameInt(&requests, (int)totalBytes);
+            appendFrameInt(&requests, (int)strlen(path));
+            appendFrameBytes(&requests, path, (int)strlen(path));
+            appendFrameBytes(&requests, chunk, chunkLength);
+            endFrame(&requests);
+            totalBytes += chunkLength;
+        }
+        if (requestCount == 0) break;
+        if (exchangeFrames(socketDescriptor, &requests, requestCount, &response, statuses) != 0) exitStatus = EXIT_FAILURE;
+        for (int i = 0; i < requestCount && exitStatus == 0; ++i) {
+            if (statuses[i] != VFS_STATUS_OK) {
+                fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(statuses[i]));
+                exitStatus = EXIT_FAILURE;
+            }
+        }
+    }
+    long elapsedMillis = getMonotonicMillis() - startMillis;
+    if (exitStatus == 0) printf("Wrote %ld bytes to %s in %ld ms (%.2f MB/s)\n", totalBytes, path, elapsedMillis, elapsedMillis > 0 ? (double)totalBytes / 1048576.0 / ((double)elapsedMillis / 1000.0) : 0.0);
+    free(chunk);
+    free(requests.data);
+    free(response.data);
+    close(hostDescriptor);
+    return exitStatus;
+}
+
+int runClientBenchmark(int socketDescriptor, const char *path, int requestTotal) {
+    int isDirectory = 0;
+    long size = lookupRemoteSize(socketDescriptor, path, &isDirectory);
+    if (size < 0) return EXIT_FAILURE;
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    int statuses[VFS_CLIENT_PIPELINE_DEPTH];
+    int exitStatus = 0;
+    for (int pass = 0; pass < 2 && exitStatus == 0; ++pass) {
+        int readPass = pass == 1;
+        if (readPass && (isDirectory || size == 0)) break;
+        long totalBytes = 0;
+        long startMillis = getMonotonicMillis();
+        long offset = 0;
+        for (int issued = 0; issued < requestTotal && exitStatus == 0;) {
+            int requestCount = 0;
+            while (requestCount < VFS_CLIENT_PIPELINE_DEPTH && issued < requestTotal) {
+                if (readPass) {
+                    appendReadRequest(&requests, requestCount, path, (int)offset, HOST_IO_CHUNK_SIZE);
+                    offset += HOST_IO_CHUNK_SIZE;
+                    if (offset >= size) offset = 0;
+                } else {
+                    appendPathRequest(&requests, requestCount, VFS_OP_LOOKUP, path);
+                }
+                requestCount++;
+                issued++;
+            }
+            if (sendFullBuffer(socketDescriptor, requests.data, requests.length) != 0) exitStatus = EXIT_FAILURE;
+            requests.length = 0;
+            for (int i = 0; i < requestCount && exitStatus == 0; ++i) {
+                if (receiveFrame(socketDescriptor, &response, &statuses[i]) != 0 || statuses[i] != VFS_STATUS_OK) exitStatus = EXIT_FAILURE;
+                totalBytes += response.length;
+            }
+        }
+        double elapsedSeconds = (double)(getMonotonicMillis() - startMillis) / 1000.0;
+        if (elapsedSeconds <= 0) elapsedSeconds = 0.001;
+        if (exitStatus == 0) printf("%s: %d requests in %.3f s (%.0f ops/s, %.2f MB/s)\n", readPass ? "read" : "lookup", requestTotal, elapsedSeconds, requestTotal / elapsedSeconds, (double)totalBytes / 1048576.0 / elapsedSeconds);
+    }
+    free(requests.data);
+    free(response.data);
+    return exitStatus;
+}
+
+int runSimpleClientRequest(int socketDescriptor, int opcode, const char *path, int isDirectory) {
+    VfsFrameBuffer requests = {0};
+    VfsFrameBuffer response = {0};
+    int status = VFS_STATUS_INVALID;
+    if (opcode == VFS_OP_CREATE) {
+        beginFrame(&requests, 0, VFS_OP_CREATE);
+        appendFrameInt(&requests, isDirectory);
+        appendFrameBytes(&requests, path, (int)strlen(path));
+        endFrame(&requests);
+    } else {
+        appendPathRequest(&requests, 0, opcode, path);
+    }
+    int exchanged = exchangeFrames(socketDescriptor, &requests, 1, &response, &status);
+    if (exchanged == 0 && status == VFS_STATUS_OK && opcode == VFS_OP_LOOKUP) {
+        int position = 0;
+        int resultIsDirectory = readJournalInt(response.data, &position);
+        long size;
+        memcpy(&size, response.data + position, sizeof(long));
+        position += sizeof(long);
+        int count = readJournalInt(response.data, &position);
+        printf("%s %ld bytes, %d %s\n", resultIsDirectory ? "directory" : "file", size, count, resultIsDirectory ? "entries" : "links");
+    } else if (exchanged == 0 && status != VFS_STATUS_OK) {
+        fprintf(stderr, "Error: %s: %s\n", path, getVfsStatusMessage(status));
+    }
+    free(requests.data);
+    free(response.data);
+    return exchanged == 0 && status == VFS_STATUS_OK ? 0 : EXIT_FAILURE;
+}
+
+int runVfsClient(const char *socketPath, int argumentCount, char **arguments) {
+    const char *usage = "Usage: --client <socket> lookup|ls|cat|mkdir|create|rm <path> | put <hostfile> <path> | bench <path> <requests>";
+    if (argumentCount < 2) {
+        fprintf(stderr, "%s\n", usage);
+        return EXIT_FAILURE;
+    }
+    int socketDescriptor = connectToVfsServer(socketPath);
+    if (socketDescriptor < 0) {
+        perror(socketPath);
+        return EXIT_FAILURE;
+    }
+    const char *command = arguments[0];
+    int exitStatus;
+    if (strcmp(command, "lookup") == 0) {
+        exitStatus = runSimpleClientRequest(socketDescriptor, VFS_OP_LOOKUP, arguments[1], 0);
+    } else if (strcmp(command, "ls") == 0) {
+        exitStatus = runClientReadDirectory(socketDescriptor, arguments[1]);
+    } else if (strcmp(command, "cat") == 0) {
+        exitStatus = runClientCat(socketDescriptor, arguments[1]);
+    } else if (strcmp(command, "mkdir") == 0 || strcmp(command, "create") == 0) {
+        exitStatus = runSimpleClientRequest(socketDescriptor, VFS_OP_CREATE, arguments[1], strcmp(command, "mkdir") == 0);
+    } else if (strcmp(command, "rm") == 0) {
+        exitStatus = runSimpleClientRequest(socketDescriptor, VFS_OP_UNLINK, arguments[1], 0);
+    } else if (strcmp(command, "put") == 0 && argumentCount >= 3) {
+        exitStatus = runClientPut(socketDescriptor, arguments[1], arguments[2]);
+    } else if (strcmp(command, "bench") == 0 && argumentCount >= 3 && atoi(arguments[2]) > 0) {
+        exitStatus = runClientBenchmark(socketDescriptor, arguments[1], atoi(arguments[2]));
+    } else {
+        fprintf(stderr, "%s\n", usage);
+        exitStatus = EXIT_FAILURE;
+    }
+    close(socketDescriptor);
+    return exitStatus;
+}
+
+double getMonotonicSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void beginBenchmarkPhase(VfsBenchmarkPhase *phase, const char *label) {
+    phase->label = label;
+    phase->operationCount = 0;
+    phase->byteCount = 0;
+    phase->startSeconds = getMonotonicSeconds();
+    pthread_rwlock_wrlock(&vfsTreeLock);
+}
+
+void endBenchmarkPhase(VfsBenchmarkPhase *phase) {
+    releaseBlockReservation();
+    pthread_rwlock_unlock(&vfsTreeLock);
+    commitJournal();
+    double elapsedSeconds = getMonotonicSeconds() - phase->startSeconds;
+    if (elapsedSeconds <= 0) elapsedSeconds = 1e-9;
+    printf("  %-18s %10ld ops %9.3f s %12.0f ops/s", phase->label, phase->operationCount, elapsedSeconds, (double)phase->operationCount / elapsedSeconds);
+    if (phase->byteCount > 0) printf(" %10.2f MB/s", (double)phase->byteCount / 1048576.0 / elapsedSeconds);
+    printf("\n");
+}
+
+void printBenchmarkFragmentation() {
+    pthread_rwlock_rdlock(&vfsTreeLock);
+    int fileCount;
+    int fragmentedFileCount;
+    double fragmentationScore = measureFragmentation(&fileCount, &fragmentedFileCount);
+    pthread_rwlock_unlock(&vfsTreeLock);
+    unsigned char *blockIsFree = malloc(TOTAL_BLOCKS);
+    if (!blockIsFree) exitWithError("Out of memory");
+    markFreeBlocks(blockIsFree);
+    int freeRunCount = 0;
+    int largestFreeRun = 0;
+    int freeBlockTotal = 0;
+    for (int i = 0, runLength = 0; i <= TOTAL_BLOCKS; ++i) {
+        if (i < TOTAL_BLOCKS && blockIsFree[i]) {
+            runLength++;
+            freeBlockTotal++;
+            continue;
+        }
+        if (runLength > 0) freeRunCount++;
+        if (runLength > largestFreeRun) largestFreeRun = runLength;
+        runLength = 0;
+    }
+    free(blockIsFree);
+    printf("  %-18s %.2f%% (%d of %d files fragmented), %d free blocks in %d runs, largest run %d\n", "fragmentation", fragmentationScore, fragmentedFileCount, fileCount, freeBlockTotal, freeRunCount, largestFreeRun);
+}
+
+VfsNode* createBenchmarkDirectory(const char *name) {
+    pthread_rwlock_wrlock(&vfsTreeLock);
+    VfsNode *directoryNode = findChildNode(rootDirectory, name);
+    if (directoryNode) removeVfsSubtree(directoryNode);
+    directoryNode = createChildNode(rootDirectory, name, 1);
+    pthread_rwlock_unlock(&vfsTreeLock);
+    return directoryNode;
+}
+
+void removeBenchmarkDirectory(VfsNode *directoryNode) {
+    pthread_rwlock_wrlock(&vfsTreeLock);
+    removeVfsSubtree(directoryNode);
+    pthread_rwlock_unlock(&vfsTreeLock);
+    commitJournal();
+}
+
+void fillBenchmarkBuffer(unsigned char *buffer, int length, unsigned int seed) {
+    for (int i = 0; i < length; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = (unsigned char)(seed >> 16);
+    }
+}
+
+void runWideDirectoryBenchmark(int scale) {
+    int fileCount = BENCHMARK_WIDE_FILE_COUNT * scale;
+    printf("wide: %d files in one directory\n", fileCount);
+    VfsNode *directoryNode = createBenchmarkDirectory("bench-wide");
+    VfsNode **files = malloc(sizeof(VfsNode *) * fileCount);
+    if (!files) exitWithError("Out of memory");
+    char name[MAX_NAME_LEN + 1];
+    VfsBenchmarkPhase phase;
+    beginBenchmarkPhase(&phase, "create");
+    for (int i = 0; i < fileCount; ++i) {
+        snprintf(name, sizeof(name), "file%08d", i);
+        files[i] = createChildNode(directoryNode, name, 0);
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "stat");
+    unsigned int seed = 1;
+    for (int i = 0; i < fileCount; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        snprintf(name, sizeof(name), "file%08d", (int)((seed >> 8) % (unsigned int)fileCount));
+        if (!findChildNode(directoryNode, name)) exitWithError("Benchmark lookup failed");
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "stat-missing");
+    for (int i = 0; i < fileCount; ++i) {
+        snprintf(name, sizeof(name), "absent%08d", i);
+        if (findChildNode(directoryNode, name)) exitWithError("Benchmark lookup failed");
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "delete");
+    for (int i = 0; i < fileCount; ++i) {
+        deleteFileNode(files[i]);
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    free(files);
+    removeBenchmarkDirectory(directoryNode);
+}
+
+void runDeepTreeBenchmark(int scale) {
+    int filesPerLevel = BENCHMARK_DEEP_FILES_PER_LEVEL * scale;
+    printf("deep: %d levels, %d files per level\n", BENCHMARK_DEEP_LEVEL_COUNT, filesPerLevel);
+    VfsNode *directoryNode = createBenchmarkDirectory("bench-deep");
+    char paths[BENCHMARK_DEEP_LEVEL_COUNT][MAX_PATH_LEN];
+    char name[MAX_NAME_LEN + 1];
+    VfsBenchmarkPhase phase;
+    beginBenchmarkPhase(&phase, "create");
+    VfsNode *levelNode = directoryNode;
+    char levelPath[MAX_PATH_LEN];
+    int levelPathLength = snprintf(levelPath, sizeof(levelPath), "/bench-deep");
+    for (int level = 0; level < BENCHMARK_DEEP_LEVEL_COUNT; ++level) {
+        if (level > 0) levelPathLength += snprintf(levelPath + levelPathLength, sizeof(levelPath) - levelPathLength, "/%s", levelNode->name);
+        memcpy(paths[level], levelPath, levelPathLength + 1);
+        for (int i = 0; i < filesPerLevel; ++i) {
+            snprintf(name, sizeof(name), "f%d", i);
+            createChildNode(levelNode, name, 0);
+            phase.operationCount++;
+        }
+        snprintf(name, sizeof(name), "level%02d", level);
+        levelNode = createChildNode(levelNode, name, 1);
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "resolve");
+    char filePath[MAX_PATH_LEN + MAX_NAME_LEN + 2];
+    unsigned int seed = 7;
+    int resolveCount = filesPerLevel * BENCHMARK_DEEP_LEVEL_COUNT;
+    for (int i = 0; i < resolveCount; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int level = (int)((seed >> 8) % BENCHMARK_DEEP_LEVEL_COUNT);
+        snprintf(filePath, sizeof(filePath), "%s/f%d", paths[level], (int)((seed >> 4) % (unsigned int)filesPerLevel));
+        if (!resolveVfsPath(filePath)) exitWithError("Benchmark lookup failed");
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "remove-tree");
+    phase.operationCount = removeVfsSubtree(directoryNode);
+    endBenchmarkPhase(&phase);
+    commitJournal();
+}
+
+void runSequentialBenchmark(int scale) {
+    int fileSize = BENCHMARK_SEQUENTIAL_FILE_BLOCKS * VFS_BLOCK_SIZE;
+    int passCount = BENCHMARK_SEQUENTIAL_PASS_COUNT * scale;
+    printf("sequential: %d passes over a %d KB file in %d byte chunks\n", passCount, fileSize / 1024, BENCHMARK_CHUNK_SIZE);
+    VfsNode *directoryNode = createBenchmarkDirectory("bench-seq");
+    pthread_rwlock_wrlock(&vfsTreeLock);
+    VfsNode *fileNode = createChildNode(directoryNode, "stream", 0);
+    pthread_rwlock_unlock(&vfsTreeLock);
+    unsigned char *buffer = malloc(fileSize);
+    if (!buffer) exitWithError("Out of memory");
+    fillBenchmarkBuffer(buffer, fileSize, 3);
+    VfsBenchmarkPhase phase;
+    beginBenchmarkPhase(&phase, "write-whole");
+    for (int pass = 0; pass < passCount; ++pass) {
+        if (writeFileContent(fileNode, buffer, fileSize) != 0) exitWithError("Benchmark write failed");
+        phase.operationCount++;
+        phase.byteCount += fileSize;
+    }
+    endBenchmarkPhase(&phase);
+    beginBenchmarkPhase(&phase, "overwrite-chunks");
+    for (int pass = 0; pass < passCount; ++pass) {
+        for (int offset = 0; offset < fileSize; offset += BENCHMARK_CHUNK_SIZE) {
+            if (writeFileRange(fileNode, offset, buffer + offset, BENCHMARK_CHUNK_SIZE) < 0) exitWithError("Benchmark write failed");
+            phase.operationCount++;
+            phase.byteCount += BENCHMARK_CHUNK_SIZE;
+        }
+    }
+    endBenchmarkPhase(&phase);
+    unsigned char *readBuffer = malloc(BENCHMARK_CHUNK_SIZE);
+    if (!readBuffer) exitWithError("Out of memory");
+    beginBenchmarkPhase(&phase, "read-chunks");
+    for (int pass = 0; pass < passCount; ++pass) {
+        for (int offset = 0; offset < fileSize; offset += BENCHMARK_CHUNK_SIZE) {
+            phase.byteCount += readFileRange(fileNode, offset, readBuffer, BENCHMARK_CHUNK_SIZE);
+            phase.operationCount++;
+        }
+    }
+    endBenchmarkPhase(&phase);
+    if (readFileRange(fileNode, fileSize - BENCHMARK_CHUNK_SIZE, readBuffer, BENCHMARK_CHUNK_SIZE) != BENCHMARK_CHUNK_SIZE || memcmp(readBuffer, buffer + fileSize - BENCHMARK_CHUNK_SIZE, BENCHMARK_CHUNK_SIZE) != 0) exitWithError("Benchmark verification failed");
+    printBenchmarkFragmentation();
+    free(readBuffer);
+    free(buffer);
+    removeBenchmarkDirectory(directoryNode);
+}
+
+void runRandomAccessBenchmark(int scale) {
+    int fileSize = BENCHMARK_RANDOM_FILE_BLOCKS * VFS_BLOCK_SIZE;
+    int operationTotal = BENCHMARK_RANDOM_OPERATION_COUNT * scale;
+    printf("random: %d reads and writes of up to %d bytes in a %d KB file\n", operationTotal, BENCHMARK_CHUNK_SIZE, fileSize / 1024);
+    VfsNode *directoryNode = createBenchmarkDirectory("bench-random");
+    pthread_rwlock_wrlock(&vfsTreeLock);
+    VfsNode *fileNode = createChildNode(directoryNode, "table", 0);
+    pthread_rwlock_unlock(&vfsTreeLock);
+    unsigned char *buffer = malloc(fileSize);
+    if (!buffer) exitWithError("Out of memory");
+    fillBenchmarkBuffer(buffer, fileSize, 5);
+    pthread_rwlock_wrlock(&vfsTreeLock);
+    if (writeFileContent(fileNode, buffer, fileSize) != 0) exitWithError("Benchmark write failed");
+    releaseBlockReservation();
+    pthread_rwlock_unlock(&vfsTreeLock);
+    VfsBenchmarkPhase phase;
+    unsigned int seed = 11;
+    beginBenchmarkPhase(&phase, "random-write");
+    for (int i = 0; i < operationTotal; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int length = 1 + (int)((seed >> 4) % BENCHMARK_CHUNK_SIZE);
+        int offset = (int)((seed >> 8) % (unsigned int)(fileSize - length));
+        if (writeFileRange(fileNode, offset, buffer + offset, length) < 0) exitWithError("Benchmark write failed");
+        phase.operationCount++;
+        phase.byteCount += length;
+    }
+    endBenchmarkPhase(&phase);
+    unsigned char *readBuffer = malloc(BENCHMARK_CHUNK_SIZE);
+    if (!readBuffer) exitWithError("Out of memory");
+    beginBenchmarkPhase(&phase, "random-read");
+    for (int i = 0; i < operationTotal; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        int length = 1 + (int)((seed >> 4) % BENCHMARK_CHUNK_SIZE);
+        int offset = (int)((seed >> 8) % (unsigned int)(fileSize - length));
+        phase.byteCount += readFileRange(fileNode, offset, readBuffer, length);
+        phase.operationCount++;
+    }
+    endBenchmarkPhase(&phase);
+    free(readBuffer);
+    free(buffer);
+    removeBenchmarkDirectory(directoryNode);
+}
+
+void runAppendStreamBenchmark(int scale) {
+    int roundCount = BENCHMARK_APPEND_ROUND_COUNT * scale;
+    int streamBytes = BENCHMARK_APPEND_STREAM_BLOCKS * VFS_BLOCK_SIZE;
+    printf("append: %d rounds of %d interleaved streams growing to %d KB in %d byte records\n", roundCount, BENCHMARK_APPEND_STREAM_COUNT, streamBytes / 1024, BENCHMARK_APPEND_RECORD_SIZE);
+    VfsNode *directoryNode = createBenchmarkDirectory("bench-append");
+    VfsNode *streams[BENCHMARK_APPEND_STREAM_COUNT];
+    unsigned char record[BENCHMARK_APPEND_RECORD_SIZE];
+    fillBenchmarkBuffer(record, sizeof(record), 13);
+    char name[MAX_NAME_LEN + 1];
+    VfsBenchmarkPhase phase;
+    beginBenchmarkPhase(&phase, "append");
+    for (int round = 0; round < roundCount; ++round) {
+        for (int i = 0; i < BENCHMARK_APPEND_STREAM_COUNT; ++i) {
+            snprintf(name, sizeof(name), "stream%02d", i);
+            VfsNode *previousStream = findChildNode(directoryNode, name);
+            if (previousStream && (i + round) % 2 == 0) deleteFileNode(previousStream);
+            streams[i] = findChildNode(directoryNode, name);
+            if (!streams[i]) streams[i] = createChildNode(directoryNode, name, 0);
+            if (streams[i]->inode->fileSize >= streamBytes) truncateFileContent(streams[i], 0);
+        }
+        for (int written = 0; written < streamBytes; written += BENCHMARK_APPEND_RECORD_SIZE) {
+            for (int i = 0; i < BENCHMARK_APPEND_STREAM_COUNT; ++i) {
+                if (appendFileContent(streams[i], record, BENCHMARK_APPEND_RECORD_SIZE) < 0) exitWithError("Benchmark append failed");
+                phase.operationCount++;
+                phase.byteCount += BENCHMARK_APPEND_RECORD_SIZE;
+            }
+        }
+    }
+    endBenchmarkPhase(&phase);
+    printBenchmarkFragmentation();
+    removeBenchmarkDirectory(directoryNode);
+}
+
+int runVfsBenchmark(const char *workloadList, int scale) {
+    static const char *workloadNames[] = {"wide", "deep", "sequential", "random", "append"};
+    static void (*const workloadRunners[])(int) = {runWideDirectoryBenchmark, runDeepTreeBenchmark, runSequentialBenchmark, runRandomAccessBenchmark, runAppendStreamBenchmark};
+    int workloadCount = (int)(sizeof(workloadNames) / sizeof(workloadNames[0]));
+    int runAll = strcmp(workloadList, "all") == 0;
+    if (!runAll) {
+        char listCopy[MAX_CMD_LEN];
+        snprintf(listCopy, sizeof(listCopy), "%s", workloadList);
+        for (char *savePointer = NULL, *token = strtok_r(listCopy, ",", &savePointer); token; token = strtok_r(NULL, ",", &savePointer)) {
+            int known = 0;
+            for (int i = 0; i < workloadCount; ++i) known |= strcmp(token, workloadNames[i]) == 0;
+            if (!known) {
+                fprintf(stderr, "Unknown workload '%s' (expected all, wide, deep, sequential, random or append)\n", token);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("VFS benchmark: scale %d, %d blocks of %d bytes, journal %s\n", scale, TOTAL_BLOCKS, VFS_BLOCK_SIZE, isJournalActive() ? "on" : "off");
+    double startSeconds = getMonotonicSeconds();
+    for (int i = 0; i < workloadCount; ++i) {
+        char pattern[64];
+        snprintf(pattern, sizeof(pattern), ",%s,", workloadNames[i]);
+        char paddedList[MAX_CMD_LEN + 2];
+        snprintf(paddedList, sizeof(paddedList), ",%s,", workloadList);
+        if (runAll || strstr(paddedList, pattern)) workloadRunners[i](scale);
+    }
+    printf("Benchmark finished in %.3f s\n", getMonotonicSeconds() - startSeconds);
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    const char *imagePath = NULL;
+    const char *scriptPath = NULL;
+    const char *serveSocketPath = NULL;
+    const char *benchmarkWorkloads = NULL;
+    int benchmarkScale = 1;
+    ShellSession sessions[MAX_SHELL_SESSIONS - 1];
+    int sessionCount = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            imagePath = argv[++i];
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            scriptPath = argv[++i];
+            batchModeEnabled = 1;
+        } else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc && sessionCount < MAX_SHELL_SESSIONS - 1) {
+            sessions[sessionCount].scriptPath = argv[++i];
+            sessions[sessionCount].sessionId = sessionCount + 1;
+            sessions[sessionCount].exitStatus = 0;
+            sessionCount++;
+            batchModeEnabled = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batchModeEnabled = 1;
+        } else if (strcmp(argv[i], "--stop-on-error") == 0) {
+            stopOnFirstError = 1;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveSocketPath = argv[++i];
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmarkWorkloads = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            benchmarkScale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--io-backend") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "uring") == 0 || strcmp(argv[i + 1], "threads") == 0 || strcmp(argv[i + 1], "sync") == 0)) {
+            i++;
+            requestedBlockIoBackend = strcmp(argv[i], "uring") == 0 ? BLOCK_IO_BACKEND_URING : strcmp(argv[i], "threads") == 0 ? BLOCK_IO_BACKEND_THREADS : BLOCK_IO_BACKEND_SYNC;
+        } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            return runVfsClient(argv[i + 1], argc - i - 2, argv + i + 2);
+        } else {
+            fprintf(stderr, "Usage: %s [--image <path>] [--script <file> | --batch] [--session <file>]... [--stop-on-error] [--serve <socket>] [--io-backend <uring|threads|sync>]\n", argv[0]);
+            fprintf(stderr, "       %s [--image <path>] --benchmark <all|wide,deep,sequential,random,append> [--scale <n>]\n", argv[0]);
+            fprintf(stderr, "       %s --client <socket> <command> <arguments>...\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    FILE *inputStream = stdin;
+    if (scriptPath && strcmp(scriptPath, "-") != 0) {
+        inputStream = fopen(scriptPath, "r");
+        if (!inputStream) {
+            perror(scriptPath);
+            return EXIT_FAILURE;
+        }
+    }
+    if (batchModeEnabled) setvbuf(stdout, NULL, _IOFBF, SHELL_BATCH_OUTPUT_BUFFER);
+    initializeVfs();
+    if (imagePath && mountDiskImage(imagePath) != 0) exitWithError("Cannot mount disk image");
+    int exitStatus;
+    if (benchmarkWorkloads) {
+        exitStatus = runVfsBenchmark(benchmarkWorkloads, benchmarkScale);
+    } else if (serveSocketPath) {
+        exitStatus = runVfsServer(serveSocketPath);
+    } else if (sessionCount > 0) {
+        exitStatus = runConcurrentSessions(sessions, sessionCount, scriptPath ? inputStream : NULL);
+    } else {
+        exitStatus = runShellLoop(inputStream);
+    }
+    if (inputStream != stdin) fclose(inputStream);
+    cleanupVfs();
+    if (shellExitRequested) printf("Memory released. Exiting...\n");
+    return exitStatus;
+}